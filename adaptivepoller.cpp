@@ -0,0 +1,236 @@
+#include "adaptivepoller.h"
+#include <QTimer>
+#include "logger.h"
+#include <algorithm>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POLL_BUDGET_DEFAULT     0.5     // Default part of bus time for polling
+#define POLL_CHANGE_WEIGHT      4       // Weight of moving average of square of changes (1/weight of new change)
+#define POLL_STRETCH_STEPS      8       // Max amount of steps of budget stretch calculation
+
+//! Default rule of polling of measurement
+typedef struct _defaultRule_t
+{
+    weatherStationRequestType_t type;   //!< Measurement type
+    pollRule_t rule;                    //!< Rule of polling
+} defaultRule_t;
+
+// Derived measurements (wind strength, cardinal direction, quality illuminance) are not polled by default
+static const defaultRule_t defaultRules[] =
+{
+    { WS_RT_WINDSPEED, { 1000, 10000, 0.5 } },
+    { WS_RT_WINDDIRECTIONGRAD, { 1000, 10000, 10.0 } },
+    { WS_RT_HUMIDITY, { 5000, 300000, 1.0 } },
+    { WS_RT_TEMPERATURE, { 5000, 300000, 0.2 } },
+    { WS_RT_NOISE, { 2000, 60000, 3.0 } },
+    { WS_RT_PM2_5, { 10000, 600000, 5.0 } },
+    { WS_RT_PM10, { 10000, 600000, 5.0 } },
+    { WS_RT_PRESSURE, { 10000, 600000, 0.05 } },
+    { WS_RT_ILLUMINANCE, { 5000, 300000, 500.0 } },
+    { WS_RT_RAINFALL, { 10000, 600000, 0.1 } }
+};
+
+AdaptivePoller::AdaptivePoller(WeatherStation *station, ModBus::ModBusMaster *master, QObject *parent) :
+    QObject(parent)
+{
+    unsigned int i = 0;
+
+    weatherStation = station;
+    modbusMaster = master;
+    busBudget = POLL_BUDGET_DEFAULT;
+    stretch = 1.0;
+    started = false;
+    overBudget = false;
+    memset(states, 0, sizeof(states));
+    for (i = 0; i < sizeof(defaultRules) / sizeof(defaultRules[0]); i++)
+        setRule(defaultRules[i].type, defaultRules[i].rule);
+
+    if (0 != (pollTimer = new QTimer(this)))
+    {
+        pollTimer->setSingleShot(true);
+        connect(pollTimer, SIGNAL(timeout()), this, SLOT(pollSlot()));
+    }
+    // Requests are passed to thread of station by batches, readings are queued back
+    connect(station, SIGNAL(newReading(weatherReading_t)), this, SLOT(readingSlot(weatherReading_t)));
+}
+
+void AdaptivePoller::setRule(weatherStationRequestType_t type, const pollRule_t &rule)
+{
+    pollState_t *state = 0;
+    uint16_t regAddr = 0;
+
+    if (WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type)
+        return;
+    state = &states[type];
+    state->rule = rule;
+    if (state->rule.maxInterval < state->rule.minInterval)
+        state->rule.maxInterval = state->rule.minInterval;
+    if (0 != state->rule.minInterval && !StationCodec::readRequest(type, &regAddr, &state->regsAmount))
+    {
+        LOG_WARNING("AdaptivePoller", "Measurement %s is not supported by %s, it is not polled!",
+                    StationCodec::measurementName(type), StationCodec::getProfile()->getName());
+        state->rule.minInterval = 0;
+    }
+    // Polling of measurement starts at max rate
+    state->interval = state->rule.minInterval;
+    state->valid = false;
+    state->meanSquare = 0;
+    state->nextTime = now();
+    if (started)
+        schedule();
+}
+
+void AdaptivePoller::setBudget(double budget)
+{
+    if (0 < budget && 1 >= budget)
+        busBudget = budget;
+}
+
+int AdaptivePoller::getInterval(weatherStationRequestType_t type)
+{
+    if (WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type || 0 == states[type].rule.minInterval)
+        return 0;
+    return effectiveInterval(&states[type]);
+}
+
+bool AdaptivePoller::parseRule(const char *text, weatherStationRequestType_t *type, pollRule_t *rule)
+{
+    const char *separator = strchr(text, ':');
+    char *end = 0;
+
+    if (0 == separator || WS_RT_UNKNOWN == (*type = StationCodec::typeByName(text, separator - text)))
+        return false;
+
+    rule->minInterval = static_cast<int>(strtol(separator + 1, &end, 10));
+    if (':' != *end || 0 > rule->minInterval)
+        return false;
+    rule->maxInterval = static_cast<int>(strtol(end + 1, &end, 10));
+    if (':' != *end || rule->minInterval > rule->maxInterval)
+        return false;
+    rule->threshold = strtod(end + 1, &end);
+    return 0 == *end && 0 < rule->threshold;
+}
+
+void AdaptivePoller::start()
+{
+    int type = 0;
+
+    started = true;
+    updateStretch();
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+        states[type].nextTime = now();
+    schedule();
+}
+
+void AdaptivePoller::stop()
+{
+    started = false;
+    pollTimer->stop();
+}
+
+void AdaptivePoller::readingSlot(weatherReading_t reading)
+{
+    pollState_t *state = 0;
+    double change = 0;
+    double activity = 0;
+
+    if (WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type || reading.slaveId != weatherStation->getSlaveId())
+        return;
+    state = &states[reading.type];
+    if (0 == state->rule.minInterval)
+        return;
+
+    if (state->valid)
+    {
+        change = StationCodec::changeOf(reading.type, state->lastValue, reading.value);
+        state->meanSquare += (change * change - state->meanSquare) / POLL_CHANGE_WEIGHT;
+        activity = std::max(change, sqrt(state->meanSquare));
+        if (state->rule.threshold < activity)
+            state->interval = std::max(state->rule.minInterval, static_cast<int>(state->interval * std::min(0.5, state->rule.threshold / activity)));
+        else if (state->rule.threshold / 2 > activity)
+            state->interval = std::min(state->rule.maxInterval, state->interval * 2);
+    }
+    state->lastValue = reading.value;
+    state->valid = true;
+
+    if (!started)
+        return;
+    // Next request is counted from reading, so time of transaction is not added to interval
+    updateStretch();
+    state->nextTime = now() + effectiveInterval(state);
+    schedule();
+}
+
+void AdaptivePoller::pollSlot()
+{
+    weatherStationRequestType_t due[WS_RT_RAINFALL + 1];
+    qint64 time = now();
+    int dueAmount = 0;
+    int type = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        if (0 == states[type].rule.minInterval || states[type].nextTime > time)
+            continue;
+        // Failed request is repeated after interval, successful one is rescheduled by reading
+        states[type].nextTime = time + effectiveInterval(&states[type]);
+        due[dueAmount++] = static_cast<weatherStationRequestType_t>(type);
+    }
+    if (0 != dueAmount)
+        weatherStation->requestReadings(due, dueAmount);
+    schedule();
+}
+
+int AdaptivePoller::effectiveInterval(const pollState_t *state)
+{
+    return std::min(state->rule.maxInterval, static_cast<int>(state->interval * stretch));
+}
+
+void AdaptivePoller::updateStretch()
+{
+    double load = 0;
+    int step = 0;
+    int type = 0;
+
+    // Intervals, which are limited by max interval, are not stretched, so stretch is refined by steps
+    stretch = 1.0;
+    for (step = 0; step < POLL_STRETCH_STEPS; step++)
+    {
+        load = 0;
+        for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+        {
+            if (0 != states[type].rule.minInterval)
+                load += modbusMaster->readTime(states[type].regsAmount) / (effectiveInterval(&states[type]) * 1000000.0);
+        }
+        if (load <= busBudget * 1.001)
+        {
+            overBudget = false;
+            return;
+        }
+        stretch *= load / busBudget;
+    }
+    if (!overBudget)
+        LOG_WARNING("AdaptivePoller", "Polling at max intervals takes %.0f%% of bus time, budget is %.0f%%!", load * 100, busBudget * 100);
+    overBudget = true;
+}
+
+void AdaptivePoller::schedule()
+{
+    qint64 nextTime = 0;
+    int type = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        if (0 != states[type].rule.minInterval && (0 == nextTime || states[type].nextTime < nextTime))
+            nextTime = states[type].nextTime;
+    }
+    if (0 != nextTime)
+        pollTimer->start(static_cast<int>(std::max<qint64>(0, nextTime - now())));
+}
+
+qint64 AdaptivePoller::now()
+{
+    return static_cast<qint64>(ModBus::monotonicTime() / 1000000);
+}
@@ -0,0 +1,110 @@
+#ifndef ADAPTIVEPOLLER_H
+#define ADAPTIVEPOLLER_H
+
+#include <QObject>
+#include "weatherstation.h"
+
+class QTimer;
+
+//! Rule of polling of measurement
+typedef struct _pollRule_t
+{
+    int minInterval;                    //!< Min interval between requests (ms), 0 - measurement is not polled
+    int maxInterval;                    //!< Max interval between requests of stable value (ms)
+    double threshold;                   //!< Change of value between readings, which speeds up polling (units of measurement)
+} pollRule_t;
+
+/**
+ * @brief The AdaptivePoller class provide change-driven polling of weather station measurements
+ *
+ * Every measurement is requested with own interval. When change of value between two readings or
+ * root mean square of recent changes exceeds threshold, interval is reduced in proportion to change
+ * (at least by half), when both are below half of threshold, interval is doubled (exponential backoff).
+ * Intervals are limited by rule of measurement, and all intervals are stretched equally, when polling
+ * takes more than budget of bus time (airtime of reads is taken from master, see ModBusMaster::readTime).
+ * Max intervals have priority over budget, so stable values are never older than max interval.
+ * Measurements, which are due at once, are requested by one batch (see WeatherStation::requestReadings).
+ */
+class AdaptivePoller : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief AdaptivePoller class constructor (rules are defaults for measurements, which are supported by profile)
+     * @param station pointer to polled weather station
+     * @param master pointer to master of bus of station
+     * @param parent parent class
+     */
+    AdaptivePoller(WeatherStation *station, ModBus::ModBusMaster *master, QObject *parent = 0);
+    /**
+     * @brief setRule set rule of polling of measurement
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param rule rule of polling (see pollRule_t)
+     */
+    void setRule(weatherStationRequestType_t type, const pollRule_t &rule);
+    /**
+     * @brief setBudget set max part of bus time, which is taken by polling
+     * @param budget part of bus time (0 - 1, default 0.5)
+     */
+    void setBudget(double budget);
+    /**
+     * @brief getInterval get current interval of polling of measurement
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @return interval with stretch of budget (ms), 0 if measurement is not polled
+     */
+    int getInterval(weatherStationRequestType_t type);
+    /**
+     * @brief parseRule parse rule of polling
+     * @param text rule in format <measurement>:<min ms>:<max ms>:<threshold> (for ex. wind_speed:1000:10000:0.5)
+     * @param type pointer for measurement type
+     * @param rule pointer for rule
+     * @return false if text is incorrect
+     */
+    static bool parseRule(const char *text, weatherStationRequestType_t *type, pollRule_t *rule);
+    /**
+     * @brief start start polling (all measurements are requested immediately)
+     */
+    void start();
+    /**
+     * @brief stop stop polling
+     */
+    void stop();
+
+public slots:
+    /**
+     * @brief readingSlot adapt interval of polling by new reading of station
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+
+private slots:
+    void pollSlot();
+
+private:
+    typedef struct _pollState_t
+    {
+        pollRule_t rule;
+        int interval;
+        uint16_t regsAmount;
+        bool valid;
+        double lastValue;
+        double meanSquare;
+        qint64 nextTime;
+    } pollState_t;
+
+    int effectiveInterval(const pollState_t *state);
+    void updateStretch();
+    void schedule();
+    static qint64 now();
+
+    WeatherStation *weatherStation;
+    ModBus::ModBusMaster *modbusMaster;
+    QTimer *pollTimer;
+    pollState_t states[WS_RT_RAINFALL + 1];
+    double busBudget;
+    double stretch;
+    bool started;
+    bool overBudget;
+};
+
+#endif // ADAPTIVEPOLLER_H
@@ -0,0 +1,53 @@
+#include <QtCore/QCoreApplication>
+#include "protocolbench.h"
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+
+static void printUsage(const char *name)
+{
+    std::cout << "Usage: " << name << " [--min-time <ms>] [--filter <name>] [--no-loopback] [--output <file>]" << std::endl;
+    std::cout << "       --min-time: minimal time of one benchmark (default 200 ms)" << std::endl;
+    std::cout << "       --filter: run only benchmarks which names contain text" << std::endl;
+    std::cout << "       --no-loopback: skip end-to-end benchmark against pseudo-terminal slave" << std::endl;
+    std::cout << "       --output: write results (JSON Lines) to file instead of stdout" << std::endl;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QString filter;
+    FILE *output = stdout;
+    bool loopback = true;
+    int minTime = 200;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--min-time") && i + 1 < argc)
+            minTime = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "--filter") && i + 1 < argc)
+            filter = argv[++i];
+        else if (0 == strcmp(argv[i], "--no-loopback"))
+            loopback = false;
+        else if (0 == strcmp(argv[i], "--output") && i + 1 < argc)
+        {
+            if (0 == (output = fopen(argv[++i], "w")))
+            {
+                std::cout << "[Bench] Can`t open output file!" << std::endl;
+                return 1;
+            }
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    ProtocolBench bench(output, (0 < minTime) ? minTime : 1);
+    bench.run(filter, loopback);
+
+    if (stdout != output)
+        fclose(output);
+    return 0;
+}
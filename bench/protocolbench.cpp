@@ -0,0 +1,452 @@
+#include "protocolbench.h"
+#include <QEventLoop>
+#include <QSocketNotifier>
+#include <QThread>
+#include <QTimer>
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <arpa/inet.h>
+
+/**
+ * @brief buildResponse build read registers response as it is sent by station
+ * @param buffer pointer to buffer for response
+ * @param slaveId slave id
+ * @param fid function id
+ * @param regsAmount amount of registers
+ * @param value value of first register (next registers are incremented)
+ * @return size of response
+ */
+static uint16_t buildResponse(uint8_t *buffer, uint8_t slaveId, uint8_t fid, uint16_t regsAmount, uint16_t value)
+{
+    uint16_t size = 3;
+    uint16_t crc = 0;
+    uint16_t i = 0;
+
+    buffer[0] = slaveId;
+    buffer[1] = fid;
+    buffer[2] = static_cast<uint8_t>(regsAmount * 2);
+    for (i = 0; i < regsAmount; i++)
+    {
+        buffer[size++] = static_cast<uint8_t>((value + i) >> 8);
+        buffer[size++] = static_cast<uint8_t>((value + i) & 0xFF);
+    }
+    // CRC is transmitted high byte first (see ModBusMaster::checkCRC)
+    crc = ModBus::ModBusMaster::crcCalc(buffer, size);
+    buffer[size++] = static_cast<uint8_t>(crc >> 8);
+    buffer[size++] = static_cast<uint8_t>(crc & 0xFF);
+    return size;
+}
+
+ProtocolBench::ProtocolBench(FILE *output, int minTime, QObject *parent) :
+    QObject(parent)
+{
+    this->output = output;
+    this->minTime = static_cast<uint64_t>(minTime) * 1000000ULL;
+    sink = 0;
+
+    // Master of micro benchmarks is never initialized, its thread is stopped so
+    // state machine does not touch created requests
+    master = new ModBus::ModBusMaster("", ModBus::BR_9600);
+    master->getEventThread()->quit();
+    master->getEventThread()->wait();
+    sub = new BenchSub(master);
+    station = new WeatherStation(master);
+
+    memset(txBuffer, 0, sizeof(txBuffer));
+    memset(rxBuffer, 0, sizeof(rxBuffer));
+    memset(&transaction, 0, sizeof(transaction));
+    buildResponse(rxTemplate, 1, ModBus::MB_READ_HOLDING_REGISTERS_FID, 10, 0x00FA);
+
+    loopbackMaster = 0;
+    loopbackStation = 0;
+    ptyNotifier = 0;
+    loopbackLoop = 0;
+    ptyBufferSize = 0;
+    ptyDescriptor = -1;
+    loopbackCompleted = 0;
+    loopbackRequested = 0;
+    loopbackStart = 0;
+}
+
+ProtocolBench::~ProtocolBench()
+{
+    delete station;
+    delete sub;
+}
+
+void ProtocolBench::run(QString filter, bool loopback)
+{
+    benchFilter = filter;
+
+    measure("crc_calc_request", &ProtocolBench::benchCrcCalcRequest);
+    measure("crc_calc_response_10_regs", &ProtocolBench::benchCrcCalcResponse);
+    measure("check_crc_response_10_regs", &ProtocolBench::benchCheckCrc);
+    measure("fill_read_regs", &ProtocolBench::benchFillReadRegs);
+    measure("copy_read_regs", &ProtocolBench::benchCopyReadRegs);
+    measure("fill_write_single_value", &ProtocolBench::benchFillWriteSingleValue);
+    measure("fill_read_status", &ProtocolBench::benchFillReadStatus);
+    measure("create_request", &ProtocolBench::benchCreateRequest);
+    measure("swap_byte_order_10_regs", &ProtocolBench::benchSwapByteOrder);
+    measure("check_error", &ProtocolBench::benchCheckError);
+    measure("decode_temperature", &ProtocolBench::benchDecodeTemperature);
+    measure("decode_wind_direction", &ProtocolBench::benchDecodeWindDirection);
+
+    if (loopback && (benchFilter.isEmpty() || QString("loopback_temperature").contains(benchFilter)))
+        this->loopback();
+}
+
+void ProtocolBench::measure(const char *name, benchFunction_t function)
+{
+    uint64_t iterations = 1024;
+    uint64_t elapsed = 0;
+
+    if (!benchFilter.isEmpty() && !QString(name).contains(benchFilter))
+        return;
+
+    // Warm up caches and branch predictors before measurement
+    (this->*function)(iterations);
+    while ((elapsed = (this->*function)(iterations)) < minTime && iterations < (1ULL << 40))
+        iterations *= 2;
+    report(name, iterations, elapsed);
+}
+
+void ProtocolBench::report(const char *name, uint64_t iterations, uint64_t elapsed)
+{
+    double nsPerOp = (0 != iterations) ? static_cast<double>(elapsed) / iterations : 0.0;
+
+    fprintf(output, "{\"benchmark\":\"%s\",\"iterations\":%llu,\"elapsed_ns\":%llu,\"ns_per_op\":%.3f,\"ops_per_sec\":%.1f}\n",
+            name, static_cast<unsigned long long>(iterations), static_cast<unsigned long long>(elapsed),
+            nsPerOp, (0.0 < nsPerOp) ? 1e9 / nsPerOp : 0.0);
+    fflush(output);
+}
+
+uint64_t ProtocolBench::benchCrcCalcRequest(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    txBuffer[0] = 1;
+    txBuffer[1] = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        txBuffer[3] = static_cast<uint8_t>(i);
+        sum += ModBus::ModBusMaster::crcCalc(txBuffer, sizeof(ModBus::mbReadRegsReq_t) - 2);
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchCrcCalcResponse(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    memcpy(rxBuffer, rxTemplate, sizeof(rxBuffer));
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        rxBuffer[4] = static_cast<uint8_t>(i);
+        sum += ModBus::ModBusMaster::crcCalc(rxBuffer, sizeof(ModBus::mbReadRegsResp_t) + 10 * sizeof(uint16_t) - 2);
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchCheckCrc(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    for (uint64_t i = 0; i < iterations; i++)
+        sum += ModBus::ModBusMaster::checkCRC(rxTemplate, sizeof(ModBus::mbReadRegsResp_t) + 10 * sizeof(uint16_t));
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchFillReadRegs(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ModBus::ModBusCodec::encodeRequest(&transaction, ModBus::MB_READ_HOLDING_REGISTERS_FID, 1, 0x01F4 + (i & 0x07), 1);
+        sum += transaction.txFrame->readRegsReq.crc;
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchCopyReadRegs(uint64_t iterations)
+{
+    ModBus::mbRequestFrame_t frames[8];
+    uint64_t start = 0;
+    uint64_t sum = 0;
+
+    // Frames are built once as by weather station on change of slave id
+    for (int i = 0; i < 8; i++)
+        ModBus::ModBusCodec::encodeRequestFrame(&frames[i], ModBus::MB_READ_HOLDING_REGISTERS_FID, 1, 0x01F4 + i, 1);
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    start = ModBus::monotonicTime();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ModBus::ModBusCodec::copyRequest(&transaction, frames[i & 0x07]);
+        sum += transaction.txFrame->readRegsReq.crc;
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchFillWriteSingleValue(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ModBus::ModBusCodec::encodeRequest(&transaction, ModBus::MB_FORCE_SINGLE_REGISTER_FID, 1, 0x6000, static_cast<uint16_t>(i));
+        sum += transaction.txFrame->writeRegReq.crc;
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchFillReadStatus(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        ModBus::ModBusCodec::encodeRequest(&transaction, ModBus::MB_READ_EXCEPTION_STATUS_FID, static_cast<uint8_t>(i));
+        sum += transaction.txFrame->readExceptionReq.crc;
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchCreateRequest(uint64_t iterations)
+{
+    ModBus::RtuEngine *engine = 0;
+    uint64_t elapsed = 0;
+    uint64_t start = 0;
+    uint64_t done = 0;
+    uint64_t batch = 0;
+    uint64_t i = 0;
+    uint64_t sum = 0;
+
+    // Send queue is limited, so requests are created by batches and freed with engine out of measured time
+    while (done < iterations)
+    {
+        batch = (iterations - done < 100) ? iterations - done : 100;
+        // Port of engine is not opened, so created requests are never scheduled
+        engine = new ModBus::RtuEngine(&listener);
+        start = ModBus::monotonicTime();
+        for (i = 0; i < batch; i++)
+            sum += engine->createRequest(sub, ModBus::MB_READ_HOLDING_REGISTERS_FID, 1, 0x01F4 + (i & 0x07), 1);
+        elapsed += ModBus::monotonicTime() - start;
+        done += batch;
+        delete engine;
+    }
+    sink = sum;
+    return elapsed;
+}
+
+uint64_t ProtocolBench::benchSwapByteOrder(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    transaction.txFrame->hdr.fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+    transaction.rxFrame = reinterpret_cast<ModBus::mbFrame_t *>(rxBuffer);
+    memcpy(rxBuffer, rxTemplate, sizeof(rxBuffer));
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        sub->swap(&transaction);
+        sum += transaction.rxFrame->readRegsResp.regs[0];
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchCheckError(uint64_t iterations)
+{
+    uint64_t start = ModBus::monotonicTime();
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    transaction.txFrame->hdr.fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+    transaction.rxFrame = reinterpret_cast<ModBus::mbFrame_t *>(rxBuffer);
+    memcpy(rxBuffer, rxTemplate, sizeof(rxBuffer));
+    for (uint64_t i = 0; i < iterations; i++)
+        sum += sub->error(&transaction);
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchDecodeTemperature(uint64_t iterations)
+{
+    uint8_t response[16];
+    uint16_t size = buildResponse(response, 1, ModBus::MB_READ_HOLDING_REGISTERS_FID, 1, 0x00FA);
+    uint64_t start = 0;
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    transaction.txFrame->hdr.fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+    transaction.rxFrame = reinterpret_cast<ModBus::mbFrame_t *>(rxBuffer);
+    transaction.crcCheck = true;
+
+    // Response is decoded in place, so it is restored before every decode
+    start = ModBus::monotonicTime();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        memcpy(rxBuffer, response, size);
+        station->decodeTransaction(&transaction, WS_RT_TEMPERATURE);
+        sum += transaction.rxFrame->readRegsResp.regs[0];
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+uint64_t ProtocolBench::benchDecodeWindDirection(uint64_t iterations)
+{
+    uint8_t response[16];
+    uint16_t size = buildResponse(response, 1, ModBus::MB_READ_HOLDING_REGISTERS_FID, 1, 3);
+    uint64_t start = 0;
+    uint64_t sum = 0;
+
+    transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+    transaction.txFrame->hdr.fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+    transaction.rxFrame = reinterpret_cast<ModBus::mbFrame_t *>(rxBuffer);
+    transaction.crcCheck = true;
+
+    start = ModBus::monotonicTime();
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        memcpy(rxBuffer, response, size);
+        station->decodeTransaction(&transaction, WS_RT_WINDDIRECTION);
+        sum += transaction.rxFrame->readRegsResp.regs[0];
+    }
+    sink = sum;
+    return ModBus::monotonicTime() - start;
+}
+
+void ProtocolBench::loopback()
+{
+    QEventLoop loop;
+
+    if (-1 == (ptyDescriptor = posix_openpt(O_RDWR | O_NOCTTY)) || 0 != grantpt(ptyDescriptor) || 0 != unlockpt(ptyDescriptor))
+    {
+        std::cout << "[ProtocolBench] Can`t create pseudo-terminal!" << std::endl;
+        if (-1 != ptyDescriptor)
+            close(ptyDescriptor);
+        ptyDescriptor = -1;
+        return;
+    }
+    fcntl(ptyDescriptor, F_SETFL, fcntl(ptyDescriptor, F_GETFL) | O_NONBLOCK);
+    makeRaw();
+
+    loopbackCompleted = 0;
+    loopbackRequested = 0;
+    ptyBufferSize = 0;
+    loopbackLoop = &loop;
+
+    loopbackMaster = new ModBus::ModBusMaster(ptsname(ptyDescriptor), ModBus::BR_9600);
+    loopbackStation = new WeatherStation(loopbackMaster);
+    ptyNotifier = new QSocketNotifier(ptyDescriptor, QSocketNotifier::Read, this);
+
+    connect(loopbackMaster, SIGNAL(portConfigured()), this, SLOT(portConfiguredSlot()));
+    connect(loopbackStation, SIGNAL(newReading(weatherReading_t)), this, SLOT(readingSlot(weatherReading_t)));
+    connect(ptyNotifier, SIGNAL(activated(int)), this, SLOT(ptyReadSlot()));
+    QTimer::singleShot(LOOPBACK_TIMEOUT, this, SLOT(loopbackTimeoutSlot()));
+    QMetaObject::invokeMethod(loopbackMaster, "startInitSlot", Qt::QueuedConnection);
+
+    loop.exec();
+    loopbackLoop = 0;
+
+    if (0 != loopbackStart)
+        report("loopback_temperature", loopbackCompleted, ModBus::monotonicTime() - loopbackStart);
+
+    loopbackMaster->getEventThread()->quit();
+    loopbackMaster->getEventThread()->wait();
+    delete ptyNotifier;
+    ptyNotifier = 0;
+    close(ptyDescriptor);
+    ptyDescriptor = -1;
+}
+
+void ProtocolBench::makeRaw()
+{
+    struct termios options;
+
+    // Terminal options are common for both sides of pseudo-terminal
+    if (0 == tcgetattr(ptyDescriptor, &options))
+    {
+        cfmakeraw(&options);
+        tcsetattr(ptyDescriptor, TCSANOW, &options);
+    }
+}
+
+void ProtocolBench::portConfiguredSlot()
+{
+    loopbackStart = ModBus::monotonicTime();
+    for (; loopbackRequested < LOOPBACK_DEPTH; loopbackRequested++)
+        QMetaObject::invokeMethod(loopbackStation, "requestTemperature", Qt::QueuedConnection);
+}
+
+void ProtocolBench::ptyReadSlot()
+{
+    ModBus::mbReadRegsReq_t request;
+    uint8_t response[256];
+    uint16_t size = 0;
+    ssize_t result = 0;
+
+    if (0 < (result = read(ptyDescriptor, &ptyBuffer[ptyBufferSize], sizeof(ptyBuffer) - ptyBufferSize)))
+        ptyBufferSize += result;
+
+    // Slave answers on every read registers request with incremented values
+    while (ptyBufferSize >= static_cast<int>(sizeof(request)))
+    {
+        memcpy(&request, ptyBuffer, sizeof(request));
+        ptyBufferSize -= sizeof(request);
+        memmove(ptyBuffer, &ptyBuffer[sizeof(request)], ptyBufferSize);
+
+        if (ModBus::MB_READ_HOLDING_REGISTERS_FID != request.fid && ModBus::MB_READ_INPUT_REGISTERS_FID != request.fid)
+            continue;
+        size = buildResponse(response, request.addr, request.fid, ntohs(request.regsAmount), static_cast<uint16_t>(loopbackCompleted));
+        if (size != write(ptyDescriptor, response, size))
+            std::cout << "[ProtocolBench] Can`t write response!" << std::endl;
+    }
+}
+
+void ProtocolBench::readingSlot(weatherReading_t reading)
+{
+    (void)reading;
+
+    if (++loopbackCompleted >= LOOPBACK_TRANSACTIONS)
+    {
+        if (0 != loopbackLoop)
+            loopbackLoop->quit();
+    }
+    else if (loopbackRequested < LOOPBACK_TRANSACTIONS)
+    {
+        loopbackRequested++;
+        QMetaObject::invokeMethod(loopbackStation, "requestTemperature", Qt::QueuedConnection);
+    }
+}
+
+void ProtocolBench::loopbackTimeoutSlot()
+{
+    if (0 != loopbackLoop)
+    {
+        std::cout << "[ProtocolBench] Loopback benchmark timeout!" << std::endl;
+        loopbackLoop->quit();
+    }
+}
@@ -0,0 +1,120 @@
+#ifndef PROTOCOLBENCH_H
+#define PROTOCOLBENCH_H
+
+#include <QObject>
+#include <QString>
+#include <stdio.h>
+#include "modbusmaster.h"
+#include "modbusmastersub.h"
+#include "weatherstation.h"
+
+class QEventLoop;
+class QSocketNotifier;
+
+/**
+ * @brief The BenchSub class provide access to protected functions of subscriber for benchmarks
+ */
+class BenchSub : public ModBus::ModBusMasterSub
+{
+    Q_OBJECT
+public:
+    explicit BenchSub(ModBus::ModBusMaster *master, QObject *parent = 0) : ModBus::ModBusMasterSub(master, parent) {}
+    inline ModBus::ModBusError error(ModBus::mbTransaction_t *transaction) { return checkError(transaction); }
+    inline void swap(ModBus::mbTransaction_t *transaction) { swapByteOrder(transaction); }
+};
+
+/**
+ * @brief The BenchListener class provide listener of engine, which port is never opened
+ */
+class BenchListener : public ModBus::RtuEngineListener
+{
+public:
+    void transactionFinished(ModBus::mbTransaction_t *transaction) { (void)transaction; }
+    void transactionFailed(ModBus::mbTransaction_t *transaction, ModBus::ModBusError error) { (void)transaction; (void)error; }
+};
+
+/**
+ * @brief The ProtocolBench class provide benchmarks of per-frame paths of protocol
+ *
+ * Every benchmark is repeated with doubled amount of iterations until it runs at least minimal time,
+ * result of last run is printed as one JSON object per line.
+ */
+class ProtocolBench : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief ProtocolBench class constructor
+     * @param output stream for results
+     * @param minTime minimal time of one benchmark (ms)
+     * @param parent parent class
+     */
+    explicit ProtocolBench(FILE *output, int minTime = 200, QObject *parent = 0);
+    ~ProtocolBench();
+    /**
+     * @brief run run benchmarks
+     * @param filter run only benchmarks which names contain filter (empty for all)
+     * @param loopback run end-to-end benchmark against pseudo-terminal slave
+     */
+    void run(QString filter, bool loopback);
+
+private slots:
+    void portConfiguredSlot();
+    void ptyReadSlot();
+    void readingSlot(weatherReading_t reading);
+    void loopbackTimeoutSlot();
+
+private:
+    typedef uint64_t (ProtocolBench::*benchFunction_t)(uint64_t iterations);
+
+    void measure(const char *name, benchFunction_t function);
+    void report(const char *name, uint64_t iterations, uint64_t elapsed);
+    void loopback();
+    void makeRaw();
+
+    uint64_t benchCrcCalcRequest(uint64_t iterations);
+    uint64_t benchCrcCalcResponse(uint64_t iterations);
+    uint64_t benchCheckCrc(uint64_t iterations);
+    uint64_t benchFillReadRegs(uint64_t iterations);
+    uint64_t benchCopyReadRegs(uint64_t iterations);
+    uint64_t benchFillWriteSingleValue(uint64_t iterations);
+    uint64_t benchFillReadStatus(uint64_t iterations);
+    uint64_t benchCreateRequest(uint64_t iterations);
+    uint64_t benchSwapByteOrder(uint64_t iterations);
+    uint64_t benchCheckError(uint64_t iterations);
+    uint64_t benchDecodeTemperature(uint64_t iterations);
+    uint64_t benchDecodeWindDirection(uint64_t iterations);
+
+    enum
+    {
+        LOOPBACK_TRANSACTIONS = 200,    //!< Amount of transactions of end-to-end benchmark
+        LOOPBACK_DEPTH = 4,             //!< Amount of requests in send queue of end-to-end benchmark
+        LOOPBACK_TIMEOUT = 30000        //!< Max time of end-to-end benchmark (ms)
+    };
+
+    ModBus::ModBusMaster *master;
+    BenchSub *sub;
+    BenchListener listener;
+    WeatherStation *station;
+    FILE *output;
+    QString benchFilter;
+    uint64_t minTime;
+    uint8_t txBuffer[256];
+    uint8_t rxBuffer[256];
+    uint8_t rxTemplate[256];
+    ModBus::mbTransaction_t transaction;
+    volatile uint64_t sink;
+
+    ModBus::ModBusMaster *loopbackMaster;
+    WeatherStation *loopbackStation;
+    QSocketNotifier *ptyNotifier;
+    QEventLoop *loopbackLoop;
+    uint8_t ptyBuffer[256];
+    int ptyBufferSize;
+    int ptyDescriptor;
+    int loopbackCompleted;
+    int loopbackRequested;
+    uint64_t loopbackStart;
+};
+
+#endif // PROTOCOLBENCH_H
@@ -0,0 +1,179 @@
+#include "busscanner.h"
+#include "modbuscodec.h"
+#include "modbusmetrics.h"
+#include "logger.h"
+#include <fcntl.h>
+#include <termios.h>
+#include <poll.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <string.h>
+
+#define SCAN_REGISTER           0x07D0      // Register requested from every slave id (slave id of weather station)
+#define SCAN_CHAR_BITS          11          // Bits of one character on line (start, 8 data, parity/stop, stop)
+
+ModBus::BusScanner::BusScanner(QString device, QObject *parent) :
+    QThread(parent)
+{
+    deviceName = device;
+    deviceDescriptor = -1;
+    responseTimeout = 20;
+    firstId = 1;
+    lastId = 247;
+}
+
+void ModBus::BusScanner::setRange(uint8_t first, uint8_t last)
+{
+    firstId = first;
+    lastId = last;
+}
+
+int ModBus::BusScanner::baudRateValue(BaudRate br)
+{
+    switch (br)
+    {
+    case BR_2400:
+        return 2400;
+    case BR_4800:
+        return 4800;
+    case BR_9600:
+    default:
+        return 9600;
+    }
+}
+
+void ModBus::BusScanner::run()
+{
+    // Most common baud rate first, slaves found on it are skipped on slower rates
+    static const BaudRate baudRates[] = { BR_9600, BR_4800, BR_2400 };
+    bool found[256];
+    uint64_t startTime = monotonicTime();
+    unsigned int i = 0;
+    int slaveId = 0;
+    mbScanResult_t result;
+
+    results.clear();
+    memset(found, 0, sizeof(found));
+
+    if (-1 == (deviceDescriptor = open(deviceName.toUtf8().data(), O_RDWR | O_NOCTTY | O_NONBLOCK)))
+    {
+        LOG_ERROR("BusScanner", "Can`t open %s!", deviceName.toUtf8().data());
+        return;
+    }
+
+    for (i = 0; i < sizeof(baudRates) / sizeof(baudRates[0]); i++)
+    {
+        if (!configurePort(baudRates[i]))
+            continue;
+
+        for (slaveId = firstId; slaveId <= lastId; slaveId++)
+        {
+            if (found[slaveId] || !probe(static_cast<uint8_t>(slaveId), baudRates[i]))
+                continue;
+
+            found[slaveId] = true;
+            result.baudRate = baudRates[i];
+            result.slaveId = static_cast<uint8_t>(slaveId);
+            results.append(result);
+            LOG_INFO("BusScanner", "%s: slave %d at %d baud", deviceName.toUtf8().data(), slaveId, baudRateValue(baudRates[i]));
+        }
+    }
+
+    close(deviceDescriptor);
+    deviceDescriptor = -1;
+    LOG_INFO("BusScanner", "%s: scan finished in %u ms, found %d slaves", deviceName.toUtf8().data(),
+             static_cast<unsigned int>((monotonicTime() - startTime) / 1000000), results.size());
+}
+
+bool ModBus::BusScanner::configurePort(BaudRate br)
+{
+    struct termios portOptions;
+    speed_t speed = B9600;
+
+    if (BR_2400 == br)
+        speed = B2400;
+    else if (BR_4800 == br)
+        speed = B4800;
+
+    if (0 != tcgetattr(deviceDescriptor, &portOptions))
+    {
+        LOG_ERROR("BusScanner", "Can`t get port options!");
+        return false;
+    }
+
+    // Responses are binary, so port is raw and read returns as soon as bytes are received
+    cfmakeraw(&portOptions);
+    portOptions.c_cflag &= ~PARENB;
+    portOptions.c_cflag &= ~CSTOPB;
+    portOptions.c_cflag &= ~CSIZE;
+    portOptions.c_cflag |= CS8 | CLOCAL | CREAD;
+    portOptions.c_cc[VMIN] = 0;
+    portOptions.c_cc[VTIME] = 0;
+
+    if (0 != cfsetspeed(&portOptions, speed) || 0 > tcsetattr(deviceDescriptor, TCSANOW, &portOptions))
+    {
+        LOG_ERROR("BusScanner", "Can`t set port options!");
+        return false;
+    }
+    return true;
+}
+
+bool ModBus::BusScanner::probe(uint8_t slaveId, BaudRate br)
+{
+    mbReadRegsReq_t request;
+    uint8_t response[sizeof(mbReadRegsResp_t) + sizeof(uint16_t)];
+    int frameTime = (SCAN_CHAR_BITS * sizeof(response) * 1000) / baudRateValue(br) + 1;
+    int count = 0;
+    uint16_t length = 0;
+
+    request.addr = slaveId;
+    request.fid = MB_READ_HOLDING_REGISTERS_FID;
+    request.regAddr = htons(SCAN_REGISTER);
+    request.regsAmount = htons(1);
+    request.crc = htons(ModBusCodec::crcCalc(reinterpret_cast<uint8_t *>(&request), sizeof(request) - 2));
+
+    // Drop late response of previous slave id
+    tcflush(deviceDescriptor, TCIOFLUSH);
+    if (sizeof(request) != write(deviceDescriptor, &request, sizeof(request)))
+        return false;
+    // Response timeout is counted from end of request transmit
+    tcdrain(deviceDescriptor);
+
+    count = receive(response, sizeof(response), responseTimeout, frameTime);
+    if (0 == (length = ModBusCodec::responseLength(response, count, sizeof(response))))
+        return false;
+
+    // Exception response also means, that slave is present
+    return (slaveId == response[0] && ModBusCodec::checkCRC(response, length));
+}
+
+int ModBus::BusScanner::receive(uint8_t *buf, int size, int firstByteTimeout, int frameTime)
+{
+    struct pollfd descriptor;
+    uint64_t deadline = monotonicTime() + static_cast<uint64_t>(firstByteTimeout) * 1000000;
+    uint64_t now = 0;
+    int count = 0;
+    int result = 0;
+
+    descriptor.fd = deviceDescriptor;
+    descriptor.events = POLLIN;
+
+    while (count < size)
+    {
+        if ((now = monotonicTime()) >= deadline)
+            break;
+        descriptor.revents = 0;
+        if (0 >= poll(&descriptor, 1, static_cast<int>((deadline - now + 999999) / 1000000)))
+            break;
+        if (0 >= (result = read(deviceDescriptor, &buf[count], size - count)))
+            break;
+
+        // First byte is received, slave is present: wait only for rest of frame
+        if (0 == count)
+            deadline = monotonicTime() + static_cast<uint64_t>(frameTime + responseTimeout) * 1000000;
+        count += result;
+        if (0 != ModBusCodec::responseLength(buf, count, size))
+            break;
+    }
+    return count;
+}
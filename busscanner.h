@@ -0,0 +1,84 @@
+#ifndef BUSSCANNER_H
+#define BUSSCANNER_H
+
+#include <QThread>
+#include <QString>
+#include <QList>
+#include "modbus.h"
+
+namespace ModBus
+{
+
+//! Slave found by bus scan
+typedef struct _mbScanResult_t
+{
+    BaudRate baudRate;                                  //!< Baud rate of slave
+    uint8_t slaveId;                                    //!< Slave id
+} mbScanResult_t;
+
+/**
+ * @brief The BusScanner class provide discovery of slaves on serial port
+ *
+ * Every slave id of range is requested at every supported baud rate (read of holding register 0x07D0).
+ * Request is answered by present slave in airtime of response and short response timeout, so empty
+ * address costs only request airtime and timeout. Receive stops on complete frame. Slave found at one
+ * baud rate is not requested at other baud rates. Every scanner has own thread and port descriptor,
+ * so several ports are scanned in parallel. Scanner must not be used on port opened by ModBusMaster.
+ */
+class BusScanner : public QThread
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief BusScanner class constructor
+     * @param device path to serial port device (for ex. /dev/ttyUSB0)
+     * @param parent parent class
+     */
+    explicit BusScanner(QString device, QObject *parent = 0);
+    /**
+     * @brief setRange set range of scanned slave ids (must be called before start)
+     * @param first first slave id (default 1)
+     * @param last last slave id (default 247)
+     */
+    void setRange(uint8_t first, uint8_t last);
+    /**
+     * @brief setResponseTimeout set time of waiting for first byte of response after transmit (must be called before start)
+     * @param timeout timeout (ms, default 20)
+     */
+    inline void setResponseTimeout(int timeout) { responseTimeout = timeout; }
+    /**
+     * @brief getDeviceName get path to serial port device
+     * @return path to device
+     */
+    inline QString getDeviceName() { return deviceName; }
+    /**
+     * @brief getResults get found slaves (valid after thread has been finished)
+     * @return list of found slaves in order of finding
+     */
+    inline QList<mbScanResult_t> getResults() { return results; }
+    /**
+     * @brief baudRateValue get numeric value of baud rate
+     * @param br baud rate (see ModBus::BaudRate)
+     * @return baud rate (baud)
+     */
+    static int baudRateValue(BaudRate br);
+
+protected:
+    void run();
+
+private:
+    bool configurePort(BaudRate br);
+    bool probe(uint8_t slaveId, BaudRate br);
+    int receive(uint8_t *buf, int size, int firstByteTimeout, int frameTime);
+
+    QString deviceName;
+    QList<mbScanResult_t> results;
+    int deviceDescriptor;
+    int responseTimeout;
+    uint8_t firstId;
+    uint8_t lastId;
+};
+
+}
+
+#endif // BUSSCANNER_H
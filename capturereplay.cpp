@@ -0,0 +1,149 @@
+#include "capturereplay.h"
+#include "framecapture.h"
+#include "modbusmetrics.h"
+#include <iostream>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <arpa/inet.h>
+
+CaptureReplay::CaptureReplay(WeatherStation *station, QObject *parent) :
+    QObject(parent)
+{
+    weatherStation = station;
+    data = 0;
+    dataSize = 0;
+    readings = 0;
+    errors = 0;
+
+    connect(weatherStation, SIGNAL(newReading(weatherReading_t)), this, SLOT(readingSlot(weatherReading_t)), Qt::DirectConnection);
+    connect(weatherStation, SIGNAL(stationError(weatherStationErrors_t)), this, SLOT(stationErrorSlot(weatherStationErrors_t)), Qt::DirectConnection);
+}
+
+CaptureReplay::~CaptureReplay()
+{
+    delete[] data;
+}
+
+bool CaptureReplay::load(QString fileName)
+{
+    ModBus::mbCaptureFileHeader_t header;
+    struct stat fileStat;
+    int descriptor = -1;
+    bool result = false;
+
+    if (-1 == (descriptor = open(fileName.toUtf8().data(), O_RDONLY)))
+    {
+        std::cout << "[CaptureReplay] Can`t open capture file!" << std::endl;
+        return false;
+    }
+
+    if (0 == fstat(descriptor, &fileStat) && sizeof(header) == read(descriptor, &header, sizeof(header)) &&
+        0 == memcmp(header.magic, "WSCAP1", sizeof(header.magic)))
+    {
+        delete[] data;
+        dataSize = fileStat.st_size - sizeof(header);
+        data = new uint8_t[dataSize];
+        result = (static_cast<ssize_t>(dataSize) == read(descriptor, data, dataSize));
+    }
+    if (!result)
+        std::cout << "[CaptureReplay] Incorrect capture file!" << std::endl;
+
+    close(descriptor);
+    return result;
+}
+
+void CaptureReplay::replay(int iterations)
+{
+    ModBus::mbCaptureRecordHeader_t header;
+    ModBus::mbTransaction_t transaction;
+    uint8_t txBuffer[ModBus::FrameCapture::FRAME_MAX_SIZE];
+    uint8_t rxBuffer[ModBus::FrameCapture::FRAME_MAX_SIZE];
+    const uint8_t *txData = 0;
+    uint16_t txLength = 0;
+    uint16_t rxSize = 0;
+    uint16_t length = 0;
+    uint64_t frames = 0;
+    uint64_t start = 0;
+    uint64_t elapsed = 0;
+    size_t position = 0;
+    int i = 0;
+
+    readings = 0;
+    errors = 0;
+    start = ModBus::monotonicTime();
+
+    for (i = 0; i < iterations; i++)
+    {
+        txData = 0;
+        for (position = 0; position + sizeof(header) <= dataSize; position += sizeof(header) + header.length)
+        {
+            memcpy(&header, &data[position], sizeof(header));
+            if (position + sizeof(header) + header.length > dataSize)
+                break;
+
+            if (ModBus::FrameCapture::DIRECTION_TX == header.direction)
+            {
+                txData = &data[position + sizeof(header)];
+                txLength = header.length;
+                continue;
+            }
+            if (0 == txData || ModBus::FrameCapture::FLAG_NONE != header.flags || 2 > txLength)
+                continue;
+
+            // Expected size of response is restored from request as it does ModBusMaster
+            memcpy(txBuffer, txData, txLength);
+            transaction.txFrame = reinterpret_cast<ModBus::mbFrame_t *>(txBuffer);
+            switch (transaction.txFrame->hdr.fid)
+            {
+            case ModBus::MB_READ_HOLDING_REGISTERS_FID:
+            case ModBus::MB_READ_INPUT_REGISTERS_FID:
+                rxSize = sizeof(ModBus::mbReadRegsResp_t) + sizeof(uint16_t) * ntohs(transaction.txFrame->readRegsReq.regsAmount);
+                break;
+            case ModBus::MB_FORCE_SINGLE_COIL_FID:
+            case ModBus::MB_FORCE_SINGLE_REGISTER_FID:
+                rxSize = sizeof(ModBus::mbWriteRegResp_t);
+                break;
+            default:
+                rxSize = sizeof(ModBus::mbReadExceptionResp_t);
+                break;
+            }
+
+            memcpy(rxBuffer, &data[position + sizeof(header)], header.length);
+            if (0 == (length = ModBus::ModBusMaster::responseLength(rxBuffer, header.length, rxSize)))
+                continue;
+
+            transaction.rxFrame = reinterpret_cast<ModBus::mbFrame_t *>(rxBuffer);
+            transaction.txSize = txLength;
+            transaction.rxSize = rxSize;
+            transaction.countReadBytes = header.length;
+            transaction.owner = weatherStation;
+            transaction.tag = 0;
+            transaction.errorChecked = true;
+            transaction.crcCheck = ModBus::ModBusMaster::checkCRC(rxBuffer, length);
+            weatherStation->decodeTransaction(&transaction, WeatherStation::requestTypeFromFrame(transaction.txFrame));
+            frames++;
+            txData = 0;
+        }
+    }
+
+    elapsed = ModBus::monotonicTime() - start;
+    std::cout << "[CaptureReplay] Responses: " << frames << ", readings: " << readings << ", errors: " << errors << std::endl;
+    std::cout << "[CaptureReplay] Time: " << elapsed / 1000 << " us";
+    if (0 != frames)
+        std::cout << " (" << elapsed / frames << " ns per response)";
+    std::cout << std::endl;
+}
+
+void CaptureReplay::readingSlot(weatherReading_t reading)
+{
+    (void)reading;
+    readings++;
+}
+
+void CaptureReplay::stationErrorSlot(weatherStationErrors_t errorType)
+{
+    (void)errorType;
+    errors++;
+}
@@ -0,0 +1,49 @@
+#ifndef CAPTUREREPLAY_H
+#define CAPTUREREPLAY_H
+
+#include <QObject>
+#include <QString>
+#include "weatherstation.h"
+
+/**
+ * @brief The CaptureReplay class provide replay of capture file through response parser and weather station decoding
+ *
+ * Capture file is loaded in memory before replay, so replay loop does not allocate memory and gives
+ * deterministic measure of decoding speed.
+ */
+class CaptureReplay : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief CaptureReplay class constructor
+     * @param station pointer to weather station, which decodes responses
+     * @param parent parent class
+     */
+    explicit CaptureReplay(WeatherStation *station, QObject *parent = 0);
+    ~CaptureReplay();
+    /**
+     * @brief load load capture file
+     * @param fileName path to capture file
+     * @return true if file has been loaded
+     */
+    bool load(QString fileName);
+    /**
+     * @brief replay feed all captured responses to parser and decoding
+     * @param iterations amount of passes over capture
+     */
+    void replay(int iterations = 1);
+
+private slots:
+    void readingSlot(weatherReading_t reading);
+    void stationErrorSlot(weatherStationErrors_t errorType);
+
+private:
+    WeatherStation *weatherStation;
+    uint8_t *data;
+    size_t dataSize;
+    uint64_t readings;
+    uint64_t errors;
+};
+
+#endif // CAPTUREREPLAY_H
@@ -1,12 +1,31 @@
 #include "consolemanager.h"
 #include "weatherstation.h"
+#include "weatheraggregator.h"
+#include "historystore.h"
+#include "readingexporter.h"
+#include "metricsserver.h"
+#include "framecapture.h"
+#include "modbusgateway.h"
+#include "sharedreadings.h"
+#include "decodepipeline.h"
+#include "adaptivepoller.h"
+#include "deadbandfilter.h"
+#include "warmstate.h"
+#include "epochsampler.h"
 #include "modbusmaster.h"
 #include <QSocketNotifier>
 #include <QDir>
+#include <QFile>
+#include <QDateTime>
+#include <QElapsedTimer>
 #include <stdio.h>
 #include <stdlib.h>
 #include <iostream>
 #include <string>
+#include <string.h>
+#include <sched.h>
+
+#define HISTORY_FILE_NAME "ws_history.dat"
 
 using namespace ModBus;
 
@@ -14,6 +33,31 @@ ConsoleManager::ConsoleManager(QObject *parent) :
     QObject(parent)
 {
     currentCommand = COMMAND_NONE;
+    weatherAggregator = new WeatherAggregator(this);
+    historyStore = new HistoryStore(this);
+    historyStore->open(HISTORY_FILE_NAME);
+    metricsServer = 0;
+    frameCapture = 0;
+    cacheMaxAge = 0;
+    gatewayPort = 0;
+    maxRetries = 0;
+    breakerThreshold = 0;
+    parkOnPortLoss = true;
+    adapterLatency = -1;
+    busThreadConfig = RealTime::defaultConfig();
+    gateway = 0;
+    sharedReadings = 0;
+    decodePipeline = 0;
+    decodeWorkers = 1;
+    poller = 0;
+    deadbandFilter = 0;
+    warmState = 0;
+    sampler = 0;
+    samplePeriod = 0;
+    warmStart = false;
+    adaptivePolling = false;
+    pollBudget = 0;
+    pollRules.clear();
     deviceNames = new QStringList();
     deviceNames->clear();
 }
@@ -26,6 +70,11 @@ void ConsoleManager::start()
     {
         connect(socketNotifier, SIGNAL(activated(int)), this, SLOT(readCommand()));
 
+        if (0 != warmState && warmState->isKnown() && QFile::exists(warmState->getDevice()))
+        {
+            startFromWarmState();
+            return;
+        }
         std::cout << "Choose serial port device: " << std::endl;
         QStringList files = QDir("/dev").entryList(QDir::Files | QDir::NoDotAndDotDot | QDir::System);
         for (int i = 0; i < files.length(); i++)
@@ -44,16 +93,130 @@ void ConsoleManager::start()
         std::cout << "[ConsoleManager] Can`t create socket notifier!" << std::endl;
 }
 
+void ConsoleManager::addExporter(ReadingExporter *exporter)
+{
+    exporter->setParent(this);
+    exporters.append(exporter);
+}
+
+void ConsoleManager::setMetricsServer(MetricsServer *server)
+{
+    server->setParent(this);
+    metricsServer = server;
+}
+
+void ConsoleManager::setFrameCapture(ModBus::FrameCapture *capture)
+{
+    capture->setParent(this);
+    frameCapture = capture;
+}
+
+void ConsoleManager::setCacheMaxAge(int maxAge)
+{
+    cacheMaxAge = maxAge;
+}
+
+void ConsoleManager::setSharedReadings(SharedReadings *readings)
+{
+    readings->setParent(this);
+    sharedReadings = readings;
+}
+
+void ConsoleManager::setGatewayPort(uint16_t port)
+{
+    gatewayPort = port;
+}
+
+void ConsoleManager::setRetries(uint8_t retries)
+{
+    maxRetries = retries;
+}
+
+void ConsoleManager::setBreakerThreshold(uint8_t threshold)
+{
+    breakerThreshold = threshold;
+}
+
+void ConsoleManager::setParkOnPortLoss(bool park)
+{
+    parkOnPortLoss = park;
+}
+
+void ConsoleManager::setAdapterLatency(int latency)
+{
+    adapterLatency = latency;
+}
+
+void ConsoleManager::setBusThreadConfig(const rtThreadConfig_t &config)
+{
+    busThreadConfig = config;
+}
+
+void ConsoleManager::setDecodeWorkers(int workers)
+{
+    decodeWorkers = workers;
+}
+
+void ConsoleManager::setPollBudget(double budget)
+{
+    adaptivePolling = true;
+    pollBudget = budget;
+}
+
+void ConsoleManager::setPollRule(weatherStationRequestType_t type, const pollRule_t &rule)
+{
+    adaptivePolling = true;
+    pollRules.insert(type, rule);
+}
+
+void ConsoleManager::setDeadbandFilter(DeadbandFilter *filter)
+{
+    filter->setParent(this);
+    deadbandFilter = filter;
+}
+
+void ConsoleManager::setWarmState(WarmState *state)
+{
+    state->setParent(this);
+    warmState = state;
+}
+
+void ConsoleManager::setSampleEpoch(int period)
+{
+    samplePeriod = period;
+}
+
 void ConsoleManager::portConfiguredSlot()
 {
     std::cout << "[ConsoleManager] Port configured!" << std::endl;
-    emit wsRequestSlaveId();
+    // Slave id of previous run is used without probe of station
+    if (warmStart)
+        wsConfiguredSlot();
+    else
+        emit wsRequestSlaveId();
+}
+
+void ConsoleManager::portLostSlot()
+{
+    std::cout << "[ConsoleManager] Port " << deviceName.toStdString() << " has been lost, waiting for adapter..." << std::endl;
+}
+
+void ConsoleManager::portRestoredSlot()
+{
+    std::cout << "[ConsoleManager] Port " << deviceName.toStdString() << " has been restored!" << std::endl;
 }
 
 void ConsoleManager::wsConfiguredSlot()
 {
     std::cout << "[ConsoleManager] Weather station configured!" << std::endl;
-
+    if (0 != warmState)
+        warmState->setSlaveId(weatherStation->getSlaveId());
+
+    // Polling starts, when slave id of station is known
+    if (0 != poller)
+        poller->start();
+    if (0 != sampler)
+        sampler->start();
     startWeatherStationCommand();
 }
 
@@ -142,6 +305,8 @@ void ConsoleManager::rainfallSlot(float rainfall)
 void ConsoleManager::setSlaveIdSlot(uint8_t slaveId)
 {
     std::cout << "New slave id has been installed successfully: " << slaveId << std::endl;
+    if (0 != warmState)
+        warmState->setSlaveId(slaveId);
     startWeatherStationCommand();
 }
 
@@ -224,6 +389,15 @@ void ConsoleManager::wsErrorSlot(weatherStationErrors_t errorCode)
     case WS_ERROR_RESET_RAINFALL:
         std::cout << "Failed to reset rainfall!" << std::endl;
         break;
+    case WS_ERROR_STATION_UNAVAILABLE:
+        std::cout << "Station does not respond, request has not been sent!" << std::endl;
+        break;
+    case WS_ERROR_PORT_LOST:
+        std::cout << "Serial port has been lost, request has not been sent!" << std::endl;
+        break;
+    case WS_ERROR_NOT_SUPPORTED:
+        std::cout << "Not supported by station profile!" << std::endl;
+        break;
     default:
         std::cout << "Unknown error!" << std::endl;
         break;
@@ -285,76 +459,20 @@ void ConsoleManager::readCommand()
                 baudRate = BR_9600;
                 break;
             }
-            if (0 != (modbus = new ModBus::ModBusMaster(deviceName, baudRate)))
-            {
-                if (0 != (weatherStation = new WeatherStation(modbus)))
-                {
-                    connect(this, SIGNAL(modbusInit()), modbus, SLOT(startInitSlot()));
-                    connect(modbus, SIGNAL(portConfigured()), this, SLOT(portConfiguredSlot()));
-                    connect(modbus, SIGNAL(error(ModBus::ModBusError)), this, SLOT(modbusErrorSlot(ModBus::ModBusError)));
-
-                    connect(this, SIGNAL(wsRequestSlaveId()), weatherStation, SLOT(requestSlaveIdSlot()));
-                    connect(this, SIGNAL(getBaudRate()), weatherStation, SLOT(requestBaudRate()));
-                    connect(this, SIGNAL(getWindSpeed()), weatherStation, SLOT(requestWindSpeed()));
-                    connect(this, SIGNAL(getWindStrength()), weatherStation, SLOT(requestWindStrength()));
-                    connect(this, SIGNAL(getWindDirection()), weatherStation, SLOT(requestWindDirection()));
-                    connect(this, SIGNAL(getWindDirectionGrad()), weatherStation, SLOT(requestWindDirectionGrad()));
-                    connect(this, SIGNAL(getWindDirectionGrad()), weatherStation, SLOT(requestHumidity()));
-                    connect(this, SIGNAL(getTemperature()), weatherStation, SLOT(requestTemperature()));
-                    connect(this, SIGNAL(getNoise()), weatherStation, SLOT(requestNoise()));
-                    connect(this, SIGNAL(getPM2_5()), weatherStation, SLOT(requestPM2_5()));
-                    connect(this, SIGNAL(getPM10()), weatherStation, SLOT(requestPM10()));
-                    connect(this, SIGNAL(getPressure()), weatherStation, SLOT(requestPressure()));
-                    connect(this, SIGNAL(getIlluminanceQ()), weatherStation, SLOT(requestIlluminanceQ()));
-                    connect(this, SIGNAL(getIlliminance()), weatherStation, SLOT(requestIlluminance()));
-                    connect(this, SIGNAL(getRainfall()), weatherStation, SLOT(requestRainfall()));
-                    connect(this, SIGNAL(setSlaveId(uint8_t)), weatherStation, SLOT(requestSetSlaveId(uint8_t)));
-                    connect(this, SIGNAL(setWindDirectionOffset(uint8_t)), weatherStation, SLOT(requestSetWindDirectionOffset(uint8_t)));
-                    connect(this, SIGNAL(resetZeroWindSpeed()), weatherStation, SLOT(requestResetZeroWindSpeed()));
-                    connect(this, SIGNAL(resetRainfall()), weatherStation, SLOT(requestResetRainfall()));
-
-                    connect(weatherStation, SIGNAL(connectionSetuped()), this, SLOT(wsConfiguredSlot()));
-                    connect(weatherStation, SIGNAL(baudRate(uint16_t)), this, SLOT(baudRateSlot(uint16_t)));
-                    connect(weatherStation, SIGNAL(windSpeed(float)), this, SLOT(windSpeedSlot(float)));
-                    connect(weatherStation, SIGNAL(windStrength(uint16_t)), this, SLOT(windStrengthSlot(uint16_t)));
-                    connect(weatherStation, SIGNAL(windDirection(QString)), this, SLOT(windDirectionSlot(QString)));
-                    connect(weatherStation, SIGNAL(windDirectionGrad(uint16_t)), this, SLOT(windDirectionGradSlot(uint16_t)));
-                    connect(weatherStation, SIGNAL(humidity(float)), this, SLOT(humiditySlot(float)));
-                    connect(weatherStation, SIGNAL(temperature(float)), this, SLOT(temperatureSlot(float)));
-                    connect(weatherStation, SIGNAL(noise(float)), this, SLOT(noiseSlot(float)));
-                    connect(weatherStation, SIGNAL(pm2_5(uint16_t)), this, SLOT(pm2_5Slot(uint16_t)));
-                    connect(weatherStation, SIGNAL(pm10(uint16_t)), this, SLOT(pm10Slot(uint16_t)));
-                    connect(weatherStation, SIGNAL(pressure(float)), this, SLOT(pressureSlot(float)));
-                    connect(weatherStation, SIGNAL(illuminance(uint32_t)), this, SLOT(illuminanceSlot(uint32_t)));
-                    connect(weatherStation, SIGNAL(rainfall(float)), this, SLOT(rainfallSlot(float)));
-                    connect(weatherStation, SIGNAL(setSlaveId(uint8_t)), this, SLOT(setSlaveIdSlot(uint8_t)));
-                    connect(weatherStation, SIGNAL(setWindDirectionOffset(uint8_t)), this, SLOT(setWindDirectionOffsetSlot(uint8_t)));
-                    connect(weatherStation, SIGNAL(resetWindSpeed()), this, SLOT(resetWindSpeedSlot()));
-                    connect(weatherStation, SIGNAL(resetRainfall()), this, SLOT(resetRainfallSlot()));
-                    connect(weatherStation, SIGNAL(stationError(weatherStationErrors_t)), this, SLOT(wsErrorSlot(weatherStationErrors_t)));
-
-                    emit modbusInit();
-                }
-                else
-                {
-                    delete modbus;
-                    std::cout << "[ConsoleManager] Can`t create weather station!" << std::endl;
-                }
-            }
-            else
-                std::cout << "[ConsoleManager] Can`t create modbus!" << std::endl;
+            startStation(baudRate);
 
             currentCommand = COMMAND_NONE;
         }
         break;
     case COMMAND_CHOOSE_WS_COMMAND:
-        if (numCommand <= 0 || numCommand > 14)
+        if (numCommand <= 0 || numCommand > 22)
         {
             std::cout << "Invalid number of command!" << std::endl;
             std::cout << "Enter command number: " << std::flush;
         }
         else
         {
+            currentCommand = COMMAND_NONE;
             switch(numCommand)
             {
             case 1:
@@ -421,8 +539,18 @@ void ConsoleManager::readCommand()
             case 19:
                 emit resetRainfall();
                 break;
+            case 20:
+                showStatistics();
+                break;
+            case 21:
+                currentCommand = COMMAND_CHOOSE_HISTORY_QUERY;
+                std::cout << "Enter query (<measurement> <minutes back> <bucket seconds>, for ex. pm10 60 300): " << std::flush;
+                break;
+            case 22:
+                currentCommand = COMMAND_CHOOSE_POLL_GROUP;
+                std::cout << "Enter poll group of station profile (1-" << (StationProfile::MAX_GROUPS - 1) << "): " << std::flush;
+                break;
             }
-            currentCommand = COMMAND_NONE;
         }
         break;
     case COMMAND_CHOOSE_WS_SLAVEID:
@@ -476,13 +604,187 @@ void ConsoleManager::readCommand()
             currentCommand = COMMAND_NONE;
         }
         break;
+    case COMMAND_CHOOSE_HISTORY_QUERY:
+        queryHistory(line);
+        break;
+    case COMMAND_CHOOSE_POLL_GROUP:
+        if (numCommand <= 0 || numCommand >= StationProfile::MAX_GROUPS)
+        {
+            std::cout << "Invalid poll group!" << std::endl;
+            std::cout << "Enter poll group of station profile (1-" << (StationProfile::MAX_GROUPS - 1) << "): " << std::flush;
+        }
+        else
+        {
+            emit readPollGroup(numCommand);
+            currentCommand = COMMAND_NONE;
+        }
+        break;
     default:
         break;
     }
 }
 
+void ConsoleManager::startFromWarmState()
+{
+    static const char *baudRateNames[] = { "2400", "4800", "9600" };
+    warmValue_t value;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int type = 0;
+
+    std::cout << "Warm start: device - " << warmState->getDevice() << ", baud rate - " << baudRateNames[warmState->getBaudRate()]
+              << ", slave ID - " << static_cast<int>(warmState->getSlaveId()) << std::endl;
+    // Last values are served stale, until they are refreshed by readings
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        if (!warmState->getValue(static_cast<weatherStationRequestType_t>(type), &value))
+            continue;
+        std::cout << "\t" << WeatherStation::measurementName(static_cast<weatherStationRequestType_t>(type)) << ": " << value.value
+                  << " (stale, " << (now - value.timestamp) / 1000 << " s)" << std::endl;
+        if (0 != sharedReadings)
+            sharedReadings->restoreValue(warmState->getSlaveId(), static_cast<weatherStationRequestType_t>(type), value.timestamp, value.value);
+    }
+
+    deviceNames->clear();
+    delete deviceNames;
+    deviceName = warmState->getDevice();
+    warmStart = true;
+    currentCommand = COMMAND_NONE;
+    startStation(warmState->getBaudRate());
+}
+
+void ConsoleManager::startStation(BaudRate baudRate)
+{
+    ModBus::mbRetryPolicy_t retryPolicy;
+    QObject *publisher = 0;
+
+    if (0 != (modbus = new ModBus::ModBusMaster(deviceName, baudRate)))
+    {
+        modbus->setCapture(frameCapture);
+        retryPolicy = modbus->getRetryPolicy();
+        retryPolicy.maxRetries = maxRetries;
+        retryPolicy.breakerThreshold = breakerThreshold;
+        retryPolicy.parkOnLoss = parkOnPortLoss;
+        modbus->setRetryPolicy(retryPolicy);
+        if (0 <= adapterLatency)
+            modbus->setAdapterLatency(static_cast<uint16_t>(adapterLatency));
+        if (SCHED_OTHER != busThreadConfig.policy || 0 <= busThreadConfig.cpu)
+            modbus->setThreadConfig(busThreadConfig);
+        if (0 != warmState)
+        {
+            // Overhead of other bus is cleared by change of bus
+            warmState->setBus(deviceName.toUtf8().data(), baudRate);
+            warmState->setMaster(modbus);
+            modbus->setInitialOverhead(warmState->getTransactionOverhead());
+        }
+        if (0 != (weatherStation = new WeatherStation(modbus)))
+        {
+            weatherStation->setCacheMaxAge(cacheMaxAge);
+            if (warmStart)
+                weatherStation->setKnownSlaveId(warmState->getSlaveId());
+            if (0 < decodeWorkers && 0 == decodePipeline)
+                decodePipeline = new DecodePipeline(decodeWorkers, this);
+            weatherStation->setPipeline(decodePipeline);
+            if (0 != metricsServer)
+                metricsServer->addMaster(modbus);
+            if (0 != gatewayPort && 0 != (gateway = new ModBus::ModBusGateway(modbus)))
+                gateway->listen(gatewayPort);
+
+            connect(this, SIGNAL(modbusInit()), modbus, SLOT(startInitSlot()));
+            connect(modbus, SIGNAL(portConfigured()), this, SLOT(portConfiguredSlot()));
+            connect(modbus, SIGNAL(error(ModBus::ModBusError)), this, SLOT(modbusErrorSlot(ModBus::ModBusError)));
+            connect(modbus, SIGNAL(portLost()), this, SLOT(portLostSlot()));
+            connect(modbus, SIGNAL(portRestored()), this, SLOT(portRestoredSlot()));
+
+            connect(this, SIGNAL(wsRequestSlaveId()), weatherStation, SLOT(requestSlaveIdSlot()));
+            connect(this, SIGNAL(getBaudRate()), weatherStation, SLOT(requestBaudRate()));
+            connect(this, SIGNAL(getWindSpeed()), weatherStation, SLOT(requestWindSpeed()));
+            connect(this, SIGNAL(getWindStrength()), weatherStation, SLOT(requestWindStrength()));
+            connect(this, SIGNAL(getWindDirection()), weatherStation, SLOT(requestWindDirection()));
+            connect(this, SIGNAL(getWindDirectionGrad()), weatherStation, SLOT(requestWindDirectionGrad()));
+            connect(this, SIGNAL(getWindDirectionGrad()), weatherStation, SLOT(requestHumidity()));
+            connect(this, SIGNAL(getTemperature()), weatherStation, SLOT(requestTemperature()));
+            connect(this, SIGNAL(getNoise()), weatherStation, SLOT(requestNoise()));
+            connect(this, SIGNAL(getPM2_5()), weatherStation, SLOT(requestPM2_5()));
+            connect(this, SIGNAL(getPM10()), weatherStation, SLOT(requestPM10()));
+            connect(this, SIGNAL(getPressure()), weatherStation, SLOT(requestPressure()));
+            connect(this, SIGNAL(getIlluminanceQ()), weatherStation, SLOT(requestIlluminanceQ()));
+            connect(this, SIGNAL(getIlliminance()), weatherStation, SLOT(requestIlluminance()));
+            connect(this, SIGNAL(getRainfall()), weatherStation, SLOT(requestRainfall()));
+            connect(this, SIGNAL(setSlaveId(uint8_t)), weatherStation, SLOT(requestSetSlaveId(uint8_t)));
+            connect(this, SIGNAL(setWindDirectionOffset(uint8_t)), weatherStation, SLOT(requestSetWindDirectionOffset(uint8_t)));
+            connect(this, SIGNAL(resetZeroWindSpeed()), weatherStation, SLOT(requestResetZeroWindSpeed()));
+            connect(this, SIGNAL(resetRainfall()), weatherStation, SLOT(requestResetRainfall()));
+            connect(this, SIGNAL(readPollGroup(uint8_t)), weatherStation, SLOT(requestPollGroup(uint8_t)));
+
+            connect(weatherStation, SIGNAL(connectionSetuped()), this, SLOT(wsConfiguredSlot()));
+            connect(weatherStation, SIGNAL(baudRate(uint16_t)), this, SLOT(baudRateSlot(uint16_t)));
+            connect(weatherStation, SIGNAL(windSpeed(float)), this, SLOT(windSpeedSlot(float)));
+            connect(weatherStation, SIGNAL(windStrength(uint16_t)), this, SLOT(windStrengthSlot(uint16_t)));
+            connect(weatherStation, SIGNAL(windDirection(QString)), this, SLOT(windDirectionSlot(QString)));
+            connect(weatherStation, SIGNAL(windDirectionGrad(uint16_t)), this, SLOT(windDirectionGradSlot(uint16_t)));
+            connect(weatherStation, SIGNAL(humidity(float)), this, SLOT(humiditySlot(float)));
+            connect(weatherStation, SIGNAL(temperature(float)), this, SLOT(temperatureSlot(float)));
+            connect(weatherStation, SIGNAL(noise(float)), this, SLOT(noiseSlot(float)));
+            connect(weatherStation, SIGNAL(pm2_5(uint16_t)), this, SLOT(pm2_5Slot(uint16_t)));
+            connect(weatherStation, SIGNAL(pm10(uint16_t)), this, SLOT(pm10Slot(uint16_t)));
+            connect(weatherStation, SIGNAL(pressure(float)), this, SLOT(pressureSlot(float)));
+            connect(weatherStation, SIGNAL(illuminance(uint32_t)), this, SLOT(illuminanceSlot(uint32_t)));
+            connect(weatherStation, SIGNAL(rainfall(float)), this, SLOT(rainfallSlot(float)));
+            connect(weatherStation, SIGNAL(setSlaveId(uint8_t)), this, SLOT(setSlaveIdSlot(uint8_t)));
+            connect(weatherStation, SIGNAL(setWindDirectionOffset(uint8_t)), this, SLOT(setWindDirectionOffsetSlot(uint8_t)));
+            connect(weatherStation, SIGNAL(resetWindSpeed()), this, SLOT(resetWindSpeedSlot()));
+            connect(weatherStation, SIGNAL(resetRainfall()), this, SLOT(resetRainfallSlot()));
+            connect(weatherStation, SIGNAL(stationError(weatherStationErrors_t)), this, SLOT(wsErrorSlot(weatherStationErrors_t)));
+            connect(weatherStation, SIGNAL(newReading(weatherReading_t)), weatherAggregator, SLOT(readingSlot(weatherReading_t)));
+            if (0 != warmState)
+                connect(weatherStation, SIGNAL(newReading(weatherReading_t)), warmState, SLOT(readingSlot(weatherReading_t)), Qt::DirectConnection);
+            // Aggregates are calculated from all readings, storage and export get only significant changes
+            publisher = weatherStation;
+            if (0 != deadbandFilter)
+            {
+                connect(weatherStation, SIGNAL(newReading(weatherReading_t)), deadbandFilter, SLOT(readingSlot(weatherReading_t)), Qt::DirectConnection);
+                publisher = deadbandFilter;
+            }
+            connect(publisher, SIGNAL(newReading(weatherReading_t)), historyStore, SLOT(readingSlot(weatherReading_t)));
+            // Slot of station is written from thread, which decodes station, without queueing
+            if (0 != sharedReadings)
+                connect(publisher, SIGNAL(newReading(weatherReading_t)), sharedReadings, SLOT(readingSlot(weatherReading_t)), Qt::DirectConnection);
+            // Exporters get aligned site frames instead of readings as they come
+            if (0 < samplePeriod && 0 != (sampler = new EpochSampler(samplePeriod, this)))
+            {
+                sampler->addStation(weatherStation);
+                publisher = sampler;
+            }
+            for (int i = 0; i < exporters.size(); i++)
+                connect(publisher, SIGNAL(newReading(weatherReading_t)), exporters[i], SLOT(readingSlot(weatherReading_t)));
+            if (adaptivePolling && 0 != (poller = new AdaptivePoller(weatherStation, modbus, this)))
+            {
+                poller->setBudget(pollBudget);
+                for (QMap<int, pollRule_t>::iterator it = pollRules.begin(); it != pollRules.end(); ++it)
+                    poller->setRule(static_cast<weatherStationRequestType_t>(it.key()), it.value());
+            }
+
+            emit modbusInit();
+        }
+        else
+        {
+            delete modbus;
+            std::cout << "[ConsoleManager] Can`t create weather station!" << std::endl;
+        }
+    }
+    else
+        std::cout << "[ConsoleManager] Can`t create modbus!" << std::endl;
+}
+
 void ConsoleManager::startWeatherStationCommand()
 {
+    // Polled values are printed continuously, so menu is shown only after command and input is not interrupted
+    if ((0 != poller || 0 != sampler) && COMMAND_NONE != currentCommand)
+    {
+        if (COMMAND_CHOOSE_WS_COMMAND == currentCommand)
+            std::cout << "Enter command number: " << std::flush;
+        return;
+    }
     std::cout << "Choose command:" << std::endl;
     std::cout << "1.  Get baud rate" << std::endl;
     std::cout << "2.  Get wind speed" << std::endl;
@@ -503,6 +805,96 @@ void ConsoleManager::startWeatherStationCommand()
     std::cout << "17. Set wind direction offset" << std::endl;
     std::cout << "18. Reset zero wind speed" << std::endl;
     std::cout << "19. Reset zero rainfall" << std::endl;
+    std::cout << "20. Show statistics" << std::endl;
+    std::cout << "21. Query history" << std::endl;
+    std::cout << "22. Read poll group" << std::endl;
     std::cout << "Enter command number: " << std::flush;
     currentCommand = COMMAND_CHOOSE_WS_COMMAND;
 }
+
+void ConsoleManager::showStatistics()
+{
+    static const weatherStationRequestType_t types[] = { WS_RT_WINDSPEED, WS_RT_HUMIDITY, WS_RT_TEMPERATURE, WS_RT_NOISE,
+                                                         WS_RT_PM2_5, WS_RT_PM10, WS_RT_PRESSURE, WS_RT_ILLUMINANCE };
+    static const char *windowNames[WS_AW_COUNT] = { "1 min", "10 min", "1 hour" };
+    weatherAggregate_t aggregate;
+    weatherWindAggregate_t wind;
+    uint8_t slaveId = weatherStation->getSlaveId();
+    unsigned int i = 0;
+    int window = 0;
+
+    for (window = 0; window < WS_AW_COUNT; window++)
+    {
+        std::cout << "Statistics for " << windowNames[window] << ":" << std::endl;
+        for (i = 0; i < sizeof(types) / sizeof(types[0]); i++)
+        {
+            if (weatherAggregator->aggregate(slaveId, types[i], static_cast<weatherAggregationWindow_t>(window), &aggregate))
+            {
+                std::cout << "\t" << WeatherStation::measurementName(types[i]) << ": mean " << aggregate.mean
+                          << ", stddev " << aggregate.stddev << ", min " << aggregate.min << ", max " << aggregate.max
+                          << " (" << aggregate.count << " samples)" << std::endl;
+            }
+        }
+        if (weatherAggregator->windAggregate(slaveId, static_cast<weatherAggregationWindow_t>(window), &wind))
+        {
+            std::cout << "\twind: speed " << wind.scalarSpeed << " m/s, vector " << wind.vectorSpeed << " m/s "
+                      << wind.vectorDirection << "°" << std::endl;
+        }
+        std::cout << "\train: " << weatherAggregator->rainfallAmount(slaveId, static_cast<weatherAggregationWindow_t>(window)) << " mm" << std::endl;
+    }
+    if (0 != deadbandFilter)
+        std::cout << "Published " << deadbandFilter->getPublished() << " of " << deadbandFilter->getReceived() << " readings" << std::endl;
+    if (0 != decodePipeline && 0 != decodePipeline->getOverflows())
+        std::cout << "Dropped " << decodePipeline->getOverflows() << " responses on full decode ring" << std::endl;
+    if (0 != sampler)
+        std::cout << "Sampled " << sampler->getCompleteEpochs() << " complete of " << sampler->getEpochs() << " epochs" << std::endl;
+    startWeatherStationCommand();
+}
+
+void ConsoleManager::queryHistory(const std::string &line)
+{
+    QVector<historyBucket_t> buckets;
+    QElapsedTimer queryTimer;
+    char name[32];
+    int minutes = 0;
+    int bucketSeconds = 0;
+    int type = 0;
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    qint64 total = 0;
+
+    if (3 != sscanf(line.c_str(), "%31s %d %d", name, &minutes, &bucketSeconds) || 0 >= minutes || 0 >= bucketSeconds)
+    {
+        std::cout << "Invalid query!" << std::endl;
+        std::cout << "Enter query (<measurement> <minutes back> <bucket seconds>, for ex. pm10 60 300): " << std::flush;
+        return;
+    }
+    if (WS_RT_UNKNOWN == (type = StationCodec::typeByName(name, strlen(name))))
+    {
+        std::cout << "Unknown measurement!" << std::endl;
+        currentCommand = COMMAND_NONE;
+        startWeatherStationCommand();
+        return;
+    }
+
+    queryTimer.start();
+    total = historyStore->query(weatherStation->getSlaveId(), static_cast<weatherStationRequestType_t>(type),
+                                now - static_cast<qint64>(minutes) * 60000, now, static_cast<qint64>(bucketSeconds) * 1000, &buckets);
+    if (0 > total)
+    {
+        std::cout << "Too many buckets, use longer bucket!" << std::endl;
+        currentCommand = COMMAND_NONE;
+        startWeatherStationCommand();
+        return;
+    }
+    for (int i = 0; i < buckets.size(); i++)
+    {
+        if (0 == buckets[i].count)
+            continue;
+        std::cout << "\t" << QDateTime::fromMSecsSinceEpoch(buckets[i].start).toString("yyyy-MM-dd hh:mm:ss").toStdString()
+                  << ": mean " << buckets[i].mean << ", min " << buckets[i].min << ", max " << buckets[i].max
+                  << " (" << buckets[i].count << " samples)" << std::endl;
+    }
+    std::cout << "Query done: " << total << " samples, " << queryTimer.nsecsElapsed() / 1000 << " us" << std::endl;
+    currentCommand = COMMAND_NONE;
+    startWeatherStationCommand();
+}
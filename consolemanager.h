@@ -2,12 +2,28 @@
 #define CONSOLEMANAGER_H
 
 #include <QObject>
+#include <QList>
+#include <string>
 #include "modbus.h"
 #include "weatherstation.h"
+#include "realtime.h"
+#include "adaptivepoller.h"
+#include "deadbandfilter.h"
+
+class WeatherAggregator;
+class HistoryStore;
+class ReadingExporter;
+class MetricsServer;
+class SharedReadings;
+class DecodePipeline;
+class WarmState;
+class EpochSampler;
 
 namespace ModBus
 {
     class ModBusMaster;
+    class FrameCapture;
+    class ModBusGateway;
 }
 class QSocketNotifier;
 class QStringList;
@@ -28,6 +44,92 @@ public:
      * @brief start start work
      */
     void start();
+    /**
+     * @brief addExporter add exporter of weather station readings
+     * @param exporter pointer to exporter (ownership is taken)
+     */
+    void addExporter(ReadingExporter *exporter);
+    /**
+     * @brief setMetricsServer set server of bus metrics
+     * @param server pointer to metrics server (ownership is taken)
+     */
+    void setMetricsServer(MetricsServer *server);
+    /**
+     * @brief setFrameCapture set capture of frames on bus
+     * @param capture pointer to frame capture (ownership is taken)
+     */
+    void setFrameCapture(ModBus::FrameCapture *capture);
+    /**
+     * @brief setCacheMaxAge set max age of cached measurements of weather station
+     * @param maxAge max age (ms), 0 - cache is disabled
+     */
+    void setCacheMaxAge(int maxAge);
+    /**
+     * @brief setGatewayPort set port of Modbus TCP gateway to bus
+     * @param port TCP port, 0 - gateway is disabled
+     */
+    void setGatewayPort(uint16_t port);
+    /**
+     * @brief setRetries set max amount of retries after timeout or incorrect CRC
+     * @param retries amount of retries, 0 - without retries
+     */
+    void setRetries(uint8_t retries);
+    /**
+     * @brief setBreakerThreshold set amount of failed requests in a row, after which station is not requested
+     * @param threshold amount of failed requests, 0 - circuit breaker is disabled
+     */
+    void setBreakerThreshold(uint8_t threshold);
+    /**
+     * @brief setParkOnPortLoss set handling of requests while serial port is lost (adapter is unplugged)
+     * @param park true - requests wait for reopen of port (default), false - they fail at once
+     */
+    void setParkOnPortLoss(bool park);
+    /**
+     * @brief setAdapterLatency set max delay of received bytes in serial adapter
+     * @param latency latency (ms), -1 - default of bus master
+     */
+    void setAdapterLatency(int latency);
+    /**
+     * @brief setBusThreadConfig set scheduling policy and CPU of bus I/O thread
+     * @param config options of thread
+     */
+    void setBusThreadConfig(const rtThreadConfig_t &config);
+    /**
+     * @brief setDecodeWorkers set amount of workers, which decode measurements out of bus thread
+     * @param workers amount of workers, 0 - measurements are decoded in bus thread
+     */
+    void setDecodeWorkers(int workers);
+    /**
+     * @brief setSharedReadings set shared memory table of latest values
+     * @param readings pointer to shared readings (ownership is taken)
+     */
+    void setSharedReadings(SharedReadings *readings);
+    /**
+     * @brief setPollBudget enable adaptive polling of weather station and set its budget of bus time
+     * @param budget part of bus time (0 - 1)
+     */
+    void setPollBudget(double budget);
+    /**
+     * @brief setPollRule enable adaptive polling of weather station and set rule of polling of measurement
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param rule rule of polling (see pollRule_t)
+     */
+    void setPollRule(weatherStationRequestType_t type, const pollRule_t &rule);
+    /**
+     * @brief setDeadbandFilter set report-by-exception filter of readings for history and exporters
+     * @param filter pointer to deadband filter (ownership is taken)
+     */
+    void setDeadbandFilter(DeadbandFilter *filter);
+    /**
+     * @brief setWarmState set state file, from which bus and station of previous run are taken without questions
+     * @param state pointer to opened warm state (ownership is taken)
+     */
+    void setWarmState(WarmState *state);
+    /**
+     * @brief setSampleEpoch enable time-aligned sampling of all measurements of station for exporters
+     * @param period period of epochs (ms, 0 - disabled)
+     */
+    void setSampleEpoch(int period);
 
 signals:
     /**
@@ -117,10 +219,17 @@ signals:
      * @brief resetRainfall send request for reset level of rainfall
      */
     void resetRainfall();
+    /**
+     * @brief readPollGroup send requests for read all measurements of poll group
+     * @param group poll group of station profile
+     */
+    void readPollGroup(uint8_t group);
 
 private slots:
     void readCommand();
     void portConfiguredSlot();
+    void portLostSlot();
+    void portRestoredSlot();
     void wsConfiguredSlot();
     void baudRateSlot(uint16_t baudRate);
     void windSpeedSlot(float speed);
@@ -143,7 +252,11 @@ private slots:
     void wsErrorSlot(weatherStationErrors_t errorCode);
 
 private:
+    void startFromWarmState();
+    void startStation(ModBus::BaudRate baudRate);
     void startWeatherStationCommand();
+    void showStatistics();
+    void queryHistory(const std::string &line);
 
     enum CommandType
     {
@@ -153,14 +266,41 @@ private:
         COMMAND_CHOOSE_WS_COMMAND,
         COMMAND_CHOOSE_WS_SLAVEID,
         COMMAND_CHOOSE_WS_BAUDRATE,
-        COMMAND_CHOOSE_WS_WINDOFFSET
+        COMMAND_CHOOSE_WS_WINDOFFSET,
+        COMMAND_CHOOSE_HISTORY_QUERY,
+        COMMAND_CHOOSE_POLL_GROUP
     };
 
     WeatherStation *weatherStation;
+    WeatherAggregator *weatherAggregator;
+    HistoryStore *historyStore;
+    QList<ReadingExporter *> exporters;
+    MetricsServer *metricsServer;
+    ModBus::FrameCapture *frameCapture;
+    ModBus::ModBusGateway *gateway;
+    SharedReadings *sharedReadings;
+    DecodePipeline *decodePipeline;
+    AdaptivePoller *poller;
+    DeadbandFilter *deadbandFilter;
+    WarmState *warmState;
+    EpochSampler *sampler;
+    int samplePeriod;
+    bool warmStart;
     QSocketNotifier *socketNotifier;
     ModBus::ModBusMaster *modbus;
     QStringList *deviceNames;
     CommandType currentCommand;
+    int cacheMaxAge;
+    uint16_t gatewayPort;
+    uint8_t maxRetries;
+    uint8_t breakerThreshold;
+    bool parkOnPortLoss;
+    int adapterLatency;
+    rtThreadConfig_t busThreadConfig;
+    int decodeWorkers;
+    bool adaptivePolling;
+    double pollBudget;
+    QMap<int, pollRule_t> pollRules;
     QString deviceName;
 };
 
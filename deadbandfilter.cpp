@@ -0,0 +1,121 @@
+#include "deadbandfilter.h"
+#include "modbusmetrics.h"
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEADBAND_EPSILON        1e-9    // Tolerance of comparison of scaled values of registers
+
+//! Default deadband of measurement
+typedef struct _defaultDeadband_t
+{
+    weatherStationRequestType_t type;   //!< Measurement type
+    deadbandRule_t rule;                //!< Deadband
+} defaultDeadband_t;
+
+// Deadbands are about resolution of station, every value is published at least once in 10 minutes
+static const defaultDeadband_t defaultDeadbands[] =
+{
+    { WS_RT_WINDSPEED, { 0.2, 0, 60000 } },
+    { WS_RT_WINDSTRENGTH, { 0, 0, 60000 } },
+    { WS_RT_WINDDIRECTION, { 0, 0, 60000 } },
+    { WS_RT_WINDDIRECTIONGRAD, { 5.0, 0, 60000 } },
+    { WS_RT_HUMIDITY, { 0.5, 0, 600000 } },
+    { WS_RT_TEMPERATURE, { 0.1, 0, 600000 } },
+    { WS_RT_NOISE, { 1.0, 0, 600000 } },
+    { WS_RT_PM2_5, { 2.0, 0, 600000 } },
+    { WS_RT_PM10, { 2.0, 0, 600000 } },
+    { WS_RT_PRESSURE, { 0.02, 0, 600000 } },
+    { WS_RT_ILLUMINANCE, { 0, 5.0, 600000 } },
+    { WS_RT_RAINFALL, { 0.1, 0, 600000 } }
+};
+
+DeadbandFilter::DeadbandFilter(QObject *parent) :
+    QObject(parent)
+{
+    unsigned int i = 0;
+
+    memset(rules, 0, sizeof(rules));
+    memset(stations, 0, sizeof(stations));
+    received = 0;
+    published = 0;
+    for (i = 0; i < sizeof(defaultDeadbands) / sizeof(defaultDeadbands[0]); i++)
+        rules[defaultDeadbands[i].type] = defaultDeadbands[i].rule;
+}
+
+DeadbandFilter::~DeadbandFilter()
+{
+    int i = 0;
+
+    for (i = 0; i < 256; i++)
+        delete stations[i];
+}
+
+void DeadbandFilter::setRule(weatherStationRequestType_t type, const deadbandRule_t &rule)
+{
+    if (WS_RT_WINDSPEED <= type && WS_RT_RAINFALL >= type)
+        rules[type] = rule;
+}
+
+bool DeadbandFilter::parseRule(const char *text, weatherStationRequestType_t *type, deadbandRule_t *rule)
+{
+    const char *separator = strchr(text, ':');
+    char *end = 0;
+
+    if (0 == separator || WS_RT_UNKNOWN == (*type = StationCodec::typeByName(text, separator - text)))
+        return false;
+
+    rule->absolute = strtod(separator + 1, &end);
+    if (':' != *end || 0 > rule->absolute)
+        return false;
+    rule->percent = strtod(end + 1, &end);
+    if (':' != *end || 0 > rule->percent)
+        return false;
+    rule->maxSilence = static_cast<int>(strtol(end + 1, &end, 10));
+    return 0 == *end && 0 <= rule->maxSilence;
+}
+
+void DeadbandFilter::readingSlot(weatherReading_t reading)
+{
+    stationState_t *state = stations[reading.slaveId];
+    uint32_t bit = 0;
+
+    ModBus::ModBusMetrics::add(&received);
+    if (WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type)
+    {
+        ModBus::ModBusMetrics::add(&published);
+        emit newReading(reading);
+        return;
+    }
+
+    if (0 == state)
+    {
+        state = new stationState_t;
+        memset(state, 0, sizeof(stationState_t));
+        stations[reading.slaveId] = state;
+    }
+    bit = 1U << reading.type;
+
+    if (0 != (state->validMask & bit) && !significant(reading.type, state->values[reading.type], reading.value) &&
+        (0 == rules[reading.type].maxSilence || reading.timestamp - state->publishTime[reading.type] < rules[reading.type].maxSilence))
+        return;
+
+    state->values[reading.type] = reading.value;
+    state->validMask |= bit;
+    state->publishTime[reading.type] = reading.timestamp;
+    ModBus::ModBusMetrics::add(&published);
+    emit newReading(reading);
+}
+
+bool DeadbandFilter::significant(weatherStationRequestType_t type, double last, double value)
+{
+    const deadbandRule_t *rule = &rules[type];
+    double change = StationCodec::changeOf(type, last, value);
+
+    if (0 == change)
+        return false;
+    if (0 == rule->absolute && 0 == rule->percent)
+        return true;
+    return (0 != rule->absolute && rule->absolute <= change + DEADBAND_EPSILON) ||
+           (0 != rule->percent && rule->percent * fabs(last) / 100 <= change + DEADBAND_EPSILON);
+}
@@ -0,0 +1,90 @@
+#ifndef DEADBANDFILTER_H
+#define DEADBANDFILTER_H
+
+#include <QObject>
+#include "weatherstation.h"
+
+//! Deadband of measurement
+typedef struct _deadbandRule_t
+{
+    double absolute;                    //!< Min change from published value (units of measurement), 0 - not checked
+    double percent;                     //!< Min change from published value (% of value), 0 - not checked
+    int maxSilence;                     //!< Max time without publication of value (ms), 0 - without heartbeat
+} deadbandRule_t;
+
+/**
+ * @brief The DeadbandFilter class provide report-by-exception filter of weather station readings
+ *
+ * Reading is published only when it differs from last published value of measurement by absolute or
+ * percent deadband (when both are 0, by any change), or when value has not been published for max
+ * silence (heartbeat). Readings, which are not measurements (for ex. reset of rainfall), are always
+ * published.
+ * Filter is called directly from thread, which decodes station, state of station is kept by slave id
+ * and one station is decoded by one thread at once, so filter does not lock.
+ */
+class DeadbandFilter : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief DeadbandFilter class constructor (rules are defaults of measurements)
+     * @param parent parent class
+     */
+    explicit DeadbandFilter(QObject *parent = 0);
+    ~DeadbandFilter();
+    /**
+     * @brief setRule set deadband of measurement (must be called before readings)
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param rule deadband (see deadbandRule_t)
+     */
+    void setRule(weatherStationRequestType_t type, const deadbandRule_t &rule);
+    /**
+     * @brief parseRule parse deadband of measurement
+     * @param text rule in format <measurement>:<absolute>:<percent>:<max silence ms> (for ex. pressure:0.05:0:600000)
+     * @param type pointer for measurement type
+     * @param rule pointer for rule
+     * @return false if text is incorrect
+     */
+    static bool parseRule(const char *text, weatherStationRequestType_t *type, deadbandRule_t *rule);
+    /**
+     * @brief getReceived get amount of received readings
+     * @return amount of readings
+     */
+    inline uint64_t getReceived() { return received; }
+    /**
+     * @brief getPublished get amount of published readings
+     * @return amount of readings
+     */
+    inline uint64_t getPublished() { return published; }
+
+signals:
+    /**
+     * @brief newReading emitted for reading, which has passed deadband
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void newReading(weatherReading_t reading);
+
+public slots:
+    /**
+     * @brief readingSlot filter reading of station (must be connected directly)
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+
+private:
+    typedef struct _stationState_t
+    {
+        uint32_t validMask;
+        double values[WS_RT_RAINFALL + 1];
+        qint64 publishTime[WS_RT_RAINFALL + 1];
+    } stationState_t;
+
+    bool significant(weatherStationRequestType_t type, double last, double value);
+
+    deadbandRule_t rules[WS_RT_RAINFALL + 1];
+    stationState_t *stations[256];
+    volatile uint64_t received;
+    volatile uint64_t published;
+};
+
+#endif // DEADBANDFILTER_H
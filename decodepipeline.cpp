@@ -0,0 +1,149 @@
+#include "decodepipeline.h"
+#include "weatherstation.h"
+#include "logger.h"
+#include <string.h>
+
+DecodePipeline::DecodePipeline(int workers, QObject *parent) :
+    QObject(parent)
+{
+    int i = 0;
+
+    rings = new stationRing_t[MAX_STATIONS];
+    // Rings are touched once, so bus threads do not take page faults on first frames
+    memset(rings, 0, sizeof(stationRing_t) * MAX_STATIONS);
+    sem_init(&pending, 0, 0);
+    stationsAmount = 0;
+    overflows = 0;
+    running = true;
+
+    for (i = 0; i < workers; i++)
+    {
+        this->workers.append(new Worker(this, i));
+        this->workers.last()->start();
+    }
+}
+
+DecodePipeline::~DecodePipeline()
+{
+    stop();
+    sem_destroy(&pending);
+    delete[] rings;
+}
+
+int DecodePipeline::addStation(WeatherStation *station)
+{
+    int index = stationsAmount;
+
+    if (MAX_STATIONS <= index)
+    {
+        LOG_ERROR("DecodePipeline", "Too many stations!");
+        return -1;
+    }
+
+    rings[index].station = station;
+    // Ring must be filled before it becomes visible for workers
+    __sync_synchronize();
+    stationsAmount = index + 1;
+    return index;
+}
+
+bool DecodePipeline::submit(int stationIndex, ModBus::mbTransaction_t *transaction, weatherStationRequestType_t requestType)
+{
+    stationRing_t *ring = &rings[stationIndex];
+    uint32_t position = ring->head;
+    item_t *item = 0;
+    uint64_t dropped = 0;
+
+    if (position - ring->tail >= RING_SIZE)
+    {
+        // Bus thread is not blocked by slow workers, warning is repeated on every power of two
+        dropped = __sync_add_and_fetch(&overflows, 1);
+        if (0 == (dropped & (dropped - 1)))
+            LOG_WARNING("DecodePipeline", "Ring of station is full, %llu responses have been dropped!", static_cast<unsigned long long>(dropped));
+        return false;
+    }
+
+    item = &ring->items[position & (RING_SIZE - 1)];
+    item->transaction = transaction;
+    item->requestType = requestType;
+
+    // Item must be filled before it becomes visible for workers
+    __sync_synchronize();
+    ring->head = position + 1;
+    sem_post(&pending);
+    return true;
+}
+
+void DecodePipeline::stop()
+{
+    int i = 0;
+
+    if (!running)
+        return;
+
+    running = false;
+    for (i = 0; i < workers.size(); i++)
+        sem_post(&pending);
+    for (i = 0; i < workers.size(); i++)
+    {
+        workers.at(i)->wait();
+        delete workers.at(i);
+    }
+    workers.clear();
+    // Responses received after stop of workers are decoded by caller
+    while (drainStations(0));
+}
+
+void DecodePipeline::work(int index)
+{
+    while (running)
+    {
+        sem_wait(&pending);
+        // Workers start from different stations, so they do not contend for one ring
+        while (drainStations(index));
+    }
+}
+
+bool DecodePipeline::drainStations(int start)
+{
+    int amount = stationsAmount;
+    bool drained = false;
+    int i = 0;
+
+    __sync_synchronize();
+    for (i = 0; i < amount; i++)
+    {
+        if (drainRing(&rings[(start + i) % amount]))
+            drained = true;
+    }
+    return drained;
+}
+
+bool DecodePipeline::drainRing(stationRing_t *ring)
+{
+    item_t *item = 0;
+    uint32_t position = 0;
+    int count = 0;
+
+    if (ring->head == ring->tail || !__sync_bool_compare_and_swap(&ring->claimed, 0, 1))
+        return false;
+
+    // Station is drained by batches, so busy station does not hold worker from others
+    for (position = ring->tail; position != ring->head && BATCH_SIZE > count; position++, count++)
+    {
+        __sync_synchronize();
+        item = &ring->items[position & (RING_SIZE - 1)];
+        ring->station->decodeReading(item->transaction, item->requestType);
+
+        delete item->transaction->txFrame;
+        delete item->transaction->rxFrame;
+        delete item->transaction;
+        __sync_synchronize();
+        ring->tail = position + 1;
+    }
+
+    // Frame put while ring was claimed is found on next pass of releasing worker
+    __sync_lock_release(&ring->claimed);
+    __sync_synchronize();
+    return true;
+}
@@ -0,0 +1,101 @@
+#ifndef DECODEPIPELINE_H
+#define DECODEPIPELINE_H
+
+#include <QThread>
+#include <QList>
+#include <semaphore.h>
+#include "modbuscodec.h"
+#include "stationcodec.h"
+
+class WeatherStation;
+
+/**
+ * @brief The DecodePipeline class provide pool of workers, which decode responses of stations out of bus threads
+ *
+ * Bus thread of station only puts received frame into lock-free ring of station (single producer).
+ * Idle worker takes any station with frames (station is drained by one worker at once, so order of its
+ * readings is kept), decodes frames and emits signals of station, so consumers connected directly
+ * run in worker and queued consumers are not posted from bus thread.
+ */
+class DecodePipeline : public QObject
+{
+    Q_OBJECT
+public:
+    enum
+    {
+        MAX_STATIONS = 64,                              //!< Max amount of stations
+        RING_SIZE = 256,                                //!< Amount of frames in ring of station (power of two)
+        BATCH_SIZE = 32                                 //!< Max amount of frames decoded before switch to other station
+    };
+
+    /**
+     * @brief DecodePipeline class constructor
+     * @param workers amount of worker threads
+     * @param parent parent class
+     */
+    explicit DecodePipeline(int workers, QObject *parent = 0);
+    ~DecodePipeline();
+    /**
+     * @brief addStation register station (called from main thread)
+     * @param station pointer to station
+     * @return index of station in pipeline, -1 if there are too many stations
+     */
+    int addStation(WeatherStation *station);
+    /**
+     * @brief submit put response into ring of station (called from bus thread of station only)
+     * @param stationIndex index of station (see addStation)
+     * @param transaction pointer to finished transaction (memory is freed by pipeline)
+     * @param requestType type of request
+     * @return false if ring is full (transaction is not taken, caller drops it)
+     */
+    bool submit(int stationIndex, ModBus::mbTransaction_t *transaction, weatherStationRequestType_t requestType);
+    /**
+     * @brief getOverflows get amount of responses, which have been dropped on full ring
+     * @return amount of responses
+     */
+    inline uint64_t getOverflows() { return overflows; }
+    /**
+     * @brief stop decode remaining responses and stop workers
+     */
+    void stop();
+
+private:
+    typedef struct _item_t
+    {
+        ModBus::mbTransaction_t *transaction;
+        weatherStationRequestType_t requestType;
+    } item_t;
+
+    typedef struct _stationRing_t
+    {
+        WeatherStation *station;
+        item_t items[RING_SIZE];
+        volatile uint32_t head;
+        volatile uint32_t tail;
+        volatile int claimed;
+    } stationRing_t;
+
+    class Worker : public QThread
+    {
+    public:
+        Worker(DecodePipeline *pipeline, int index) : QThread() { this->pipeline = pipeline; this->index = index; }
+    protected:
+        void run() { pipeline->work(index); }
+    private:
+        DecodePipeline *pipeline;
+        int index;
+    };
+
+    void work(int index);
+    bool drainStations(int start);
+    bool drainRing(stationRing_t *ring);
+
+    stationRing_t *rings;
+    QList<Worker *> workers;
+    sem_t pending;
+    volatile int stationsAmount;
+    volatile uint64_t overflows;
+    volatile bool running;
+};
+
+#endif // DECODEPIPELINE_H
@@ -0,0 +1,205 @@
+#include "epochsampler.h"
+#include "logger.h"
+#include <QTimer>
+#include <QDateTime>
+#include <string.h>
+#include <algorithm>
+
+EpochSampler::EpochSampler(int period, QObject *parent) :
+    QObject(parent)
+{
+    epochPeriod = std::max(1, period);
+    epochTimeout = epochPeriod / 2;
+    collecting = false;
+    epochs = 0;
+    completeEpochs = 0;
+    nextEpoch = 0;
+    frame.epoch = 0;
+    frame.firstCapture = 0;
+    frame.lastCapture = 0;
+    frame.completeAmount = 0;
+
+    if (0 != (epochTimer = new QTimer(this)))
+    {
+        epochTimer->setSingleShot(true);
+        connect(epochTimer, SIGNAL(timeout()), this, SLOT(epochSlot()));
+    }
+    if (0 != (timeoutTimer = new QTimer(this)))
+    {
+        timeoutTimer->setSingleShot(true);
+        connect(timeoutTimer, SIGNAL(timeout()), this, SLOT(timeoutSlot()));
+    }
+}
+
+void EpochSampler::addStation(WeatherStation *station)
+{
+    stationSample_t sample;
+
+    memset(&sample, 0, sizeof(sample));
+    stations.append(station);
+    frame.stations.append(sample);
+    firstResponses.append(0);
+    responsesAmounts.append(0);
+    // Readings are queued from threads, which decode stations, response ids of snapshot from bus thread before them
+    connect(station, SIGNAL(newReading(weatherReading_t)), this, SLOT(readingSlot(weatherReading_t)));
+    connect(station, SIGNAL(snapshotSubmitted(uint32_t,int)), this, SLOT(snapshotSlot(uint32_t,int)));
+}
+
+void EpochSampler::setTimeout(int timeout)
+{
+    epochTimeout = std::min(std::max(1, timeout), epochPeriod);
+}
+
+void EpochSampler::start()
+{
+    scheduleEpoch();
+}
+
+void EpochSampler::stop()
+{
+    collecting = false;
+    epochTimer->stop();
+    timeoutTimer->stop();
+}
+
+void EpochSampler::scheduleEpoch()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+    // Epoch is next multiple of period, so it does not drift by time of handling (timer may fire early)
+    nextEpoch = std::max((now / epochPeriod + 1) * epochPeriod, nextEpoch + epochPeriod);
+    epochTimer->start(static_cast<int>(std::max(static_cast<qint64>(0), nextEpoch - now)));
+}
+
+void EpochSampler::epochSlot()
+{
+    uint16_t regAddr = 0;
+    uint16_t regsAmount = 0;
+    uint32_t expectedMask = 0;
+    int type = 0;
+    int i = 0;
+
+    // Epoch, which has not been completed until next one, is published as is
+    if (collecting)
+        publish();
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        // Quality of illuminance is not read by snapshot, cardinal wind direction is not published as reading
+        if (WS_RT_ILLUMINANCE_Q == type || WS_RT_WINDDIRECTION == type ||
+            !StationCodec::readRequest(static_cast<weatherStationRequestType_t>(type), &regAddr, &regsAmount))
+            continue;
+        expectedMask |= 1U << type;
+    }
+
+    frame.epoch = nextEpoch;
+    frame.firstCapture = 0;
+    frame.lastCapture = 0;
+    frame.completeAmount = 0;
+    for (i = 0; i < stations.size(); i++)
+    {
+        frame.stations[i].slaveId = stations[i]->getSlaveId();
+        frame.stations[i].expectedMask = expectedMask;
+        frame.stations[i].validMask = 0;
+        responsesAmounts[i] = 0;
+    }
+    collecting = true;
+
+    // Every station gets planned range reads by one handoff, stations are requested back to back
+    for (i = 0; i < stations.size(); i++)
+        stations[i]->requestSnapshot();
+    timeoutTimer->start(epochTimeout);
+    scheduleEpoch();
+}
+
+void EpochSampler::timeoutSlot()
+{
+    if (collecting)
+        publish();
+}
+
+void EpochSampler::readingSlot(weatherReading_t reading)
+{
+    stationSample_t *sample = 0;
+    int i = 0;
+
+    if (!collecting || WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type || -1 == (i = stationIndex(sender())))
+        return;
+
+    // Readings of polling and of late responses of previous epochs are not samples of epoch
+    sample = &frame.stations[i];
+    if (reading.response - firstResponses[i] >= static_cast<uint32_t>(responsesAmounts[i]) ||
+        0 == (sample->expectedMask & (1U << reading.type)) || 0 != (sample->validMask & (1U << reading.type)))
+        return;
+
+    sample->values[reading.type] = reading.value;
+    sample->captureTime[reading.type] = reading.timestamp;
+    sample->validMask |= 1U << reading.type;
+    if (0 == frame.firstCapture || reading.timestamp < frame.firstCapture)
+        frame.firstCapture = reading.timestamp;
+    frame.lastCapture = std::max(frame.lastCapture, reading.timestamp);
+
+    if (sample->validMask != sample->expectedMask || ++frame.completeAmount < frame.stations.size())
+        return;
+    timeoutTimer->stop();
+    publish();
+}
+
+void EpochSampler::snapshotSlot(uint32_t firstResponse, int amount)
+{
+    int i = 0;
+
+    if (!collecting || -1 == (i = stationIndex(sender())))
+        return;
+    firstResponses[i] = firstResponse;
+    responsesAmounts[i] = amount;
+}
+
+int EpochSampler::stationIndex(QObject *station)
+{
+    int i = 0;
+
+    // Stations of different buses may have the same slave id, so station is found by sender
+    for (i = 0; i < stations.size(); i++)
+    {
+        if (station == stations[i])
+            return i;
+    }
+    return -1;
+}
+
+void EpochSampler::publish()
+{
+    weatherReading_t reading;
+    int type = 0;
+    int i = 0;
+
+    collecting = false;
+    epochs++;
+    if (frame.completeAmount == frame.stations.size())
+    {
+        completeEpochs++;
+        LOG_DEBUG("EpochSampler", "Epoch %lld: %d stations, spread %lld ms", frame.epoch, frame.completeAmount,
+                  frame.lastCapture - frame.firstCapture);
+    }
+    else
+        LOG_WARNING("EpochSampler", "Epoch %lld: %d of %d stations have answered!", frame.epoch, frame.completeAmount,
+                    static_cast<int>(frame.stations.size()));
+
+    emit siteFrame(frame);
+    reading.timestamp = frame.epoch;
+    // Values of site frame are one update
+    reading.response = static_cast<uint32_t>(epochs);
+    for (i = 0; i < frame.stations.size(); i++)
+    {
+        reading.slaveId = frame.stations[i].slaveId;
+        for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+        {
+            if (0 == (frame.stations[i].validMask & (1U << type)))
+                continue;
+            reading.type = static_cast<weatherStationRequestType_t>(type);
+            reading.value = frame.stations[i].values[type];
+            emit newReading(reading);
+        }
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef EPOCHSAMPLER_H
+#define EPOCHSAMPLER_H
+
+#include <QObject>
+#include <QVector>
+#include "weatherstation.h"
+
+class QTimer;
+
+//! Readings of station in epoch
+typedef struct _stationSample_t
+{
+    uint8_t slaveId;                            //!< Slave id of station at start of epoch (may repeat on different buses)
+    uint32_t expectedMask;                      //!< Bitmask of requested measurements (by measurement type)
+    uint32_t validMask;                         //!< Bitmask of received measurements
+    double values[WS_RT_RAINFALL + 1];          //!< Values by measurement type
+    qint64 captureTime[WS_RT_RAINFALL + 1];     //!< Time of receiving of values (ms since epoch)
+} stationSample_t;
+
+//! Aligned readings of all stations of site
+typedef struct _siteFrame_t
+{
+    qint64 epoch;                               //!< Time of epoch (ms since epoch, multiple of period)
+    qint64 firstCapture;                        //!< Time of first received value (ms since epoch, 0 - nothing is received)
+    qint64 lastCapture;                         //!< Time of last received value (ms since epoch)
+    int completeAmount;                         //!< Amount of stations, which have answered all requested measurements
+    QVector<stationSample_t> stations;          //!< Samples of stations in order of adding
+} siteFrame_t;
+
+/**
+ * @brief The EpochSampler class provide time-aligned sampling of all measurements of several stations
+ *
+ * Epochs are multiples of period on wall clock, so samplers of different sites are aligned too. At epoch
+ * all stations get snapshot reads of all measurements of profile at once (see WeatherStation::requestSnapshot,
+ * stations on different buses are read in parallel, reads of one bus go back to back). Only readings of
+ * responses to snapshot reads of current epoch are taken (see WeatherStation::snapshotSubmitted). Readings are
+ * stamped with epoch and time of receiving, site frame is published, when all stations have answered or timeout
+ * of epoch has expired.
+ */
+class EpochSampler : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief EpochSampler class constructor
+     * @param period period of epochs (ms)
+     * @param parent parent class
+     */
+    explicit EpochSampler(int period, QObject *parent = 0);
+    /**
+     * @brief addStation add station to site (must be called before start)
+     * @param station pointer to weather station
+     */
+    void addStation(WeatherStation *station);
+    /**
+     * @brief setTimeout set max time of waiting for answers of stations after epoch
+     * @param timeout timeout (ms, default half of period, limited by period)
+     */
+    void setTimeout(int timeout);
+    /**
+     * @brief getEpochs get amount of published site frames
+     * @return amount of frames
+     */
+    inline uint64_t getEpochs() { return epochs; }
+    /**
+     * @brief getCompleteEpochs get amount of site frames, which have all measurements of all stations
+     * @return amount of frames
+     */
+    inline uint64_t getCompleteEpochs() { return completeEpochs; }
+    /**
+     * @brief start start sampling from next epoch
+     */
+    void start();
+    /**
+     * @brief stop stop sampling (current epoch is not published)
+     */
+    void stop();
+
+signals:
+    /**
+     * @brief siteFrame emitted when readings of epoch have been collected (connect directly, frame is reused)
+     * @param frame aligned readings of all stations (see siteFrame_t)
+     */
+    void siteFrame(const siteFrame_t &frame);
+    /**
+     * @brief newReading emitted for every value of published site frame, timestamp of reading is epoch
+     * @param reading aligned measurement (see weatherReading_t)
+     */
+    void newReading(weatherReading_t reading);
+
+private slots:
+    void epochSlot();
+    void timeoutSlot();
+    void readingSlot(weatherReading_t reading);
+    void snapshotSlot(uint32_t firstResponse, int amount);
+
+private:
+    int stationIndex(QObject *station);
+    void publish();
+    void scheduleEpoch();
+
+    QVector<WeatherStation *> stations;
+    QVector<uint32_t> firstResponses;
+    QVector<int> responsesAmounts;
+    siteFrame_t frame;
+    QTimer *epochTimer;
+    QTimer *timeoutTimer;
+    qint64 nextEpoch;
+    int epochPeriod;
+    int epochTimeout;
+    bool collecting;
+    uint64_t epochs;
+    uint64_t completeEpochs;
+};
+
+#endif // EPOCHSAMPLER_H
@@ -0,0 +1,131 @@
+#include "framecapture.h"
+#include "modbusmetrics.h"
+#include "logger.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define CAPTURE_FLUSH_PERIOD    50          // Period of writing frames to file (ms)
+
+ModBus::FrameCapture::FrameCapture(QObject *parent) :
+    QThread(parent)
+{
+    ring = new slot_t[RING_SIZE];
+    // Ring is touched once, so I/O thread does not take page faults on first frames
+    memset(ring, 0, sizeof(slot_t) * RING_SIZE);
+    head = 0;
+    tail = 0;
+    dropped = 0;
+    running = false;
+    fileDescriptor = -1;
+}
+
+ModBus::FrameCapture::~FrameCapture()
+{
+    stop();
+    delete[] ring;
+}
+
+bool ModBus::FrameCapture::open(QString fileName)
+{
+    mbCaptureFileHeader_t header;
+
+    if (-1 == (fileDescriptor = ::open(fileName.toUtf8().data(), O_WRONLY | O_CREAT | O_TRUNC, 0644)))
+    {
+        LOG_ERROR("FrameCapture", "Can`t create capture file!");
+        return false;
+    }
+
+    memcpy(header.magic, "WSCAP1", sizeof(header.magic));
+    header.version = 1;
+    if (sizeof(header) != write(fileDescriptor, &header, sizeof(header)))
+    {
+        LOG_ERROR("FrameCapture", "Can`t write capture file!");
+        close(fileDescriptor);
+        fileDescriptor = -1;
+        return false;
+    }
+
+    running = true;
+    start();
+    return true;
+}
+
+void ModBus::FrameCapture::stop()
+{
+    if (running)
+    {
+        running = false;
+        wait();
+    }
+    if (-1 != fileDescriptor)
+    {
+        drain();
+        close(fileDescriptor);
+        fileDescriptor = -1;
+    }
+}
+
+void ModBus::FrameCapture::record(Direction direction, const uint8_t *data, uint16_t length, uint8_t flags)
+{
+    slot_t *slot = 0;
+    uint32_t position = head;
+
+    if (position - tail >= RING_SIZE)
+    {
+        __sync_fetch_and_add(&dropped, 1);
+        return;
+    }
+    if (FRAME_MAX_SIZE < length)
+        length = FRAME_MAX_SIZE;
+
+    slot = &ring[position & (RING_SIZE - 1)];
+    slot->header.timestamp = monotonicTime();
+    slot->header.direction = direction;
+    slot->header.flags = flags;
+    slot->header.length = length;
+    memcpy(slot->data, data, length);
+
+    // Slot must be filled before it becomes visible for writing thread
+    __sync_synchronize();
+    head = position + 1;
+}
+
+void ModBus::FrameCapture::run()
+{
+    while (running)
+    {
+        drain();
+        msleep(CAPTURE_FLUSH_PERIOD);
+    }
+}
+
+void ModBus::FrameCapture::drain()
+{
+    static uint8_t buffer[64 * 1024];
+    uint32_t last = head;
+    uint32_t position = tail;
+    size_t size = 0;
+    slot_t *slot = 0;
+
+    __sync_synchronize();
+    for (; position != last; position++)
+    {
+        slot = &ring[position & (RING_SIZE - 1)];
+        if (sizeof(buffer) - size < sizeof(mbCaptureRecordHeader_t) + slot->header.length)
+        {
+            if (static_cast<ssize_t>(size) != write(fileDescriptor, buffer, size))
+                LOG_ERROR("FrameCapture", "Can`t write capture file!");
+            size = 0;
+        }
+        memcpy(&buffer[size], &slot->header, sizeof(mbCaptureRecordHeader_t));
+        size += sizeof(mbCaptureRecordHeader_t);
+        memcpy(&buffer[size], slot->data, slot->header.length);
+        size += slot->header.length;
+    }
+    __sync_synchronize();
+    tail = position;
+
+    if (0 != size && static_cast<ssize_t>(size) != write(fileDescriptor, buffer, size))
+        LOG_ERROR("FrameCapture", "Can`t write capture file!");
+}
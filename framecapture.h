@@ -0,0 +1,100 @@
+#ifndef FRAMECAPTURE_H
+#define FRAMECAPTURE_H
+
+#include <QThread>
+#include <QString>
+#include <stdint.h>
+#include "rtuengine.h"
+
+namespace ModBus
+{
+
+#pragma pack(1)
+
+//! Header of capture file
+typedef struct _mbCaptureFileHeader_t
+{
+    char magic[6];                                      //!< Magic of file ("WSCAP1")
+    uint16_t version;                                   //!< Version of format
+} mbCaptureFileHeader_t;
+
+//! Header of captured frame in capture file (frame bytes follow header)
+typedef struct _mbCaptureRecordHeader_t
+{
+    uint64_t timestamp;                                 //!< Time of frame (monotonic, ns)
+    uint8_t direction;                                  //!< Direction of frame (see FrameRecorder::Direction)
+    uint8_t flags;                                      //!< Flags of frame (see FrameRecorder::Flags)
+    uint16_t length;                                    //!< Length of frame
+} mbCaptureRecordHeader_t;
+
+#pragma pack()
+
+/**
+ * @brief The FrameCapture class provide capture of transmitted and received frames
+ *
+ * Frames are copied into preallocated ring by I/O thread without locks and allocations,
+ * own thread of class writes them to capture file. When ring is full frames are dropped and counted.
+ */
+class FrameCapture : public QThread, public FrameRecorder
+{
+    Q_OBJECT
+public:
+    enum
+    {
+        RING_SIZE = 4096,                               //!< Amount of frames in ring (power of two)
+        FRAME_MAX_SIZE = 256                            //!< Max size of frame
+    };
+
+    /**
+     * @brief FrameCapture class constructor
+     * @param parent parent class
+     */
+    explicit FrameCapture(QObject *parent = 0);
+    ~FrameCapture();
+    /**
+     * @brief open create capture file and start writing thread
+     * @param fileName path to capture file
+     * @return true if file has been created
+     */
+    bool open(QString fileName);
+    /**
+     * @brief stop write remaining frames and stop writing thread
+     */
+    void stop();
+    /**
+     * @brief record add frame to ring (called from I/O thread only)
+     * @param direction direction of frame (see FrameRecorder::Direction)
+     * @param data pointer to frame bytes
+     * @param length length of frame
+     * @param flags flags of frame (see FrameRecorder::Flags)
+     */
+    void record(Direction direction, const uint8_t *data, uint16_t length, uint8_t flags = FLAG_NONE);
+    /**
+     * @brief getDropped get amount of frames dropped on full ring
+     * @return amount of frames
+     */
+    inline uint64_t getDropped() { return dropped; }
+
+protected:
+    void run();
+
+private:
+    typedef struct _slot_t
+    {
+        mbCaptureRecordHeader_t header;
+        uint8_t data[FRAME_MAX_SIZE];
+    } slot_t;
+
+    void drain();
+
+    slot_t *ring;
+    volatile uint32_t head;
+    volatile uint32_t tail;
+    volatile uint64_t dropped;
+    volatile bool running;
+    int fileDescriptor;
+};
+
+}
+
+#endif // FRAMECAPTURE_H
@@ -0,0 +1,577 @@
+#include "historystore.h"
+#include "logger.h"
+#include <QTimer>
+#include <algorithm>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <math.h>
+#include <limits.h>
+#include <string.h>
+
+#define HISTORY_BLOCK_MAGIC     0x31485357  // "WSH1"
+#define HISTORY_BLOCK_ROWS      4096        // Rows amount in block
+#define HISTORY_VALUE_SCALE     100.0       // Scale of fixed point values
+#define HISTORY_FLUSH_PERIOD    60000       // Period of writing not stored rows (ms)
+#define HISTORY_BLOCK_TAIL      0x01        // Record holds rows of open block added since previous flush
+#define HISTORY_QUERY_BUCKETS   100000      // Max amount of buckets of query
+
+static void aggregateRows(const uint8_t *values, uint8_t width, int32_t base, uint32_t row, uint32_t rowEnd, int32_t *minValue, int32_t *maxValue, qint64 *sum)
+{
+    const uint16_t *values16 = reinterpret_cast<const uint16_t *>(values);
+    const int32_t *values32 = reinterpret_cast<const int32_t *>(values);
+    int32_t low = INT_MAX;
+    int32_t high = INT_MIN;
+    qint64 total = 0;
+    uint32_t i = 0;
+
+    // Flat loops over column of one width are vectorized by compiler
+    switch (width)
+    {
+    case sizeof(uint8_t):
+        for (i = row; i < rowEnd; i++)
+        {
+            low = std::min<int32_t>(low, values[i]);
+            high = std::max<int32_t>(high, values[i]);
+            total += values[i];
+        }
+        break;
+    case sizeof(uint16_t):
+        for (i = row; i < rowEnd; i++)
+        {
+            low = std::min<int32_t>(low, values16[i]);
+            high = std::max<int32_t>(high, values16[i]);
+            total += values16[i];
+        }
+        break;
+    default:
+        for (i = row; i < rowEnd; i++)
+        {
+            low = std::min(low, values32[i]);
+            high = std::max(high, values32[i]);
+            total += values32[i];
+        }
+        break;
+    }
+
+    // Packed values are offsets from minimal value of block
+    if (sizeof(int32_t) != width)
+    {
+        low += base;
+        high += base;
+        total += static_cast<qint64>(rowEnd - row) * base;
+    }
+    *minValue = low;
+    *maxValue = high;
+    *sum = total;
+}
+
+HistoryStore::HistoryStore(QObject *parent) :
+    QObject(parent)
+{
+    seriesMap.clear();
+    fileDescriptor = -1;
+    // Rows of stored block are read into scan buffers only for query
+    scanOffsets = new uint32_t[HISTORY_BLOCK_ROWS];
+    scanValues = new uint8_t[HISTORY_BLOCK_ROWS * sizeof(int32_t)];
+
+    if (0 != (flushTimer = new QTimer(this)))
+    {
+        connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushSlot()));
+        flushTimer->start(HISTORY_FLUSH_PERIOD);
+    }
+}
+
+HistoryStore::~HistoryStore()
+{
+    QMap<int, series_t *>::iterator it;
+    int i = 0;
+
+    flushSlot();
+    if (-1 != fileDescriptor)
+        close(fileDescriptor);
+
+    for (it = seriesMap.begin(); it != seriesMap.end(); ++it)
+    {
+        for (i = 0; i < it.value()->blocks.size(); i++)
+        {
+            delete[] it.value()->blocks[i].offsets;
+            delete[] it.value()->blocks[i].values;
+        }
+        delete it.value();
+    }
+    seriesMap.clear();
+    delete[] scanOffsets;
+    delete[] scanValues;
+}
+
+bool HistoryStore::open(QString fileName)
+{
+    if (-1 != fileDescriptor)
+        close(fileDescriptor);
+
+    if (-1 == (fileDescriptor = ::open(fileName.toUtf8().data(), O_RDWR | O_CREAT | O_APPEND, 0644)))
+    {
+        LOG_ERROR("HistoryStore", "Can`t open history file %s!", fileName.toUtf8().data());
+        return false;
+    }
+    if (!loadBlocks())
+        LOG_WARNING("HistoryStore", "History file %s has been corrupted, loaded only valid blocks!", fileName.toUtf8().data());
+    return true;
+}
+
+void HistoryStore::readingSlot(weatherReading_t reading)
+{
+    double scaled = floor(reading.value * HISTORY_VALUE_SCALE + 0.5);
+
+    if (WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type)
+        return;
+    if (INT_MAX < scaled)
+        scaled = INT_MAX;
+    else if (INT_MIN > scaled)
+        scaled = INT_MIN;
+
+    appendRow(getSeries(reading.slaveId, reading.type), reading.slaveId, reading.type, reading.timestamp, static_cast<int32_t>(scaled));
+}
+
+void HistoryStore::flushSlot()
+{
+    QMap<int, series_t *>::iterator it;
+    series_t *series = 0;
+
+    // Open block is not sealed, only its new rows are stored as tail record
+    for (it = seriesMap.begin(); it != seriesMap.end(); ++it)
+    {
+        series = it.value();
+        if (!series->blocks.isEmpty() && !series->blocks.last().sealed)
+            storeTail(&series->index.last(), &series->blocks.last());
+    }
+}
+
+qint64 HistoryStore::query(uint8_t slaveId, weatherStationRequestType_t type, qint64 from, qint64 to, qint64 bucketLength, QVector<historyBucket_t> *result)
+{
+    series_t *series = seriesMap.value((slaveId << 8) | type, 0);
+    QVector<accumulator_t> accumulators;
+    const blockIndex_t *index = 0;
+    accumulator_t *accumulator = 0;
+    uint64_t range = 0;
+    qint64 total = 0;
+    qint64 bucketsAmount = 0;
+    qint64 i = 0;
+
+    result->clear();
+    if (to <= from || 0 >= bucketLength)
+        return -1;
+
+    // Range is counted unsigned, so it does not overflow, result is allocated only for sane amount of buckets
+    range = static_cast<uint64_t>(to) - static_cast<uint64_t>(from);
+    if (HISTORY_QUERY_BUCKETS <= range / bucketLength)
+        return -1;
+    bucketsAmount = static_cast<qint64>(range / bucketLength) + (0 != range % bucketLength ? 1 : 0);
+    accumulators.resize(bucketsAmount);
+    for (i = 0; i < bucketsAmount; i++)
+    {
+        accumulators[i].count = 0;
+        accumulators[i].min = INT_MAX;
+        accumulators[i].max = INT_MIN;
+        accumulators[i].sum = 0;
+    }
+
+    if (0 != series)
+    {
+        for (i = 0; i < series->index.size(); i++)
+        {
+            index = &series->index.at(i);
+            if (0 == index->count || index->maxTimestamp < from || index->minTimestamp >= to)
+                continue;
+
+            if (index->minTimestamp >= from && index->maxTimestamp < to &&
+                (index->minTimestamp - from) / bucketLength == (index->maxTimestamp - from) / bucketLength)
+            {
+                // Whole block is in one bucket, take its aggregate from index
+                accumulator = &accumulators[(index->minTimestamp - from) / bucketLength];
+                accumulator->count += index->count;
+                accumulator->sum += index->sum;
+                accumulator->min = std::min(accumulator->min, index->minValue);
+                accumulator->max = std::max(accumulator->max, index->maxValue);
+            }
+            else
+                scanBlock(index, &series->blocks.at(i), from, to, bucketLength, accumulators.data(), bucketsAmount);
+        }
+    }
+
+    result->resize(bucketsAmount);
+    for (i = 0; i < bucketsAmount; i++)
+    {
+        (*result)[i].start = from + i * bucketLength;
+        (*result)[i].count = accumulators[i].count;
+        if (0 != accumulators[i].count)
+        {
+            (*result)[i].min = accumulators[i].min / HISTORY_VALUE_SCALE;
+            (*result)[i].max = accumulators[i].max / HISTORY_VALUE_SCALE;
+            (*result)[i].mean = static_cast<double>(accumulators[i].sum) / accumulators[i].count / HISTORY_VALUE_SCALE;
+        }
+        else
+        {
+            (*result)[i].min = 0.0;
+            (*result)[i].max = 0.0;
+            (*result)[i].mean = 0.0;
+        }
+        total += accumulators[i].count;
+    }
+    return total;
+}
+
+void HistoryStore::scanBlock(const blockIndex_t *index, const block_t *block, qint64 from, qint64 to, qint64 bucketLength, accumulator_t *accumulators, qint64 bucketsAmount)
+{
+    const uint32_t *offsets = block->offsets;
+    const uint32_t *offsetsEnd = 0;
+    const uint8_t *values = block->values;
+    qint64 bucketEnd = 0;
+    uint32_t row = 0;
+    uint32_t rowEnd = 0;
+    uint32_t lastRow = index->count;
+    int32_t minValue = 0;
+    int32_t maxValue = 0;
+    qint64 sum = 0;
+    qint64 bucket = 0;
+
+    // Stored block is read from file, values are read only for rows in range
+    if (0 == offsets)
+    {
+        if (static_cast<ssize_t>(index->count * sizeof(uint32_t)) != pread(fileDescriptor, scanOffsets, index->count * sizeof(uint32_t), block->position))
+        {
+            LOG_ERROR("HistoryStore", "Can`t read history block!");
+            return;
+        }
+        offsets = scanOffsets;
+        values = scanValues;
+    }
+    offsetsEnd = offsets + index->count;
+
+    // Rows of block are sorted by time, so range of every bucket is found by binary search
+    if (from > index->base)
+        row = std::lower_bound(offsets, offsetsEnd, static_cast<uint32_t>(from - index->base)) - offsets;
+    if (to - index->base <= UINT_MAX)
+        lastRow = std::lower_bound(offsets, offsetsEnd, static_cast<uint32_t>(to - index->base)) - offsets;
+    if (row >= lastRow)
+        return;
+    if (0 == block->values &&
+        static_cast<ssize_t>((lastRow - row) * index->width) != pread(fileDescriptor, scanValues + row * index->width, (lastRow - row) * index->width,
+                                                                     block->position + index->count * sizeof(uint32_t) + row * index->width))
+    {
+        LOG_ERROR("HistoryStore", "Can`t read history block!");
+        return;
+    }
+
+    bucket = (index->base + offsets[row] - from) / bucketLength;
+    for (; bucket < bucketsAmount && row < lastRow; bucket++)
+    {
+        bucketEnd = from + (bucket + 1) * bucketLength - index->base;
+        rowEnd = lastRow;
+        if (bucketEnd <= UINT_MAX)
+            rowEnd = std::min<uint32_t>(lastRow, std::lower_bound(offsets + row, offsetsEnd, static_cast<uint32_t>(bucketEnd)) - offsets);
+        if (rowEnd == row)
+            continue;
+
+        aggregateRows(values, index->width, index->minValue, row, rowEnd, &minValue, &maxValue, &sum);
+        accumulators[bucket].count += rowEnd - row;
+        accumulators[bucket].sum += sum;
+        accumulators[bucket].min = std::min(accumulators[bucket].min, minValue);
+        accumulators[bucket].max = std::max(accumulators[bucket].max, maxValue);
+        row = rowEnd;
+    }
+}
+
+HistoryStore::series_t *HistoryStore::getSeries(uint8_t slaveId, uint8_t type)
+{
+    series_t *series = seriesMap.value((slaveId << 8) | type, 0);
+
+    if (0 == series)
+    {
+        series = new series_t;
+        seriesMap.insert((slaveId << 8) | type, series);
+    }
+    return series;
+}
+
+void HistoryStore::appendRow(series_t *series, uint8_t slaveId, uint8_t type, qint64 timestamp, int32_t value)
+{
+    blockIndex_t *index = series->index.isEmpty() ? 0 : &series->index.last();
+    block_t *block = series->blocks.isEmpty() ? 0 : &series->blocks.last();
+    blockIndex_t newIndex;
+
+    if (0 == block || block->sealed || index->count >= HISTORY_BLOCK_ROWS ||
+        timestamp < index->maxTimestamp || timestamp - index->base > UINT_MAX)
+    {
+        if (0 != block && !block->sealed)
+        {
+            sealBlock(index, block);
+            storeSealed(index, block);
+        }
+
+        newIndex.magic = HISTORY_BLOCK_MAGIC;
+        newIndex.slaveId = slaveId;
+        newIndex.type = type;
+        newIndex.flags = 0;
+        newIndex.width = sizeof(int32_t);
+        newIndex.count = 0;
+        newIndex.base = timestamp;
+        newIndex.minTimestamp = timestamp;
+        newIndex.maxTimestamp = timestamp;
+        newIndex.minValue = value;
+        newIndex.maxValue = value;
+        newIndex.sum = 0;
+
+        block = createBlock(series, &newIndex);
+        index = &series->index.last();
+    }
+
+    block->offsets[index->count] = static_cast<uint32_t>(timestamp - index->base);
+    reinterpret_cast<int32_t *>(block->values)[index->count] = value;
+    index->count++;
+    index->maxTimestamp = timestamp;
+    index->minValue = std::min(index->minValue, value);
+    index->maxValue = std::max(index->maxValue, value);
+    index->sum += value;
+
+    if (index->count >= HISTORY_BLOCK_ROWS)
+    {
+        sealBlock(index, block);
+        storeSealed(index, block);
+    }
+}
+
+HistoryStore::block_t *HistoryStore::createBlock(series_t *series, const blockIndex_t *index)
+{
+    block_t block;
+
+    // Rows of open block are not packed, so it is allocated with full capacity
+    block.position = -1;
+    block.offsets = new uint32_t[HISTORY_BLOCK_ROWS];
+    block.values = new uint8_t[HISTORY_BLOCK_ROWS * sizeof(int32_t)];
+    block.stored = 0;
+    block.sealed = false;
+
+    series->index.append(*index);
+    series->blocks.append(block);
+    return &series->blocks.last();
+}
+
+void HistoryStore::sealBlock(blockIndex_t *index, block_t *block)
+{
+    const int32_t *rawValues = reinterpret_cast<const int32_t *>(block->values);
+    qint64 range = static_cast<qint64>(index->maxValue) - index->minValue;
+    uint32_t *offsets = new uint32_t[index->count];
+    uint8_t *values = 0;
+    uint32_t i = 0;
+
+    // Values are packed to offsets from minimal value of block, when its range allows it
+    index->width = (0xFF >= range) ? sizeof(uint8_t) : ((0xFFFF >= range) ? sizeof(uint16_t) : sizeof(int32_t));
+    values = new uint8_t[index->count * index->width];
+    switch (index->width)
+    {
+    case sizeof(uint8_t):
+        for (i = 0; i < index->count; i++)
+            values[i] = static_cast<uint8_t>(rawValues[i] - index->minValue);
+        break;
+    case sizeof(uint16_t):
+        for (i = 0; i < index->count; i++)
+            reinterpret_cast<uint16_t *>(values)[i] = static_cast<uint16_t>(rawValues[i] - index->minValue);
+        break;
+    default:
+        memcpy(values, rawValues, index->count * sizeof(int32_t));
+        break;
+    }
+    memcpy(offsets, block->offsets, index->count * sizeof(uint32_t));
+
+    delete[] block->offsets;
+    delete[] block->values;
+    block->offsets = offsets;
+    block->values = values;
+    block->stored = index->count;
+    block->sealed = true;
+}
+
+void HistoryStore::storeSealed(const blockIndex_t *index, block_t *block)
+{
+    // Rows of stored block are dropped from memory, block, which can`t be stored, keeps them for queries
+    if (-1 == (block->position = storeBlock(index, block->offsets, block->values)))
+        return;
+
+    delete[] block->offsets;
+    delete[] block->values;
+    block->offsets = 0;
+    block->values = 0;
+}
+
+void HistoryStore::storeTail(const blockIndex_t *index, block_t *block)
+{
+    const int32_t *values = reinterpret_cast<const int32_t *>(block->values);
+    blockIndex_t tail;
+    uint32_t i = 0;
+
+    if (block->stored >= index->count)
+        return;
+
+    tail = *index;
+    tail.flags = HISTORY_BLOCK_TAIL;
+    tail.width = sizeof(int32_t);
+    tail.count = index->count - block->stored;
+    tail.minTimestamp = index->base + block->offsets[block->stored];
+    tail.minValue = INT_MAX;
+    tail.maxValue = INT_MIN;
+    tail.sum = 0;
+    for (i = block->stored; i < index->count; i++)
+    {
+        tail.minValue = std::min(tail.minValue, values[i]);
+        tail.maxValue = std::max(tail.maxValue, values[i]);
+        tail.sum += values[i];
+    }
+
+    if (-1 != storeBlock(&tail, block->offsets + block->stored, block->values + block->stored * sizeof(int32_t)))
+        block->stored = index->count;
+}
+
+qint64 HistoryStore::storeBlock(const blockIndex_t *index, const uint32_t *offsets, const uint8_t *values)
+{
+    off_t position = 0;
+
+    if (-1 == fileDescriptor || -1 == (position = lseek(fileDescriptor, 0, SEEK_END)))
+        return -1;
+
+    if (sizeof(blockIndex_t) != write(fileDescriptor, index, sizeof(blockIndex_t)) ||
+        static_cast<ssize_t>(index->count * sizeof(uint32_t)) != write(fileDescriptor, offsets, index->count * sizeof(uint32_t)) ||
+        static_cast<ssize_t>(index->count * index->width) != write(fileDescriptor, values, index->count * index->width))
+    {
+        LOG_ERROR("HistoryStore", "Can`t write history block!");
+        return -1;
+    }
+    return position + sizeof(blockIndex_t);
+}
+
+bool HistoryStore::loadBlocks()
+{
+    blockIndex_t index;
+    struct stat fileStat;
+    off_t validEnd = 0;
+    ssize_t size = 0;
+
+    if (0 != fstat(fileDescriptor, &fileStat))
+        return false;
+
+    lseek(fileDescriptor, 0, SEEK_SET);
+    while (sizeof(blockIndex_t) == (size = read(fileDescriptor, &index, sizeof(blockIndex_t))))
+    {
+        if (!loadBlock(&index, fileStat.st_size))
+            break;
+        validEnd = lseek(fileDescriptor, 0, SEEK_CUR);
+    }
+    if (0 == size)
+        return true;
+
+    // Partial or corrupted record (for ex. after crash while writing) is cut, so new blocks are appended after valid ones
+    if (0 <= size && 0 != ftruncate(fileDescriptor, validEnd))
+        LOG_ERROR("HistoryStore", "Can`t truncate history file!");
+    return false;
+}
+
+bool HistoryStore::loadBlock(const blockIndex_t *index, qint64 fileSize)
+{
+    blockIndex_t newIndex = *index;
+    blockIndex_t *openIndex = 0;
+    block_t *block = 0;
+    block_t sealed;
+    series_t *series = 0;
+    uint32_t *offsets = 0;
+    uint8_t *values = 0;
+    qint64 position = 0;
+    bool tail = 0 != (index->flags & HISTORY_BLOCK_TAIL);
+
+    // Blocks of files before packing of values have zero width
+    if (0 == newIndex.width)
+        newIndex.width = sizeof(int32_t);
+    if (HISTORY_BLOCK_MAGIC != index->magic || 0 == index->count || HISTORY_BLOCK_ROWS < index->count ||
+        (sizeof(uint8_t) != newIndex.width && sizeof(uint16_t) != newIndex.width && sizeof(int32_t) != newIndex.width) ||
+        (tail && sizeof(int32_t) != newIndex.width))
+        return false;
+
+    position = lseek(fileDescriptor, 0, SEEK_CUR);
+    if (!tail)
+    {
+        // Rows of sealed block stay in file, only its position is kept
+        if (-1 == position || position + static_cast<qint64>(index->count * (sizeof(uint32_t) + newIndex.width)) > fileSize ||
+            -1 == lseek(fileDescriptor, index->count * (sizeof(uint32_t) + newIndex.width), SEEK_CUR))
+            return false;
+    }
+    else
+    {
+        offsets = new uint32_t[index->count];
+        values = new uint8_t[index->count * sizeof(int32_t)];
+        if (static_cast<ssize_t>(index->count * sizeof(uint32_t)) != read(fileDescriptor, offsets, index->count * sizeof(uint32_t)) ||
+            static_cast<ssize_t>(index->count * sizeof(int32_t)) != read(fileDescriptor, values, index->count * sizeof(int32_t)))
+        {
+            delete[] offsets;
+            delete[] values;
+            return false;
+        }
+    }
+
+    series = getSeries(index->slaveId, index->type);
+    if (!series->blocks.isEmpty() && !series->blocks.last().sealed)
+    {
+        block = &series->blocks.last();
+        openIndex = &series->index.last();
+        if (!tail && openIndex->base == index->base)
+        {
+            // Sealed block replaces tails of the same block
+            delete[] block->offsets;
+            delete[] block->values;
+            series->blocks.removeLast();
+            series->index.removeLast();
+            block = 0;
+        }
+        else if (!tail || openIndex->base != index->base || openIndex->count + index->count > HISTORY_BLOCK_ROWS)
+        {
+            // Block has not been sealed before exit, its rows are kept in memory as they are
+            sealBlock(openIndex, block);
+            block = 0;
+        }
+    }
+
+    if (!tail)
+    {
+        sealed.position = position;
+        sealed.offsets = 0;
+        sealed.values = 0;
+        sealed.stored = index->count;
+        sealed.sealed = true;
+        newIndex.flags = 0;
+        series->index.append(newIndex);
+        series->blocks.append(sealed);
+        return true;
+    }
+
+    // Tails are joined into open block, so writing of rows goes on after restart
+    if (0 == block)
+    {
+        newIndex.flags = 0;
+        newIndex.count = 0;
+        newIndex.sum = 0;
+        block = createBlock(series, &newIndex);
+    }
+    openIndex = &series->index.last();
+    memcpy(block->offsets + openIndex->count, offsets, index->count * sizeof(uint32_t));
+    memcpy(block->values + openIndex->count * sizeof(int32_t), values, index->count * sizeof(int32_t));
+    openIndex->count += index->count;
+    openIndex->minTimestamp = std::min(openIndex->minTimestamp, index->minTimestamp);
+    openIndex->maxTimestamp = std::max(openIndex->maxTimestamp, index->maxTimestamp);
+    openIndex->minValue = std::min(openIndex->minValue, index->minValue);
+    openIndex->maxValue = std::max(openIndex->maxValue, index->maxValue);
+    openIndex->sum += index->sum;
+    block->stored = openIndex->count;
+
+    delete[] offsets;
+    delete[] values;
+    return true;
+}
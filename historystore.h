@@ -0,0 +1,132 @@
+#ifndef HISTORYSTORE_H
+#define HISTORYSTORE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QMap>
+#include "weatherstation.h"
+
+class QTimer;
+
+//! Bucket of time-range query result
+typedef struct _historyBucket_t
+{
+    qint64 start;                       //!< Start time of bucket (ms since epoch)
+    uint32_t count;                     //!< Amount of samples in bucket
+    double min;                         //!< Minimal value
+    double max;                         //!< Maximal value
+    double mean;                        //!< Mean value
+} historyBucket_t;
+
+/**
+ * @brief The HistoryStore class provide persistent storage of weather station readings with time-range queries
+ *
+ * Readings are stored by series (slave id + measurement type) in blocks of columns: timestamps are kept as
+ * 32-bit offsets from block base time, values as 32-bit fixed point numbers. Full blocks are sealed with values
+ * packed to 8 or 16-bit offsets from minimal value of block, when range of block allows it. Rows of open block
+ * are flushed periodically as tail records, which are joined into open block again on load, so block is sealed
+ * only when it is full. Only sparse index and file positions of stored blocks are kept in memory, rows are read
+ * from file on demand. Index keeps for every block minimal/maximal timestamp and value, so queries skip blocks
+ * outside of range and take aggregates of blocks which are fully inside of one bucket without read of rows.
+ */
+class HistoryStore : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief HistoryStore class constructor
+     * @param parent parent class
+     */
+    explicit HistoryStore(QObject *parent = 0);
+    ~HistoryStore();
+    /**
+     * @brief open load stored history from file and append new blocks to it
+     * @param fileName path to history file
+     * @return true if file has been opened
+     */
+    bool open(QString fileName);
+    /**
+     * @brief query get bucketed aggregates of series in time range
+     * @param slaveId slave id of station
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @param from start of time range (ms since epoch, including)
+     * @param to end of time range (ms since epoch, excluding)
+     * @param bucketLength length of bucket (ms)
+     * @param result pointer to vector for buckets (buckets without samples have zero count)
+     * @return amount of samples in time range, -1 for invalid range or too many buckets
+     */
+    qint64 query(uint8_t slaveId, weatherStationRequestType_t type, qint64 from, qint64 to, qint64 bucketLength, QVector<historyBucket_t> *result);
+
+public slots:
+    /**
+     * @brief readingSlot append reading to history
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+    /**
+     * @brief flushSlot write all not stored rows to history file
+     */
+    void flushSlot();
+
+private:
+#pragma pack(1)
+    typedef struct _blockIndex_t
+    {
+        uint32_t magic;
+        uint8_t slaveId;
+        uint8_t type;
+        uint8_t flags;
+        uint8_t width;
+        uint32_t count;
+        qint64 base;
+        qint64 minTimestamp;
+        qint64 maxTimestamp;
+        int32_t minValue;
+        int32_t maxValue;
+        qint64 sum;
+    } blockIndex_t;
+#pragma pack()
+
+    typedef struct _block_t
+    {
+        qint64 position;
+        uint32_t *offsets;
+        uint8_t *values;
+        uint32_t stored;
+        bool sealed;
+    } block_t;
+
+    typedef struct _accumulator_t
+    {
+        uint32_t count;
+        int32_t min;
+        int32_t max;
+        qint64 sum;
+    } accumulator_t;
+
+    typedef struct _series_t
+    {
+        QVector<blockIndex_t> index;
+        QVector<block_t> blocks;
+    } series_t;
+
+    series_t *getSeries(uint8_t slaveId, uint8_t type);
+    void appendRow(series_t *series, uint8_t slaveId, uint8_t type, qint64 timestamp, int32_t value);
+    block_t *createBlock(series_t *series, const blockIndex_t *index);
+    void sealBlock(blockIndex_t *index, block_t *block);
+    void storeSealed(const blockIndex_t *index, block_t *block);
+    void storeTail(const blockIndex_t *index, block_t *block);
+    qint64 storeBlock(const blockIndex_t *index, const uint32_t *offsets, const uint8_t *values);
+    bool loadBlocks();
+    bool loadBlock(const blockIndex_t *index, qint64 fileSize);
+    void scanBlock(const blockIndex_t *index, const block_t *block, qint64 from, qint64 to, qint64 bucketLength, accumulator_t *accumulators, qint64 bucketsAmount);
+
+    QMap<int, series_t *> seriesMap;
+    QTimer *flushTimer;
+    uint32_t *scanOffsets;
+    uint8_t *scanValues;
+    int fileDescriptor;
+};
+
+#endif // HISTORYSTORE_H
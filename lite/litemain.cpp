@@ -0,0 +1,262 @@
+#include "rtuengine.h"
+#include "stationcodec.h"
+#include "stationprofile.h"
+#include "readplanner.h"
+#include "logger.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+/**
+ * @brief The LiteStation class print responses of weather station (Qt-free frontend)
+ */
+class LiteStation : public ModBus::RtuEngineListener
+{
+public:
+    LiteStation()
+    {
+        slaveId = 0xFF;
+        failed = 0;
+    }
+
+    void transactionFinished(ModBus::mbTransaction_t *transaction)
+    {
+        weatherStationRequestType_t type = StationCodec::requestTypeFromFrame(transaction->txFrame);
+
+        if (false == transaction->crcCheck)
+        {
+            fprintf(stderr, "%s: incorrect CRC\n", StationCodec::measurementName(type));
+            failed++;
+        }
+        else
+        {
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+            ModBus::ModBusCodec::swapByteOrder(transaction);
+#endif
+            if (ModBus::MB_ERROR_NONE != ModBus::ModBusCodec::checkError(transaction->rxFrame))
+            {
+                fprintf(stderr, "%s: %s\n", StationCodec::measurementName(type),
+                        ModBus::ModBusCodec::exceptionText(ModBus::ModBusCodec::checkError(transaction->rxFrame)));
+                failed++;
+            }
+            else if (WS_RT_SLAVEID == type)
+                slaveId = static_cast<uint8_t>(transaction->rxFrame->readRegsResp.regs[0] & 0xFF);
+            else if (WS_RT_READRANGE == type || WS_RT_READSNAPSHOT == type)
+                printRange(transaction, type);
+            else
+                printMeasurement(type, transaction->rxFrame->readRegsResp.regs);
+        }
+
+        delete transaction->txFrame;
+        delete transaction->rxFrame;
+        delete transaction;
+    }
+
+    void transactionFailed(ModBus::mbTransaction_t *transaction, ModBus::ModBusError error)
+    {
+        fprintf(stderr, "%s: request failed (error %d)\n",
+                StationCodec::measurementName(StationCodec::requestTypeFromFrame(transaction->txFrame)), error);
+        failed++;
+    }
+
+    uint8_t slaveId;
+    int failed;
+
+private:
+    void printMeasurement(weatherStationRequestType_t type, const uint16_t *regs)
+    {
+        weatherStationRequestType_t readingType = WS_RT_UNKNOWN;
+        double value = 0.0;
+
+        if (!StationCodec::decodeMeasurement(type, regs, &readingType, &value))
+            return;
+        if (WS_RT_WINDDIRECTION == type)
+            printf("%s %s\n", StationCodec::measurementName(type), StationCodec::windDirectionName(static_cast<uint16_t>(value)));
+        else
+            printf("%s %g\n", StationCodec::measurementName(readingType), value);
+    }
+
+    void printRange(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type)
+    {
+        StationProfile::profileReadField_t fields[StationProfile::MAX_MEASUREMENTS];
+        uint16_t regsAmount = ntohs(transaction->txFrame->readRegsReq.regsAmount);
+        int fieldsAmount = 0;
+        int i = 0;
+
+        // Request frame is kept in network byte order
+        if (transaction->rxFrame->readRegsResp.bytesAmount < regsAmount * sizeof(uint16_t) ||
+                0 == (fieldsAmount = StationCodec::getProfile()->readFields(ntohs(transaction->txFrame->readRegsReq.regAddr), regsAmount,
+                                                                            fields, StationProfile::MAX_MEASUREMENTS,
+                                                                            (WS_RT_READSNAPSHOT == type) ? static_cast<uint8_t>(StationProfile::SNAPSHOT_GROUP) : 0)))
+        {
+            fprintf(stderr, "poll group: response does not match profile\n");
+            failed++;
+            return;
+        }
+        for (i = 0; i < fieldsAmount; i++)
+            printMeasurement(static_cast<weatherStationRequestType_t>(fields[i].type), &transaction->rxFrame->readRegsResp.regs[fields[i].regOffset]);
+    }
+};
+
+static void printUsage(const char *name)
+{
+    printf("Usage: %s <device> [-b <2400|4800|9600>] [-s <slave id>] [-n <cycles>] [-i <interval ms>] [-p <profile>] [-g <group>] [measurement...]\n", name);
+    printf("       -b: baud rate of bus (default 9600)\n");
+    printf("       -s: slave id of station (default is requested from station)\n");
+    printf("       -n: amount of read cycles (default 1, 0 - without limit)\n");
+    printf("       -i: interval between read cycles (default 1000)\n");
+    printf("       -p: register map of station model (default built-in CWT-UWD)\n");
+    printf("       -g: read poll group of profile by planned reads instead of measurements\n");
+    printf("       measurement: wind_speed, temperature, ... (default all of profile)\n");
+}
+
+static bool request(ModBus::RtuEngine *engine, LiteStation *station, weatherStationRequestType_t type)
+{
+    uint16_t regAddr = 0;
+    uint16_t regsAmount = 0;
+
+    if (!StationCodec::readRequest(type, &regAddr, &regsAmount))
+        return false;
+    return (-1 != engine->createRequest(station, ModBus::MB_READ_HOLDING_REGISTERS_FID, station->slaveId, regAddr, regsAmount));
+}
+
+static void complete(ModBus::RtuEngine *engine)
+{
+    // Engine timer ends every transaction by response or timeout
+    while (!engine->isIdle())
+        engine->wait(-1);
+}
+
+int main(int argc, char *argv[])
+{
+    weatherStationRequestType_t types[WS_RT_RAINFALL + 1];
+    ModBus::BaudRate baudRate = ModBus::BR_9600;
+    LiteStation station;
+    ModBus::RtuEngine engine(&station);
+    StationProfile profile;
+    ModBus::mbRegisterNeed_t needs[StationProfile::MAX_MEASUREMENTS * 2];
+    ModBus::mbPlannedRead_t reads[StationProfile::MAX_MEASUREMENTS * 2];
+    uint16_t regs[StationProfile::MAX_MEASUREMENTS * 2];
+    int regsAmount = 0;
+    int readsAmount = 0;
+    int group = 0;
+    int typesAmount = 0;
+    int cycles = 1;
+    int interval = 1000;
+    int cycle = 0;
+    int i = 0;
+
+    if (2 > argc)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    for (i = 2; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "-b") && i + 1 < argc)
+        {
+            i++;
+            if (0 == strcmp(argv[i], "2400"))
+                baudRate = ModBus::BR_2400;
+            else if (0 == strcmp(argv[i], "4800"))
+                baudRate = ModBus::BR_4800;
+            else if (0 != strcmp(argv[i], "9600"))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+        }
+        else if (0 == strcmp(argv[i], "-s") && i + 1 < argc)
+            station.slaveId = static_cast<uint8_t>(atoi(argv[++i]));
+        else if (0 == strcmp(argv[i], "-n") && i + 1 < argc)
+            cycles = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-i") && i + 1 < argc)
+            interval = atoi(argv[++i]);
+        else if (0 == strcmp(argv[i], "-p") && i + 1 < argc)
+        {
+            if (!profile.load(argv[++i]))
+                return 1;
+            StationCodec::setProfile(&profile);
+        }
+        else if (0 == strcmp(argv[i], "-g") && i + 1 < argc)
+            group = atoi(argv[++i]);
+        else if (WS_RT_RAINFALL >= typesAmount && WS_RT_UNKNOWN != (types[typesAmount] = StationCodec::typeByName(argv[i], strlen(argv[i]))))
+            typesAmount++;
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    if (0 != group && 0 == (regsAmount = StationCodec::getProfile()->groupRegisters(static_cast<uint8_t>(group), regs, StationProfile::MAX_MEASUREMENTS * 2)))
+    {
+        fprintf(stderr, "Poll group %d is empty in profile %s\n", group, StationCodec::getProfile()->getName());
+        return 1;
+    }
+    else if (0 == group && 0 == typesAmount)
+    {
+        for (i = WS_RT_WINDSPEED; i <= WS_RT_RAINFALL; i++)
+        {
+            if (WS_RT_ILLUMINANCE_Q != i && 0 != StationCodec::getProfile()->measurement(static_cast<weatherStationRequestType_t>(i)))
+                types[typesAmount++] = static_cast<weatherStationRequestType_t>(i);
+        }
+    }
+
+    if (ModBus::MB_ERROR_NONE != engine.open(argv[1], baudRate))
+    {
+        fprintf(stderr, "Can`t open %s\n", argv[1]);
+        return 1;
+    }
+
+    if (0xFF == station.slaveId)
+    {
+        // Station answers slave id request on broadcast address
+        request(&engine, &station, WS_RT_SLAVEID);
+        complete(&engine);
+        if (0xFF == station.slaveId)
+        {
+            fprintf(stderr, "Station does not respond\n");
+            return 1;
+        }
+    }
+
+    for (cycle = 0; 0 == cycles || cycle < cycles; cycle++)
+    {
+        if (0 != cycle)
+            usleep(interval * 1000);
+        if (0 != regsAmount)
+        {
+            // Plan follows measured overhead of transactions of previous cycles
+            ModBus::ReadPlanner planner(engine.getFrameTiming(), engine.getTransactionOverhead());
+
+            for (i = 0; i < regsAmount; i++)
+            {
+                needs[i].slaveId = station.slaveId;
+                needs[i].fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+                needs[i].regAddr = regs[i];
+            }
+            planner.setMaxGap(StationCodec::getProfile()->getMaxGap());
+            readsAmount = planner.plan(needs, regsAmount, reads, StationProfile::MAX_MEASUREMENTS * 2);
+            for (i = 0; i < readsAmount; i++)
+                engine.createRequest(&station, ModBus::MB_READ_HOLDING_REGISTERS_FID, station.slaveId, reads[i].regAddr, reads[i].regsAmount);
+        }
+        for (i = 0; i < typesAmount; i++)
+        {
+            if (!request(&engine, &station, types[i]))
+            {
+                fprintf(stderr, "%s: not supported by profile %s\n", StationCodec::measurementName(types[i]), StationCodec::getProfile()->getName());
+                station.failed++;
+            }
+        }
+        complete(&engine);
+        fflush(stdout);
+    }
+
+    Logger::flush();
+    return (0 == station.failed) ? 0 : 2;
+}
@@ -0,0 +1,158 @@
+#include "logger.h"
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define LOGGER_DRAIN_PERIOD     10000       // Period of writing messages to stdout (us)
+
+Logger::record_t Logger::ring[Logger::RING_SIZE];
+volatile uint32_t Logger::head = 0;
+uint32_t Logger::tail = 0;
+volatile uint64_t Logger::dropped = 0;
+volatile int Logger::runtimeLevel = LOG_LEVEL_INFO;
+
+static pthread_once_t loggerOnce = PTHREAD_ONCE_INIT;
+static pthread_mutex_t drainMutex = PTHREAD_MUTEX_INITIALIZER;
+
+void Logger::setLevel(int level)
+{
+    runtimeLevel = level;
+}
+
+bool Logger::parseLevel(const char *name, int *level)
+{
+    if (0 == strcmp(name, "error"))
+        *level = LOG_LEVEL_ERROR;
+    else if (0 == strcmp(name, "warning"))
+        *level = LOG_LEVEL_WARNING;
+    else if (0 == strcmp(name, "info"))
+        *level = LOG_LEVEL_INFO;
+    else if (0 == strcmp(name, "debug"))
+        *level = LOG_LEVEL_DEBUG;
+    else
+        return false;
+    return true;
+}
+
+void Logger::write(int level, const char *tag, const char *format, ...)
+{
+    record_t *record = 0;
+    uint32_t position = 0;
+    int32_t difference = 0;
+    int length = 0;
+    va_list args;
+
+    (void)level;
+    pthread_once(&loggerOnce, start);
+
+    // Slot is taken by producer, which moved head from its position
+    position = head;
+    for (;;)
+    {
+        record = &ring[position & (RING_SIZE - 1)];
+        difference = static_cast<int32_t>(record->sequence - position);
+        if (0 == difference)
+        {
+            if (__sync_bool_compare_and_swap(&head, position, position + 1))
+                break;
+            position = head;
+        }
+        else if (0 > difference)
+        {
+            __sync_fetch_and_add(&dropped, 1);
+            return;
+        }
+        else
+            position = head;
+    }
+
+    length = snprintf(record->text, TEXT_SIZE, "[%s] ", tag);
+    if (0 <= length && TEXT_SIZE > length)
+    {
+        va_start(args, format);
+        vsnprintf(&record->text[length], TEXT_SIZE - length, format, args);
+        va_end(args);
+    }
+
+    // Message must be formatted before slot becomes visible for writing thread
+    __sync_synchronize();
+    record->sequence = position + 1;
+}
+
+void Logger::flush()
+{
+    while (drain())
+        ;
+}
+
+void Logger::start()
+{
+    pthread_t thread;
+    uint32_t i = 0;
+
+    for (i = 0; i < RING_SIZE; i++)
+        ring[i].sequence = i;
+    __sync_synchronize();
+
+    if (0 == pthread_create(&thread, 0, drainThread, 0))
+        pthread_detach(thread);
+    atexit(flush);
+}
+
+void *Logger::drainThread(void *arg)
+{
+    (void)arg;
+
+    for (;;)
+    {
+        if (!drain())
+            usleep(LOGGER_DRAIN_PERIOD);
+    }
+    return 0;
+}
+
+bool Logger::drain()
+{
+    static char buffer[16 * 1024];
+    record_t *record = 0;
+    size_t size = 0;
+    size_t length = 0;
+    ssize_t result = 0;
+    const char *pos = buffer;
+
+    pthread_mutex_lock(&drainMutex);
+    for (;;)
+    {
+        record = &ring[tail & (RING_SIZE - 1)];
+        if (record->sequence != tail + 1 || sizeof(buffer) - size < TEXT_SIZE + 1)
+            break;
+        __sync_synchronize();
+
+        length = strnlen(record->text, TEXT_SIZE);
+        memcpy(&buffer[size], record->text, length);
+        size += length;
+        buffer[size++] = '\n';
+
+        // Slot is free for producer on next pass of ring
+        __sync_synchronize();
+        record->sequence = tail + RING_SIZE;
+        tail++;
+    }
+
+    while (pos < buffer + size)
+    {
+        if (-1 == (result = ::write(STDOUT_FILENO, pos, buffer + size - pos)))
+        {
+            if (EINTR == errno)
+                continue;
+            break;
+        }
+        pos += result;
+    }
+    pthread_mutex_unlock(&drainMutex);
+    return 0 != size;
+}
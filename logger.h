@@ -0,0 +1,93 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdint.h>
+
+#define LOG_LEVEL_ERROR         0   //!< Errors
+#define LOG_LEVEL_WARNING       1   //!< Warnings
+#define LOG_LEVEL_INFO          2   //!< Information messages
+#define LOG_LEVEL_DEBUG         3   //!< Debug messages
+
+// Max level compiled into program, calls of higher levels are removed by compiler
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL           LOG_LEVEL_DEBUG
+#endif
+
+#define LOG_WRITE(level, tag, ...) \
+    do { if ((level) <= LOG_MAX_LEVEL && Logger::isEnabled(level)) Logger::write((level), (tag), __VA_ARGS__); } while (0)
+
+#define LOG_ERROR(tag, ...)     LOG_WRITE(LOG_LEVEL_ERROR, tag, __VA_ARGS__)
+#define LOG_WARNING(tag, ...)   LOG_WRITE(LOG_LEVEL_WARNING, tag, __VA_ARGS__)
+#define LOG_INFO(tag, ...)      LOG_WRITE(LOG_LEVEL_INFO, tag, __VA_ARGS__)
+#define LOG_DEBUG(tag, ...)     LOG_WRITE(LOG_LEVEL_DEBUG, tag, __VA_ARGS__)
+
+/**
+ * @brief The Logger class provide asynchronous logging to stdout
+ *
+ * Messages are formatted by calling thread into slot of preallocated ring, which is taken by one
+ * atomic compare-and-swap. Background thread writes messages to stdout, so slow or blocked terminal
+ * does not delay calling thread. When ring is full messages are dropped and counted.
+ */
+class Logger
+{
+public:
+    /**
+     * @brief isEnabled check runtime level of messages
+     * @param level level of message (see LOG_LEVEL_*)
+     * @return true if messages of level are written
+     */
+    static inline bool isEnabled(int level) { return level <= runtimeLevel; }
+    /**
+     * @brief setLevel set runtime level of messages
+     * @param level max level of written messages (see LOG_LEVEL_*)
+     */
+    static void setLevel(int level);
+    /**
+     * @brief parseLevel get level by name
+     * @param name name of level ("error", "warning", "info" or "debug")
+     * @param level pointer to result level
+     * @return true if name is correct
+     */
+    static bool parseLevel(const char *name, int *level);
+    /**
+     * @brief write add message to ring (use LOG_* macros instead)
+     * @param level level of message (see LOG_LEVEL_*)
+     * @param tag tag of message (for ex. "ModBus")
+     * @param format printf-like format of message
+     */
+    static void write(int level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+    /**
+     * @brief flush write all messages from ring to stdout
+     */
+    static void flush();
+    /**
+     * @brief getDropped get amount of messages dropped on full ring
+     * @return amount of messages
+     */
+    static inline uint64_t getDropped() { return dropped; }
+
+private:
+    enum
+    {
+        RING_SIZE = 1024,                   //!< Amount of messages in ring (power of two)
+        TEXT_SIZE = 124                     //!< Max length of message with tag
+    };
+
+    typedef struct _record_t
+    {
+        volatile uint32_t sequence;         //!< Sequence of slot: equal position - free, position + 1 - filled
+        char text[TEXT_SIZE];               //!< Formatted message
+    } record_t;
+
+    static void start();
+    static void *drainThread(void *arg);
+    static bool drain();
+
+    static record_t ring[RING_SIZE];
+    static volatile uint32_t head;
+    static uint32_t tail;
+    static volatile uint64_t dropped;
+    static volatile int runtimeLevel;
+};
+
+#endif // LOGGER_H
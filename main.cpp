@@ -1,12 +1,319 @@
 #include <QtCore/QCoreApplication>
 #include "modbusmaster.h"
 #include "consolemanager.h"
+#include "readingexporter.h"
+#include "metricsserver.h"
+#include "framecapture.h"
+#include "capturereplay.h"
+#include "logger.h"
+#include "sharedreadings.h"
+#include "busscanner.h"
+#include "realtime.h"
+#include "stationprofile.h"
+#include "adaptivepoller.h"
+#include "deadbandfilter.h"
+#include "warmstate.h"
+#include <iostream>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#define MAX_RETRIES             16          // Max amount of retries of request (backoff reaches its max long before)
+
+static void printUsage(const char *name)
+{
+    std::cout << "Usage: " << name << " [--export <csv|jsonl|influx>:<destination>]... [--metrics <port>] [--capture <file>]" << std::endl;
+    std::cout << "       " << name << " [--log-level <error|warning|info|debug>] [--cache-max-age <ms>]" << std::endl;
+    std::cout << "       " << name << " [--gateway <port>] [--shm <name>] [--retries <n>] [--breaker <failures>]" << std::endl;
+    std::cout << "       " << name << " [--fail-on-port-loss]" << std::endl;
+    std::cout << "       " << name << " [--adapter-latency <ms>] [--rt-policy <other|fifo:<priority>|rr:<priority>>] [--rt-cpu <cpu>] [--mlock]" << std::endl;
+    std::cout << "       " << name << " [--decode-workers <n>] [--profile <file>]" << std::endl;
+    std::cout << "       " << name << " [--poll-budget <percent>] [--poll <measurement>:<min ms>:<max ms>:<threshold>]..." << std::endl;
+    std::cout << "       " << name << " [--report-by-exception] [--deadband <measurement>:<absolute>:<percent>:<max silence ms>]..." << std::endl;
+    std::cout << "       " << name << " [--state <file>] [--sample-epoch <ms>]" << std::endl;
+    std::cout << "       " << name << " --replay <file> [iterations]" << std::endl;
+    std::cout << "       " << name << " --scan <device>[,<device>...] [response timeout ms]" << std::endl;
+    std::cout << "       destination: - (stdout), unix:<socket path> or path to file/pipe" << std::endl;
+    std::cout << "       port: local TCP port of Prometheus metrics endpoint" << std::endl;
+    std::cout << "       --capture: write transmitted and received frames to capture file" << std::endl;
+    std::cout << "       --replay: decode frames of capture file as fast as possible and exit" << std::endl;
+    std::cout << "       --scan: find slaves 1-247 at every baud rate on all devices in parallel, print map and exit" << std::endl;
+    std::cout << "       --log-level: max level of log messages (default info)" << std::endl;
+    std::cout << "       --cache-max-age: answer requests of measurements from values not older than ms" << std::endl;
+    std::cout << "       --gateway: TCP port of Modbus TCP gateway to bus" << std::endl;
+    std::cout << "       --shm: name of shared memory table of latest values (for ex. /ws_readings)" << std::endl;
+    std::cout << "       --retries: retries of request after timeout or incorrect CRC (0-16, with exponential backoff)" << std::endl;
+    std::cout << "       --breaker: failed requests in a row, after which station is only probed every 5 s" << std::endl;
+    std::cout << "       --fail-on-port-loss: fail requests while serial port is lost instead of waiting for its reopen" << std::endl;
+    std::cout << "       --adapter-latency: max delay of received bytes in serial adapter (default 20, 0 for native UART)" << std::endl;
+    std::cout << "       --rt-policy, --rt-cpu: scheduling policy and CPU of bus I/O thread" << std::endl;
+    std::cout << "       --mlock: lock memory of process in RAM" << std::endl;
+    std::cout << "       --decode-workers: workers, which decode and publish measurements out of bus thread (default 1, 0 - in bus thread)" << std::endl;
+    std::cout << "       --profile: register map of station model (default built-in CWT-UWD)" << std::endl;
+    std::cout << "       --poll-budget: poll measurements with rate adapted to changes of values within percent of bus time (default 50)" << std::endl;
+    std::cout << "       --poll: rule of adaptive polling of measurement (for ex. wind_speed:1000:10000:0.5, 0 ms - not polled)" << std::endl;
+    std::cout << "       --report-by-exception: store, export and share only significant changes of values (default deadbands)" << std::endl;
+    std::cout << "       --deadband: deadband and heartbeat of measurement (for ex. pressure:0.05:0:600000, 0 - not checked)" << std::endl;
+    std::cout << "       --state: keep bus, station, timing and last values in state file for fast restart" << std::endl;
+    std::cout << "       --sample-epoch: read all measurements at multiples of period and export them stamped with epoch" << std::endl;
+}
+
+static int scanBuses(const QStringList &devices, int responseTimeout)
+{
+    static const ModBus::BaudRate baudRates[] = { ModBus::BR_9600, ModBus::BR_4800, ModBus::BR_2400 };
+    QList<ModBus::BusScanner *> scanners;
+    QList<ModBus::mbScanResult_t> results;
+    ModBus::BusScanner *scanner = 0;
+    char id[8];
+    unsigned int j = 0;
+    int i = 0;
+    int k = 0;
+
+    // Every port is scanned by own thread
+    for (i = 0; i < devices.size(); i++)
+    {
+        if (devices.at(i).isEmpty())
+            continue;
+        scanner = new ModBus::BusScanner(devices.at(i));
+        if (0 < responseTimeout)
+            scanner->setResponseTimeout(responseTimeout);
+        scanner->start();
+        scanners.append(scanner);
+    }
+
+    for (i = 0; i < scanners.size(); i++)
+    {
+        scanner = scanners.at(i);
+        scanner->wait();
+        results = scanner->getResults();
+        std::cout << scanner->getDeviceName().toStdString() << ":" << std::endl;
+        if (results.isEmpty())
+            std::cout << "    no slaves" << std::endl;
+        for (j = 0; j < sizeof(baudRates) / sizeof(baudRates[0]); j++)
+        {
+            std::string ids;
+            for (k = 0; k < results.size(); k++)
+            {
+                if (baudRates[j] != results.at(k).baudRate)
+                    continue;
+                snprintf(id, sizeof(id), " %u", results.at(k).slaveId);
+                ids += id;
+            }
+            if (!ids.empty())
+                std::cout << "    " << ModBus::BusScanner::baudRateValue(baudRates[j]) << " baud:" << ids << std::endl;
+        }
+        delete scanner;
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
     QCoreApplication a(argc, argv);
+    ReadingExporter::ExportFormat format;
+    ReadingExporter *exporter = 0;
+    MetricsServer *metricsServer = 0;
+    ModBus::FrameCapture *frameCapture = 0;
+    SharedReadings *sharedReadings = 0;
+    StationProfile *stationProfile = 0;
+    rtThreadConfig_t busThreadConfig = RealTime::defaultConfig();
+    const char *separator = 0;
+    weatherStationRequestType_t measurementType = WS_RT_UNKNOWN;
+    pollRule_t pollRule;
+    DeadbandFilter *deadbandFilter = 0;
+    deadbandRule_t deadbandRule;
+    WarmState *warmState = 0;
+    char formatName[16];
+    char *end = 0;
+    long retries = 0;
+    int logLevel = 0;
+
+    if (3 <= argc && 0 == strcmp(argv[1], "--replay"))
+    {
+        // Master is not initialized, it is only owner of thread of station
+        ModBus::ModBusMaster *master = new ModBus::ModBusMaster("", ModBus::BR_9600);
+        CaptureReplay replay(new WeatherStation(master));
+        int result = 1;
+
+        if (replay.load(argv[2]))
+        {
+            replay.replay((4 <= argc) ? atoi(argv[3]) : 1);
+            result = 0;
+        }
+        master->getEventThread()->quit();
+        master->getEventThread()->wait();
+        return result;
+    }
+
+    if (3 <= argc && 0 == strcmp(argv[1], "--scan"))
+        return scanBuses(QString(argv[2]).split(","), (4 <= argc) ? atoi(argv[3]) : 0);
 
     ConsoleManager *consoleManager = new ConsoleManager();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (0 == strcmp(argv[i], "--export") && i + 1 < argc)
+        {
+            i++;
+            if (0 == (separator = strchr(argv[i], ':')) || separator - argv[i] >= static_cast<int>(sizeof(formatName)))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            memcpy(formatName, argv[i], separator - argv[i]);
+            formatName[separator - argv[i]] = 0;
+            if (!ReadingExporter::parseFormat(formatName, &format))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            exporter = new ReadingExporter(format);
+            if (!exporter->open(separator + 1))
+            {
+                delete exporter;
+                return 1;
+            }
+            consoleManager->addExporter(exporter);
+        }
+        else if (0 == strcmp(argv[i], "--metrics") && i + 1 < argc && 0 == metricsServer)
+        {
+            metricsServer = new MetricsServer();
+            if (!metricsServer->listen(atoi(argv[++i])))
+            {
+                delete metricsServer;
+                return 1;
+            }
+            consoleManager->setMetricsServer(metricsServer);
+        }
+        else if (0 == strcmp(argv[i], "--capture") && i + 1 < argc && 0 == frameCapture)
+        {
+            frameCapture = new ModBus::FrameCapture();
+            if (!frameCapture->open(argv[++i]))
+            {
+                delete frameCapture;
+                return 1;
+            }
+            consoleManager->setFrameCapture(frameCapture);
+        }
+        else if (0 == strcmp(argv[i], "--shm") && i + 1 < argc && 0 == sharedReadings)
+        {
+            sharedReadings = new SharedReadings();
+            if (!sharedReadings->open(argv[++i]))
+            {
+                delete sharedReadings;
+                return 1;
+            }
+            consoleManager->setSharedReadings(sharedReadings);
+        }
+        else if (0 == strcmp(argv[i], "--gateway") && i + 1 < argc)
+            consoleManager->setGatewayPort(static_cast<uint16_t>(atoi(argv[++i])));
+        else if (0 == strcmp(argv[i], "--retries") && i + 1 < argc)
+        {
+            retries = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || 0 != *end || 0 > retries || MAX_RETRIES < retries)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            consoleManager->setRetries(static_cast<uint8_t>(retries));
+        }
+        else if (0 == strcmp(argv[i], "--breaker") && i + 1 < argc)
+            consoleManager->setBreakerThreshold(static_cast<uint8_t>(atoi(argv[++i])));
+        else if (0 == strcmp(argv[i], "--fail-on-port-loss"))
+            consoleManager->setParkOnPortLoss(false);
+        else if (0 == strcmp(argv[i], "--rt-policy") && i + 1 < argc)
+        {
+            if (!RealTime::parsePolicy(argv[++i], &busThreadConfig))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            consoleManager->setBusThreadConfig(busThreadConfig);
+        }
+        else if (0 == strcmp(argv[i], "--rt-cpu") && i + 1 < argc)
+        {
+            busThreadConfig.cpu = atoi(argv[++i]);
+            consoleManager->setBusThreadConfig(busThreadConfig);
+        }
+        else if (0 == strcmp(argv[i], "--mlock"))
+        {
+            if (!RealTime::lockMemory())
+                return 1;
+            RealTime::prefaultStack(256 * 1024);
+        }
+        else if (0 == strcmp(argv[i], "--profile") && i + 1 < argc && 0 == stationProfile)
+        {
+            // Profile is set before station is created and is not changed at runtime
+            stationProfile = new StationProfile();
+            if (!stationProfile->load(argv[++i]))
+            {
+                delete stationProfile;
+                return 1;
+            }
+            StationCodec::setProfile(stationProfile);
+        }
+        else if (0 == strcmp(argv[i], "--poll-budget") && i + 1 < argc)
+            consoleManager->setPollBudget(atof(argv[++i]) / 100);
+        else if (0 == strcmp(argv[i], "--poll") && i + 1 < argc)
+        {
+            if (!AdaptivePoller::parseRule(argv[++i], &measurementType, &pollRule))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            consoleManager->setPollRule(measurementType, pollRule);
+        }
+        else if (0 == strcmp(argv[i], "--report-by-exception") || (0 == strcmp(argv[i], "--deadband") && i + 1 < argc))
+        {
+            if (0 == deadbandFilter)
+            {
+                deadbandFilter = new DeadbandFilter();
+                consoleManager->setDeadbandFilter(deadbandFilter);
+            }
+            if (0 == strcmp(argv[i], "--deadband"))
+            {
+                if (!DeadbandFilter::parseRule(argv[++i], &measurementType, &deadbandRule))
+                {
+                    printUsage(argv[0]);
+                    return 1;
+                }
+                deadbandFilter->setRule(measurementType, deadbandRule);
+            }
+        }
+        else if (0 == strcmp(argv[i], "--state") && i + 1 < argc && 0 == warmState)
+        {
+            warmState = new WarmState();
+            if (!warmState->open(argv[++i]))
+            {
+                delete warmState;
+                return 1;
+            }
+            consoleManager->setWarmState(warmState);
+        }
+        else if (0 == strcmp(argv[i], "--sample-epoch") && i + 1 < argc)
+            consoleManager->setSampleEpoch(atoi(argv[++i]));
+        else if (0 == strcmp(argv[i], "--decode-workers") && i + 1 < argc)
+            consoleManager->setDecodeWorkers(atoi(argv[++i]));
+        else if (0 == strcmp(argv[i], "--adapter-latency") && i + 1 < argc)
+            consoleManager->setAdapterLatency(atoi(argv[++i]));
+        else if (0 == strcmp(argv[i], "--cache-max-age") && i + 1 < argc)
+            consoleManager->setCacheMaxAge(atoi(argv[++i]));
+        else if (0 == strcmp(argv[i], "--log-level") && i + 1 < argc)
+        {
+            if (!Logger::parseLevel(argv[++i], &logLevel))
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            Logger::setLevel(logLevel);
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
     consoleManager->start();
 
     return a.exec();
@@ -0,0 +1,156 @@
+#include "metricsserver.h"
+#include "logger.h"
+#include "modbusmaster.h"
+#include <QSocketNotifier>
+#include <vector>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+
+#define METRICS_REQUEST_MAX_SIZE    4096    // Max size of HTTP request header
+
+MetricsServer::MetricsServer(QObject *parent) :
+    QObject(parent)
+{
+    listenNotifier = 0;
+    listenDescriptor = -1;
+    masters.clear();
+}
+
+MetricsServer::~MetricsServer()
+{
+    while (!clientNotifiers.isEmpty())
+        closeClient(clientNotifiers.begin().key());
+    if (-1 != listenDescriptor)
+        close(listenDescriptor);
+}
+
+bool MetricsServer::listen(uint16_t port)
+{
+    struct sockaddr_in address;
+    int option = 1;
+
+    if (-1 == (listenDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)))
+    {
+        LOG_ERROR("MetricsServer", "Can`t create socket!");
+        return false;
+    }
+    setsockopt(listenDescriptor, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if (0 != bind(listenDescriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) || 0 != ::listen(listenDescriptor, 8))
+    {
+        LOG_ERROR("MetricsServer", "Can`t listen port %u!", port);
+        close(listenDescriptor);
+        listenDescriptor = -1;
+        return false;
+    }
+
+    listenNotifier = new QSocketNotifier(listenDescriptor, QSocketNotifier::Read, this);
+    connect(listenNotifier, SIGNAL(activated(int)), this, SLOT(acceptSlot()));
+    return true;
+}
+
+void MetricsServer::addMaster(ModBus::ModBusMaster *master)
+{
+    masters.append(master);
+}
+
+void MetricsServer::acceptSlot()
+{
+    QSocketNotifier *notifier = 0;
+    int descriptor = -1;
+
+    while (-1 != (descriptor = accept4(listenDescriptor, 0, 0, SOCK_NONBLOCK)))
+    {
+        notifier = new QSocketNotifier(descriptor, QSocketNotifier::Read, this);
+        connect(notifier, SIGNAL(activated(int)), this, SLOT(readSlot(int)));
+        clientNotifiers.insert(descriptor, notifier);
+        clientRequests.insert(descriptor, std::string());
+    }
+}
+
+void MetricsServer::readSlot(int descriptor)
+{
+    std::vector<const ModBus::ModBusMetrics *> metrics;
+    std::vector<std::string> buses;
+    std::string body;
+    std::string *request = &clientRequests[descriptor];
+    char data[1024];
+    ssize_t result = 0;
+    int i = 0;
+
+    while (0 < (result = read(descriptor, data, sizeof(data))))
+        request->append(data, result);
+
+    if (0 == result || (-1 == result && EAGAIN != errno) || METRICS_REQUEST_MAX_SIZE < request->size())
+    {
+        closeClient(descriptor);
+        return;
+    }
+    if (std::string::npos == request->find("\r\n\r\n"))
+        return;
+
+    if (0 == request->compare(0, 13, "GET /metrics ") || 0 == request->compare(0, 6, "GET / "))
+    {
+        for (i = 0; i < masters.size(); i++)
+        {
+            metrics.push_back(masters[i]->getMetrics());
+            buses.push_back(masters[i]->getDeviceName().toStdString());
+        }
+        if (!metrics.empty())
+            ModBus::ModBusMetrics::format(&metrics[0], &buses[0], static_cast<int>(metrics.size()), &body);
+        sendResponse(descriptor, "200 OK", body);
+    }
+    else
+        sendResponse(descriptor, "404 Not Found", "Not found\n");
+    closeClient(descriptor);
+}
+
+void MetricsServer::sendResponse(int descriptor, const char *status, const std::string &body)
+{
+    std::string response;
+    char header[160];
+    size_t sent = 0;
+    ssize_t result = 0;
+    int flags = fcntl(descriptor, F_GETFL);
+
+    snprintf(header, sizeof(header), "HTTP/1.0 %s\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n",
+             status, static_cast<unsigned long>(body.size()));
+    response.append(header).append(body);
+
+    // Response is small, so it is written in blocking mode
+    fcntl(descriptor, F_SETFL, flags & ~O_NONBLOCK);
+    while (sent < response.size())
+    {
+        if (0 >= (result = write(descriptor, response.data() + sent, response.size() - sent)))
+        {
+            if (-1 == result && EINTR == errno)
+                continue;
+            break;
+        }
+        sent += result;
+    }
+}
+
+void MetricsServer::closeClient(int descriptor)
+{
+    QSocketNotifier *notifier = clientNotifiers.take(descriptor);
+
+    if (0 != notifier)
+    {
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+    }
+    clientRequests.remove(descriptor);
+    close(descriptor);
+}
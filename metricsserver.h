@@ -0,0 +1,56 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QObject>
+#include <QList>
+#include <QMap>
+#include <string>
+
+class QSocketNotifier;
+
+namespace ModBus
+{
+    class ModBusMaster;
+}
+
+/**
+ * @brief The MetricsServer class provide local HTTP listener, which serves metrics of buses in Prometheus text format
+ */
+class MetricsServer : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief MetricsServer class constructor
+     * @param parent parent class
+     */
+    explicit MetricsServer(QObject *parent = 0);
+    ~MetricsServer();
+    /**
+     * @brief listen start listening on local address
+     * @param port TCP port
+     * @return true if listening has been started
+     */
+    bool listen(uint16_t port);
+    /**
+     * @brief addMaster add bus to metrics
+     * @param master pointer to master class
+     */
+    void addMaster(ModBus::ModBusMaster *master);
+
+private slots:
+    void acceptSlot();
+    void readSlot(int descriptor);
+
+private:
+    void closeClient(int descriptor);
+    void sendResponse(int descriptor, const char *status, const std::string &body);
+
+    QSocketNotifier *listenNotifier;
+    QMap<int, QSocketNotifier *> clientNotifiers;
+    QMap<int, std::string> clientRequests;
+    QList<ModBus::ModBusMaster *> masters;
+    int listenDescriptor;
+};
+
+#endif // METRICSSERVER_H
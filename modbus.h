@@ -5,6 +5,12 @@
 
 namespace ModBus
 {
+enum
+{
+    MB_FRAME_MAX_SIZE = 256,                            //!< Max size of RTU frame (address, PDU of 253 bytes and CRC)
+    MB_READ_REGS_MAX = 125                              //!< Max amount of registers in one read (function ids 0x03 and 0x04)
+};
+
 enum BaudRate
 {
     BR_2400 = 0,                                        //!< Baud rate is 2400 baud
@@ -37,7 +43,9 @@ enum ModBusError
                                                         //!< read extended memory.
     MB_ERROR_GATEWAY_PATH,                              //!< The gateway is overloaded or not correctly configured.
     MB_ERROR_GATEWAY_RESPOND,                           //!< The slave is not present on the network.
-    MB_ERROR_UNDEFINED_EXCEPTION                        //!< Undefined exception reason code.
+    MB_ERROR_UNDEFINED_EXCEPTION,                       //!< Undefined exception reason code.
+    MB_ERROR_SLAVE_UNAVAILABLE,                         //!< Request is not transmitted, slave does not respond (circuit breaker is open).
+    MB_ERROR_PORT_LOST                                  //!< Request is not transmitted, serial port has been lost (adapter is unplugged).
 };
 
 typedef enum _mbFuncId_t
@@ -146,7 +154,7 @@ typedef union
     mbException_t exception;                            //!< Structure of message with exception
     mbReadExceptionReq_t readExceptionReq;              //!< Structure of read status register request (function id 0x07)
     mbReadExceptionResp_t readExceptionResp;            //!< Structure of read status register responce (function id 0x07)
-    uint8_t uint8[100];
+    uint8_t uint8[MB_FRAME_MAX_SIZE];
 } mbFrame_t;
 
 #pragma pack()
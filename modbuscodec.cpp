@@ -0,0 +1,186 @@
+#include "modbuscodec.h"
+#include <arpa/inet.h>
+
+uint16_t ModBus::ModBusCodec::crcCalc(const uint8_t *buf, uint16_t len)
+{
+    uint16_t crc = 0xFFFF;
+    uint16_t polynom = 0xA001;
+    uint16_t i = 0;
+    uint16_t j = 0;
+
+    for (i = 0; i < len; i++)
+    {
+        crc = crc ^ buf[i];
+        for (j = 0; j < 8; j++)
+        {
+            if (crc & 0x0001)
+            {
+                crc = crc >> 1;
+                crc = crc ^ polynom;
+            }
+            else
+            {
+                crc = crc >> 1;
+            }
+        }
+    }
+    return(crc & 0xFFFF);
+}
+
+bool ModBus::ModBusCodec::checkCRC(const uint8_t *buf, uint16_t len)
+{
+    uint16_t calcCRC = crcCalc(buf, len - 2);
+    uint16_t messageCRC = (buf[len - 2] << 8) | buf[len - 1];
+    return (calcCRC == messageCRC);
+}
+
+uint16_t ModBus::ModBusCodec::responseLength(const uint8_t *rxData, uint16_t count, uint16_t rxSize)
+{
+    if (count >= rxSize)
+        return rxSize;
+    if (count >= sizeof(ModBus::mbException_t) && 0 != reinterpret_cast<const mbException_t *>(rxData)->err)
+        return sizeof(ModBus::mbException_t);
+    return 0;
+}
+
+bool ModBus::ModBusCodec::encodeRequest(mbTransaction_t *transaction, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr, uint16_t value)
+{
+    mbFrame_t *frame = transaction->txFrame;
+
+    frame->hdr.addr = slaveId;
+    frame->hdr.fid = fid;
+    frame->hdr.err = 0;
+
+    // CRC is transmitted high byte first (see checkCRC)
+    switch (fid)
+    {
+    case MB_READ_HOLDING_REGISTERS_FID:
+    case MB_READ_INPUT_REGISTERS_FID:
+        if (0 == value || MB_READ_REGS_MAX < value)
+            return false;
+        frame->readRegsReq.regAddr = htons(valAddr);
+        frame->readRegsReq.regsAmount = htons(value);
+        frame->readRegsReq.crc = htons(crcCalc(frame->uint8, sizeof(mbReadRegsReq_t) - 2));
+        transaction->txSize = sizeof(mbReadRegsReq_t);
+        transaction->rxSize = sizeof(mbReadRegsResp_t) + (sizeof(uint16_t) * value);
+        return true;
+    case MB_FORCE_SINGLE_COIL_FID:
+    case MB_FORCE_SINGLE_REGISTER_FID:
+        frame->writeRegReq.regAddr = htons(valAddr);
+        frame->writeRegReq.regVal = htons(value);
+        frame->writeRegReq.crc = htons(crcCalc(frame->uint8, sizeof(mbWriteRegReq_t) - 2));
+        transaction->txSize = sizeof(mbWriteRegReq_t);
+        transaction->rxSize = sizeof(mbWriteRegResp_t);
+        return true;
+    case MB_READ_EXCEPTION_STATUS_FID:
+        frame->readExceptionReq.crc = htons(crcCalc(frame->uint8, sizeof(mbReadExceptionReq_t) - 2));
+        transaction->txSize = sizeof(mbReadExceptionReq_t);
+        transaction->rxSize = sizeof(mbReadExceptionResp_t);
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool ModBus::ModBusCodec::encodeRequestFrame(mbRequestFrame_t *frame, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr, uint16_t value)
+{
+    mbTransaction_t transaction;
+    mbFrame_t txFrame;
+
+    memset(frame, 0, sizeof(mbRequestFrame_t));
+    transaction.txFrame = &txFrame;
+    if (!encodeRequest(&transaction, fid, slaveId, valAddr, value))
+        return false;
+
+    memcpy(frame->data, txFrame.uint8, transaction.txSize);
+    frame->txSize = transaction.txSize;
+    frame->rxSize = transaction.rxSize;
+    return true;
+}
+
+ModBus::ModBusError ModBus::ModBusCodec::checkError(const mbFrame_t *rxFrame)
+{
+    if (0 == rxFrame->hdr.err)
+        return MB_ERROR_NONE;
+
+    switch (rxFrame->exception.status)
+    {
+    case 1:
+        return MB_ERROR_ILLEGAL_FUNCTION;
+    case 2:
+        return MB_ERROR_ILLEGAL_DATA_ADDRESS;
+    case 3:
+        return MB_ERROR_ILLEGAL_DATA_VALUE;
+    case 4:
+        return MB_ERROR_SALVE_FAILURE;
+    case 5:
+        return MB_ERROR_ACKNOWLEDGE;
+    case 6:
+        return MB_ERROR_SLAVE_BUSY;
+    case 7:
+        return MB_ERROR_NEGATIVE_ACKNOWLEDGE;
+    case 8:
+        return MB_ERROR_MEMORY_PARITY;
+    case 10:
+        return MB_ERROR_GATEWAY_PATH;
+    case 11:
+        return MB_ERROR_GATEWAY_RESPOND;
+    default:
+        return MB_ERROR_UNDEFINED_EXCEPTION;
+    }
+}
+
+const char *ModBus::ModBusCodec::exceptionText(ModBusError error)
+{
+    switch (error)
+    {
+    case MB_ERROR_ILLEGAL_FUNCTION:
+        return "Illegal function";
+    case MB_ERROR_ILLEGAL_DATA_ADDRESS:
+        return "Illegal data address";
+    case MB_ERROR_ILLEGAL_DATA_VALUE:
+        return "Illegal data value";
+    case MB_ERROR_SALVE_FAILURE:
+        return "Slave device failure";
+    case MB_ERROR_ACKNOWLEDGE:
+        return "Acknowledge";
+    case MB_ERROR_SLAVE_BUSY:
+        return "Slave device busy";
+    case MB_ERROR_NEGATIVE_ACKNOWLEDGE:
+        return "Negative acknowledge";
+    case MB_ERROR_MEMORY_PARITY:
+        return "Memory parity error";
+    case MB_ERROR_GATEWAY_PATH:
+        return "Gateway path unavailable";
+    case MB_ERROR_GATEWAY_RESPOND:
+        return "Gateway target device failed to respond";
+    default:
+        return "Undefined exception";
+    }
+}
+
+void ModBus::ModBusCodec::swapByteOrder(mbTransaction_t *transaction)
+{
+    int i = 0;
+
+    if (0 != transaction->rxFrame->hdr.err || ModBus::MB_READ_EXCEPTION_STATUS_FID == transaction->txFrame->hdr.fid)
+    {
+        transaction->rxFrame->readExceptionResp.status = htons(transaction->rxFrame->readExceptionResp.status);
+        transaction->rxFrame->readExceptionResp.crc = htons(transaction->rxFrame->readExceptionResp.crc);
+    }
+    else if (ModBus::MB_READ_HOLDING_REGISTERS_FID == transaction->txFrame->hdr.fid ||
+             ModBus::MB_READ_INPUT_REGISTERS_FID == transaction->txFrame->hdr.fid)
+    {
+        for (i = 0; i < transaction->rxFrame->readRegsResp.bytesAmount / 2; i++)
+        {
+            transaction->rxFrame->readRegsResp.regs[i] = htons(transaction->rxFrame->readRegsResp.regs[i]);
+        }
+    }
+    else if (ModBus::MB_FORCE_SINGLE_COIL_FID == transaction->txFrame->hdr.fid ||
+             ModBus::MB_FORCE_SINGLE_REGISTER_FID == transaction->txFrame->hdr.fid)
+    {
+        transaction->rxFrame->writeRegResp.regAddr = htons(transaction->rxFrame->writeRegResp.regAddr);
+        transaction->rxFrame->writeRegResp.regVal = htons(transaction->rxFrame->writeRegResp.regVal);
+        transaction->rxFrame->writeRegResp.crc = htons(transaction->rxFrame->writeRegResp.crc);
+    }
+}
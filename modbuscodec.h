@@ -0,0 +1,121 @@
+#ifndef MODBUSCODEC_H
+#define MODBUSCODEC_H
+
+#include <stdint.h>
+#include <string.h>
+#include "modbus.h"
+
+namespace ModBus
+{
+
+typedef struct _mbTransaction_t
+{
+    mbFrame_t *txFrame;                 //!< Pointer to transmit frame
+    mbFrame_t *rxFrame;                 //!< Pointer to receive frame
+    uint16_t txSize;                    //!< Size of transmit frame
+    uint16_t rxSize;                    //!< Size of receive frame
+    uint16_t countReadBytes;            //!< Amount received bytes
+    uint8_t transactionId;              //!< Embedded transaction id
+    void *owner;                        //!< Pointer to creator of transaction (for ex. ModBusMasterSub)
+    bool errorChecked;                  //!< Error has been checked: false - transaction is not checked for errors
+                                        //!<                         true - transaction is checked for errors
+    bool crcCheck;                      //!< CRC is verified: false - incorrect CRC
+                                        //!<                  true - correct CRC
+    uint64_t enqueueTime;               //!< Time of transaction creation (monotonic, ns)
+    uint64_t transmitTime;              //!< Time of transmit (monotonic, ns)
+    uint64_t retryTime;                 //!< Transaction is not transmitted before this time (monotonic, ns)
+    uint8_t retries;                    //!< Amount of done retries
+    int tag;                            //!< Value of creator (see mbRequest_t::tag), is not used by engine
+} mbTransaction_t;
+
+//! Encoded request with CRC, which is built once and copied into transactions
+typedef struct _mbRequestFrame_t
+{
+    uint8_t data[sizeof(mbReadRegsReq_t)];  //!< Bytes of request (requests of supported functions are not longer than read request)
+    uint16_t txSize;                    //!< Size of request, 0 - frame is not built
+    uint16_t rxSize;                    //!< Size of normal response
+} mbRequestFrame_t;
+
+/**
+ * @brief The ModBusCodec class provide encoding and checking of RTU frames
+ *
+ * Codec does not depend on Qt and is used by both transaction engine and Qt classes.
+ */
+class ModBusCodec
+{
+public:
+    /**
+     * @brief crcCalc calculate CRC of message
+     * @param buf pointer to message
+     * @param len length of message
+     * @return CRC value
+     */
+    static uint16_t crcCalc(const uint8_t *buf, uint16_t len);
+    /**
+     * @brief checkCRC check CRC of message (CRC is last two bytes of message)
+     * @param buf pointer to message
+     * @param len length of message with CRC
+     * @return true if CRC is correct
+     */
+    static bool checkCRC(const uint8_t *buf, uint16_t len);
+    /**
+     * @brief responseLength get length of complete response in received data
+     * @param rxData pointer to received data
+     * @param count amount of received bytes
+     * @param rxSize expected size of normal response
+     * @return length of response (normal or exception), 0 if response is not complete
+     */
+    static uint16_t responseLength(const uint8_t *rxData, uint16_t count, uint16_t rxSize);
+    /**
+     * @brief encodeRequest fill request frame and sizes of transaction
+     * @param transaction pointer to transaction with allocated transmit frame
+     * @param fid function id (0x03, 0x04, 0x05, 0x06 or 0x07)
+     * @param slaveId slave id
+     * @param valAddr register/coil address
+     * @param value amount of registers for read (1 - MB_READ_REGS_MAX) or value for write
+     * @return false if function is not supported or amount of registers is incorrect
+     */
+    static bool encodeRequest(mbTransaction_t *transaction, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0);
+    /**
+     * @brief encodeRequestFrame build request with CRC for repeated transmits (see encodeRequest)
+     * @param frame pointer to request frame
+     * @param fid function id (0x03, 0x04, 0x05, 0x06 or 0x07)
+     * @param slaveId slave id
+     * @param valAddr register/coil address
+     * @param value amount of registers for read (1 - MB_READ_REGS_MAX) or value for write
+     * @return false if function is not supported or amount of registers is incorrect (txSize of frame is 0)
+     */
+    static bool encodeRequestFrame(mbRequestFrame_t *frame, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0);
+    /**
+     * @brief copyRequest fill request frame and sizes of transaction by built request (without encoding and CRC)
+     * @param transaction pointer to transaction with allocated transmit frame
+     * @param frame built request frame (see encodeRequestFrame)
+     */
+    static inline void copyRequest(mbTransaction_t *transaction, const mbRequestFrame_t &frame)
+    {
+        memcpy(transaction->txFrame->uint8, frame.data, sizeof(frame.data));
+        transaction->txSize = frame.txSize;
+        transaction->rxSize = frame.rxSize;
+    }
+    /**
+     * @brief checkError check response on exception
+     * @param rxFrame pointer to response frame
+     * @return ModBus::MB_ERROR_NONE if response has not exception and error code if else
+     */
+    static ModBusError checkError(const mbFrame_t *rxFrame);
+    /**
+     * @brief exceptionText get description of exception
+     * @param error error code (see ModBus::ModBusError)
+     * @return description of exception
+     */
+    static const char *exceptionText(ModBusError error);
+    /**
+     * @brief swapByteOrder convert values of response between network and host byte order
+     * @param transaction pointer to finished transaction
+     */
+    static void swapByteOrder(mbTransaction_t *transaction);
+};
+
+}
+
+#endif // MODBUSCODEC_H
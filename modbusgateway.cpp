@@ -0,0 +1,408 @@
+#include "modbusgateway.h"
+#include "modbusmaster.h"
+#include "logger.h"
+#include <QSocketNotifier>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+#define GATEWAY_EVENTS_MAX              32      // Max amount of events from one epoll wait
+
+#define MB_EXCEPTION_ILLEGAL_FUNCTION   0x01    // Function is not supported by gateway
+#define MB_EXCEPTION_ILLEGAL_DATA_VALUE 0x03    // Incorrect request
+#define MB_EXCEPTION_SLAVE_BUSY         0x06    // Send queue is full
+#define MB_EXCEPTION_GATEWAY_TARGET     0x0B    // Target device failed to respond
+
+ModBus::ModBusGateway::ModBusGateway(ModBusMaster *master, int cacheTime, QObject *parent)
+    : ModBusMasterSub{master, parent}
+{
+    epollNotifier = 0;
+    this->cacheTime = static_cast<uint64_t>((0 < cacheTime) ? cacheTime : 0) * 1000000ULL;
+    lastSerial = 0;
+    listenDescriptor = -1;
+    epollDescriptor = -1;
+
+    connect(this, SIGNAL(transactionFinished(ModBus::mbTransaction_t*)), this, SLOT(transactionFinishedSlot(ModBus::mbTransaction_t*)));
+    connect(this, SIGNAL(transactionFailed(uint8_t)), this, SLOT(transactionFailedSlot(uint8_t)));
+}
+
+ModBus::ModBusGateway::~ModBusGateway()
+{
+    QMap<int, pending_t *>::iterator it;
+
+    while (!clients.isEmpty())
+        closeClient(clients.begin().key());
+    for (it = pendings.begin(); it != pendings.end(); ++it)
+        delete it.value();
+    if (-1 != listenDescriptor)
+        close(listenDescriptor);
+    if (-1 != epollDescriptor)
+        close(epollDescriptor);
+}
+
+bool ModBus::ModBusGateway::listen(uint16_t port)
+{
+    struct sockaddr_in address;
+    struct epoll_event event;
+    int option = 1;
+
+    if (-1 == (listenDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0)))
+    {
+        LOG_ERROR("ModBusGateway", "Can`t create socket!");
+        return false;
+    }
+    setsockopt(listenDescriptor, SOL_SOCKET, SO_REUSEADDR, &option, sizeof(option));
+
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(port);
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+
+    if (0 != bind(listenDescriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) || 0 != ::listen(listenDescriptor, 16))
+    {
+        LOG_ERROR("ModBusGateway", "Can`t listen port %u!", port);
+        close(listenDescriptor);
+        listenDescriptor = -1;
+        return false;
+    }
+
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = listenDescriptor;
+    if (-1 == (epollDescriptor = epoll_create1(EPOLL_CLOEXEC)) || 0 != epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, listenDescriptor, &event))
+    {
+        LOG_ERROR("ModBusGateway", "Can`t create epoll descriptor!");
+        close(listenDescriptor);
+        listenDescriptor = -1;
+        return false;
+    }
+
+    // Notifier must be created in event thread of bus, where gateway lives
+    QMetaObject::invokeMethod(this, "startSlot", Qt::QueuedConnection);
+    return true;
+}
+
+void ModBus::ModBusGateway::startSlot()
+{
+    epollNotifier = new QSocketNotifier(epollDescriptor, QSocketNotifier::Read, this);
+    connect(epollNotifier, SIGNAL(activated(int)), this, SLOT(epollSlot()));
+}
+
+void ModBus::ModBusGateway::epollSlot()
+{
+    struct epoll_event events[GATEWAY_EVENTS_MAX];
+    client_t *client = 0;
+    int amount = 0;
+    int i = 0;
+
+    while (0 < (amount = epoll_wait(epollDescriptor, events, GATEWAY_EVENTS_MAX, 0)))
+    {
+        for (i = 0; i < amount; i++)
+        {
+            if (listenDescriptor == events[i].data.fd)
+            {
+                acceptClients();
+                continue;
+            }
+            if (0 == (client = clients.value(events[i].data.fd, 0)))
+                continue;
+            if (0 != (events[i].events & (EPOLLERR | EPOLLHUP)))
+            {
+                closeClient(client->descriptor);
+                continue;
+            }
+            if (0 != (events[i].events & EPOLLOUT))
+                writeClient(client);
+            if (0 != (events[i].events & EPOLLIN))
+                readClient(client);
+        }
+        if (GATEWAY_EVENTS_MAX > amount)
+            break;
+    }
+}
+
+void ModBus::ModBusGateway::acceptClients()
+{
+    struct epoll_event event;
+    client_t *client = 0;
+    int descriptor = -1;
+
+    while (-1 != (descriptor = accept4(listenDescriptor, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)))
+    {
+        if (CLIENTS_MAX <= clients.size())
+        {
+            LOG_WARNING("ModBusGateway", "Too many clients, connection has been rejected!");
+            close(descriptor);
+            continue;
+        }
+
+        memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.fd = descriptor;
+        if (0 != epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, descriptor, &event))
+        {
+            close(descriptor);
+            continue;
+        }
+
+        client = new client_t;
+        client->descriptor = descriptor;
+        client->serial = ++lastSerial;
+        client->writeWaiting = false;
+        clients.insert(descriptor, client);
+    }
+}
+
+void ModBus::ModBusGateway::readClient(client_t *client)
+{
+    const uint8_t *frame = 0;
+    uint16_t length = 0;
+    char data[1024];
+    ssize_t result = 0;
+
+    while (0 < (result = read(client->descriptor, data, sizeof(data))))
+        client->input.append(data, result);
+
+    if (0 == result || (-1 == result && EAGAIN != errno && EINTR != errno))
+    {
+        closeClient(client->descriptor);
+        return;
+    }
+
+    while (MBAP_HEADER_SIZE <= client->input.size())
+    {
+        frame = reinterpret_cast<const uint8_t *>(client->input.data());
+        length = (frame[4] << 8) | frame[5];
+        if (0 != frame[2] || 0 != frame[3] || 2 > length || PDU_MAX_SIZE + 1 < length)
+        {
+            LOG_WARNING("ModBusGateway", "Incorrect MBAP header, client has been disconnected!");
+            closeClient(client->descriptor);
+            return;
+        }
+        if (client->input.size() < 6U + length)
+            break;
+
+        handleRequest(client, frame, 6 + length);
+        client->input.erase(0, 6 + length);
+    }
+}
+
+void ModBus::ModBusGateway::writeClient(client_t *client)
+{
+    struct epoll_event event;
+    ssize_t result = 0;
+
+    while (!client->output.empty())
+    {
+        if (0 < (result = send(client->descriptor, client->output.data(), client->output.size(), MSG_NOSIGNAL)))
+            client->output.erase(0, result);
+        else if (-1 == result && EINTR == errno)
+            continue;
+        else if (-1 == result && EAGAIN == errno)
+            break;
+        else
+        {
+            // Client is closed on hang up event
+            client->output.clear();
+            break;
+        }
+    }
+
+    if (client->writeWaiting == client->output.empty())
+    {
+        client->writeWaiting = !client->output.empty();
+        memset(&event, 0, sizeof(event));
+        event.events = client->writeWaiting ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+        event.data.fd = client->descriptor;
+        epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, client->descriptor, &event);
+    }
+}
+
+void ModBus::ModBusGateway::closeClient(int descriptor)
+{
+    client_t *client = clients.take(descriptor);
+
+    epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, descriptor, 0);
+    close(descriptor);
+    delete client;
+}
+
+void ModBus::ModBusGateway::handleRequest(client_t *client, const uint8_t *frame, uint16_t length)
+{
+    QMap<uint64_t, cacheEntry_t>::iterator it;
+    pending_t *pending = 0;
+    waiter_t waiter;
+    uint16_t mbapId = (frame[0] << 8) | frame[1];
+    uint8_t unitId = frame[6];
+    uint8_t fid = frame[7];
+    uint16_t regAddr = 0;
+    uint16_t value = 0;
+    uint64_t key = 0;
+    int transactionId = -1;
+
+    waiter.descriptor = client->descriptor;
+    waiter.serial = client->serial;
+    waiter.mbapId = mbapId;
+
+    if (MB_READ_HOLDING_REGISTERS_FID != fid && MB_READ_INPUT_REGISTERS_FID != fid &&
+        MB_FORCE_SINGLE_COIL_FID != fid && MB_FORCE_SINGLE_REGISTER_FID != fid)
+    {
+        sendException(waiter.descriptor, waiter.serial, mbapId, unitId, fid, MB_EXCEPTION_ILLEGAL_FUNCTION);
+        return;
+    }
+    if (MBAP_HEADER_SIZE + 5 != length)
+    {
+        sendException(waiter.descriptor, waiter.serial, mbapId, unitId, fid, MB_EXCEPTION_ILLEGAL_DATA_VALUE);
+        return;
+    }
+    regAddr = (frame[8] << 8) | frame[9];
+    value = (frame[10] << 8) | frame[11];
+
+    if (MB_READ_HOLDING_REGISTERS_FID == fid || MB_READ_INPUT_REGISTERS_FID == fid)
+    {
+        if (0 == value || MB_READ_REGS_MAX < value)
+        {
+            sendException(waiter.descriptor, waiter.serial, mbapId, unitId, fid, MB_EXCEPTION_ILLEGAL_DATA_VALUE);
+            return;
+        }
+        key = readKey(unitId, fid, regAddr, value);
+
+        if (cache.end() != (it = cache.find(key)))
+        {
+            if (monotonicTime() - it.value().time <= cacheTime)
+            {
+                sendResponse(waiter.descriptor, waiter.serial, mbapId, unitId, it.value().pdu);
+                return;
+            }
+            cache.erase(it);
+        }
+        // Same read is already on bus, client waits its response
+        if (-1 != (transactionId = readsInFlight.value(key, -1)))
+        {
+            pendings[transactionId]->waiters.append(waiter);
+            return;
+        }
+    }
+    else
+    {
+        // Write makes cached reads of unit stale
+        for (it = cache.begin(); it != cache.end();)
+        {
+            if (unitId == static_cast<uint8_t>(it.key() >> 40))
+                it = cache.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    if (TRANSACTIONS_MAX <= pendings.size() ||
+        -1 == (transactionId = createRequest(static_cast<mbFuncId_t>(fid), unitId, regAddr, value)))
+    {
+        sendException(waiter.descriptor, waiter.serial, mbapId, unitId, fid, MB_EXCEPTION_SLAVE_BUSY);
+        return;
+    }
+
+    pending = new pending_t;
+    pending->key = key;
+    pending->unitId = unitId;
+    pending->fid = fid;
+    pending->waiters.append(waiter);
+    pendings.insert(transactionId, pending);
+    if (0 != key)
+        readsInFlight.insert(key, transactionId);
+}
+
+void ModBus::ModBusGateway::transactionFinishedSlot(ModBus::mbTransaction_t *transaction)
+{
+    const uint8_t *rx = transaction->rxFrame->uint8;
+    pending_t *pending = pendings.value(transaction->transactionId, 0);
+    cacheEntry_t entry;
+    std::string pdu;
+
+    if (transaction->crcCheck)
+    {
+        // PDU of response is frame without slave address and CRC
+        if (0 != transaction->rxFrame->hdr.err)
+            pdu.assign(reinterpret_cast<const char *>(&rx[1]), 2);
+        else
+        {
+            pdu.assign(reinterpret_cast<const char *>(&rx[1]), transaction->rxSize - 3);
+            if (0 != pending && 0 != pending->key && 0 != cacheTime)
+            {
+                entry.time = monotonicTime();
+                entry.pdu = pdu;
+                cache.insert(pending->key, entry);
+            }
+        }
+    }
+    finishPending(transaction->transactionId, pdu);
+
+    delete transaction->txFrame;
+    delete transaction->rxFrame;
+    delete transaction;
+}
+
+void ModBus::ModBusGateway::transactionFailedSlot(uint8_t transactionId)
+{
+    finishPending(transactionId, std::string());
+}
+
+void ModBus::ModBusGateway::finishPending(uint8_t transactionId, const std::string &pdu)
+{
+    pending_t *pending = pendings.take(transactionId);
+    int i = 0;
+
+    if (0 == pending)
+        return;
+    if (0 != pending->key)
+        readsInFlight.remove(pending->key);
+
+    for (i = 0; i < pending->waiters.size(); i++)
+    {
+        if (pdu.empty())
+            sendException(pending->waiters[i].descriptor, pending->waiters[i].serial, pending->waiters[i].mbapId,
+                          pending->unitId, pending->fid, MB_EXCEPTION_GATEWAY_TARGET);
+        else
+            sendResponse(pending->waiters[i].descriptor, pending->waiters[i].serial, pending->waiters[i].mbapId, pending->unitId, pdu);
+    }
+    delete pending;
+}
+
+void ModBus::ModBusGateway::sendResponse(int descriptor, uint64_t serial, uint16_t mbapId, uint8_t unitId, const std::string &pdu)
+{
+    client_t *client = clients.value(descriptor, 0);
+    char header[MBAP_HEADER_SIZE];
+
+    // Client may be disconnected or descriptor may be reused by other client
+    if (0 == client || serial != client->serial)
+        return;
+
+    header[0] = static_cast<char>(mbapId >> 8);
+    header[1] = static_cast<char>(mbapId & 0xFF);
+    header[2] = 0;
+    header[3] = 0;
+    header[4] = static_cast<char>((pdu.size() + 1) >> 8);
+    header[5] = static_cast<char>((pdu.size() + 1) & 0xFF);
+    header[6] = static_cast<char>(unitId);
+    client->output.append(header, sizeof(header)).append(pdu);
+    writeClient(client);
+}
+
+void ModBus::ModBusGateway::sendException(int descriptor, uint64_t serial, uint16_t mbapId, uint8_t unitId, uint8_t fid, uint8_t code)
+{
+    char pdu[2];
+
+    pdu[0] = static_cast<char>(fid | 0x80);
+    pdu[1] = static_cast<char>(code);
+    sendResponse(descriptor, serial, mbapId, unitId, std::string(pdu, sizeof(pdu)));
+}
+
+uint64_t ModBus::ModBusGateway::readKey(uint8_t unitId, uint8_t fid, uint16_t regAddr, uint16_t regsAmount)
+{
+    return (static_cast<uint64_t>(unitId) << 40) | (static_cast<uint64_t>(fid) << 32) | (static_cast<uint64_t>(regAddr) << 16) | regsAmount;
+}
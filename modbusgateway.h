@@ -0,0 +1,113 @@
+#ifndef MODBUSGATEWAY_H
+#define MODBUSGATEWAY_H
+
+#include <QObject>
+#include <QMap>
+#include <QList>
+#include <string>
+#include "modbusmastersub.h"
+
+class QSocketNotifier;
+
+namespace ModBus
+{
+
+/**
+ * @brief The ModBusGateway class provide Modbus TCP server, which translates requests of clients into RTU transactions on bus
+ *
+ * Sockets of clients are watched by one epoll descriptor in event thread of bus, so requests are enqueued
+ * without locks. Concurrent reads of same registers are merged into one transaction, responses of reads
+ * are kept in cache for short time. Responses are returned with original MBAP transaction ids.
+ */
+class ModBusGateway : public ModBusMasterSub
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief ModBusGateway class constructor
+     * @param master pointer to master class of bus
+     * @param cacheTime time of keeping responses of reads in cache (ms), 0 - cache is disabled
+     * @param parent parent class (must be 0)
+     */
+    explicit ModBusGateway(ModBusMaster *master, int cacheTime = 250, QObject *parent = 0);
+    ~ModBusGateway();
+    /**
+     * @brief listen start listening of Modbus TCP clients
+     * @param port TCP port (502 is standard port)
+     * @return true if listening has been started
+     */
+    bool listen(uint16_t port);
+
+private slots:
+    void startSlot();
+    void epollSlot();
+    void transactionFinishedSlot(ModBus::mbTransaction_t *transaction);
+    void transactionFailedSlot(uint8_t transactionId);
+
+private:
+    enum
+    {
+        MBAP_HEADER_SIZE = 7,           //!< Size of MBAP header with unit id
+        PDU_MAX_SIZE = 253,             //!< Max size of PDU
+        TRANSACTIONS_MAX = 16,          //!< Max amount of gateway transactions in send queue of master
+        CLIENTS_MAX = 64                //!< Max amount of connected clients
+    };
+
+    //! Connected client
+    typedef struct _client_t
+    {
+        int descriptor;                 //!< Socket descriptor
+        uint64_t serial;                //!< Serial number of connection (descriptors are reused)
+        std::string input;              //!< Received not processed data
+        std::string output;             //!< Not sent data
+        bool writeWaiting;              //!< Socket is watched for write
+    } client_t;
+
+    //! Client, which waits response
+    typedef struct _waiter_t
+    {
+        int descriptor;                 //!< Socket descriptor of client
+        uint64_t serial;                //!< Serial number of connection
+        uint16_t mbapId;                //!< MBAP transaction id of request
+    } waiter_t;
+
+    //! Transaction on bus
+    typedef struct _pending_t
+    {
+        uint64_t key;                   //!< Key of read (0 for write)
+        uint8_t unitId;                 //!< Unit id of request
+        uint8_t fid;                    //!< Function id of request
+        QList<waiter_t> waiters;        //!< Clients, which wait response
+    } pending_t;
+
+    //! Cached response of read
+    typedef struct _cacheEntry_t
+    {
+        uint64_t time;                  //!< Time of receiving (monotonic, ns)
+        std::string pdu;                //!< PDU of response
+    } cacheEntry_t;
+
+    void acceptClients();
+    void readClient(client_t *client);
+    void writeClient(client_t *client);
+    void closeClient(int descriptor);
+    void handleRequest(client_t *client, const uint8_t *frame, uint16_t length);
+    void sendResponse(int descriptor, uint64_t serial, uint16_t mbapId, uint8_t unitId, const std::string &pdu);
+    void sendException(int descriptor, uint64_t serial, uint16_t mbapId, uint8_t unitId, uint8_t fid, uint8_t code);
+    void finishPending(uint8_t transactionId, const std::string &pdu);
+    static uint64_t readKey(uint8_t unitId, uint8_t fid, uint16_t regAddr, uint16_t regsAmount);
+
+    QSocketNotifier *epollNotifier;
+    QMap<int, client_t *> clients;
+    QMap<int, pending_t *> pendings;    //!< Transactions on bus by internal transaction id
+    QMap<uint64_t, int> readsInFlight;  //!< Internal transaction ids by key of read
+    QMap<uint64_t, cacheEntry_t> cache;
+    uint64_t cacheTime;
+    uint64_t lastSerial;
+    int listenDescriptor;
+    int epollDescriptor;
+};
+
+}
+
+#endif // MODBUSGATEWAY_H
@@ -1,395 +1,167 @@
 #include "modbusmaster.h"
 #include "modbusmastersub.h"
+#include "framecapture.h"
 #include <QThread>
-#include <QTimer>
-#include <iostream>
-#include <fcntl.h>
-#include <termios.h>
-#include <errno.h>
-#include <netinet/in.h>
-#include <unistd.h>
-#include <endian.h>
+#include <QSocketNotifier>
+#include <QVector>
+#include "logger.h"
+
+#define MB_PREFAULT_STACK       (64 * 1024) // Size of prefaulted stack of event thread (bytes)
 
 Q_DECLARE_METATYPE(ModBus::ModBusError)
 
 ModBus::ModBusMaster::ModBusMaster(QString device, BaudRate br, QObject *parent) :
-    QObject(parent)
+    QObject(parent), engine(this)
 {
     qRegisterMetaType<ModBus::ModBusError>();
 
-    sendQueue = new QQueue<mbTransaction_t *>();
-    sendQueue->clear();
-
     deviceName = device;
     baudRate = br;
-    exchangeState = STATE_IDLE;
-    lastTransactionId = 0;
+    threadConfig = RealTime::defaultConfig();
+    timerNotifier = 0;
+    readNotifier = 0;
+    watchNotifier = 0;
 
     eventThread = new QThread();
     eventThread->start();
     this->moveToThread(eventThread);
 
-    if (0 != (updateTimer = new QTimer()))
-    {
-        connect(updateTimer, SIGNAL(timeout()), this, SLOT(updateTimeout()));
-        updateTimer->start(10);
-    }
+    // Notifiers must be created in event thread
+    QMetaObject::invokeMethod(this, "startSlot", Qt::QueuedConnection);
 }
 
-void ModBus::ModBusMaster::startInitSlot()
+void ModBus::ModBusMaster::setCapture(FrameCapture *capture)
 {
-    exchangeState = STATE_INIT;
+    engine.setRecorder(capture);
 }
 
-void ModBus::ModBusMaster::updateTimeout()
+void ModBus::ModBusMaster::setThreadConfig(const rtThreadConfig_t &config)
 {
-    struct termios portOptions;
-    int result = 0;
-    mbTransaction_t *transaction = 0;
-    static uint8_t rxData[100];
-    uint8_t *rxCopy;
-
-    if (STATE_INIT == exchangeState)
-    {
-        exchangeState = STATE_ERROR;
-        if (-1 != (deviceDescriptor = open(deviceName.toUtf8().data(), O_RDWR | O_NOCTTY | O_NONBLOCK)))
-        {
-            if (0 == tcgetattr(deviceDescriptor, &portOptions))
-            {
-                std::cout << "[ModBus] " << deviceName.toStdString() << " options:" << std::endl;
-                std::cout << "         c_iflag 0x" << std::hex << portOptions.c_iflag << std::endl;
-                std::cout << "         c_oflag 0x" << std::hex << portOptions.c_oflag << std::endl;
-                std::cout << "         c_cflag 0x" << std::hex << portOptions.c_cflag << std::endl;
-                std::cout << "         c_lflag 0x" << std::hex << portOptions.c_lflag << std::endl;
-                std::cout << "         c_ispeed " << std::dec << portOptions.c_ispeed << std::endl;
-                std::cout << "         c_ospeed " << std::dec << portOptions.c_ospeed << std::endl;
-
+    threadConfig = config;
+    QMetaObject::invokeMethod(this, "applyThreadConfigSlot", Qt::QueuedConnection);
+}
 
-                switch(baudRate)
-                {
-                case BR_2400:
-                    result = cfsetspeed(&portOptions, B2400);
-                    break;
-                case BR_4800:
-                    result = cfsetspeed(&portOptions, B4800);
-                    break;
-                case BR_9600:
-                default:
-                    result = cfsetspeed(&portOptions, B9600);
-                    break;
-                }
-                if (0 == result)
-                {
-                    portOptions.c_cflag &= ~PARENB;
-                    portOptions.c_cflag &= ~CSTOPB;
-                    portOptions.c_cflag &= ~CSIZE;
-                    portOptions.c_cflag |= CS8 | CLOCAL | CREAD;
-                    portOptions.c_lflag |= ICANON;
+void ModBus::ModBusMaster::applyThreadConfigSlot()
+{
+    if (RealTime::applyToCurrentThread(threadConfig))
+        LOG_INFO("ModBus", "Event thread: policy %d, priority %d, cpu %d", threadConfig.policy, threadConfig.priority, threadConfig.cpu);
+    RealTime::prefaultStack(MB_PREFAULT_STACK);
+}
 
-                    if (0 <= tcsetattr(deviceDescriptor, TCSANOW, &portOptions))
-                    {
-                        std::cout << "[ModBus] Port has been configured success!" << std::endl;
-                        exchangeState = STATE_IDLE;
-                        emit portConfigured();
-                    }
-                    else
-                    {
-                        std::cout << "[Modbus] Can`t set port options!" << std::endl;
-                        emit error(MB_ERROR_SETOPTION);
-                    }
-                }
-                else
-                {
-                    std::cout << "[ModBus] Can`t set speed!" << std::endl;
-                    emit error(MB_ERROR_SETSPEED);
-                }
-            }
-            else
-            {
-                std::cout << "[ModBus] Can`t get port options!" << std::endl;
-                emit error(MB_ERROR_PORTOPTION);
-            }
-        }
-        else
-        {
-            std::cout << "[ModBus] Can`t create device descriptor!" << std::endl;
-            emit error(MB_ERROR_DESCRIPTOR);
-        }
-    }
-    else if (STATE_TRANSMIT == exchangeState)
+void ModBus::ModBusMaster::startSlot()
+{
+    if (-1 != engine.getTimerDescriptor())
     {
-        if (!sendQueue->isEmpty())
-        {
-            if (0 != (transaction = sendQueue->head()))
-            {
-                if (transaction->txSize != write(deviceDescriptor, transaction->txFrame->uint8, transaction->txSize))
-                {
-                    std::cout << "[ModBus] Write len != transactionSize!" << std::endl;
-                    sendQueue->dequeue();
-                    if (sendQueue->isEmpty())
-                        exchangeState = STATE_IDLE;
-                    emit transaction->sub->error(MB_ERROR_TRANSMIT);
-
-                    delete transaction->txFrame;
-                    delete transaction;
-                }
-                else
-                {
-                    readTryCount = 0;
-                    memset(rxData, 0, sizeof(rxData));
-                    exchangeState = STATE_RECEIVE;
-                }
-            }
-            else
-            {
-                std::cout << "[ModBus] Transaction data has been corrupted!" << std::endl;
-                sendQueue->dequeue();
-                if (sendQueue->isEmpty())
-                    exchangeState = STATE_IDLE;
-            }
-        }
-        else
-        {
-            std::cout << "[ModBus] Send queue is empty!" << std::endl;
-            exchangeState = STATE_IDLE;
-        }
+        timerNotifier = new QSocketNotifier(engine.getTimerDescriptor(), QSocketNotifier::Read, this);
+        connect(timerNotifier, SIGNAL(activated(int)), this, SLOT(processSlot()));
     }
-    else if (STATE_RECEIVE == exchangeState)
+    if (-1 != engine.getWatchDescriptor())
     {
-        if (!sendQueue->isEmpty())
-        {
-            if (0 != (transaction = sendQueue->head()))
-            {
-                if (-1 != (result = read(deviceDescriptor, &rxData[transaction->countReadBytes], sizeof(rxData))))
-                {
-                    transaction->countReadBytes += result;
-                    if (transaction->countReadBytes >= transaction->rxSize)
-                    {
-                        rxCopy = new uint8_t[transaction->rxSize];
-                        memcpy(rxCopy, rxData, transaction->rxSize);
-                        mbFrame_t *frame = reinterpret_cast<mbFrame_t *>(rxCopy);
-                        transaction->rxFrame = frame;
-                        transaction->crcCheck = checkCRC(rxData, transaction->rxSize);
-                        emit transaction->sub->transactionFinished(transaction);
-                        sendQueue->dequeue();
-
-                        if (sendQueue->isEmpty())
-                            exchangeState = STATE_IDLE;
-                        else
-                            exchangeState = STATE_TRANSMIT;
-                    }
-                    else if (false == transaction->errorChecked && transaction->countReadBytes >= sizeof(ModBus::mbException_t))
-                    {
-                        transaction->errorChecked = true;
-                        if (0 != reinterpret_cast<mbException_t *>(&rxData[0])->err)
-                        {
-                            rxCopy = reinterpret_cast<uint8_t *>(new ModBus::mbException_t);
-                            memcpy(rxCopy, rxData, sizeof(ModBus::mbException_t));
-                            mbFrame_t *frame = reinterpret_cast<mbFrame_t *>(rxCopy);
-                            transaction->rxFrame = frame;
-                            transaction->crcCheck = checkCRC(rxData, sizeof(ModBus::mbException_t));
-                            emit transaction->sub->transactionFinished(transaction);
-                            sendQueue->dequeue();
-
-                            if (sendQueue->isEmpty())
-                                exchangeState = STATE_IDLE;
-                            else
-                                exchangeState = STATE_TRANSMIT;
-                        }
-                    }
-                    else if (readTryCount++ > 10)
-                    {
-                        std::cout << "[ModBus] Read timeout!" << std::endl;
-                        sendQueue->dequeue();
-                        if (sendQueue->isEmpty())
-                            exchangeState = STATE_IDLE;
-                        else
-                            exchangeState = STATE_TRANSMIT;
-                        emit transaction->sub->error(MB_ERROR_RECEIVE_TIMEOUT);
-
-                        delete transaction->txFrame;
-                        delete transaction;
-                    }
-                }
-                else if (EAGAIN == errno)
-                {
-                    if (readTryCount++ > 10)
-                    {
-                        std::cout << "[ModBus] Read timeout!!" << std::endl;
-                        sendQueue->dequeue();
-                        if (sendQueue->isEmpty())
-                            exchangeState = STATE_IDLE;
-                        else
-                            exchangeState = STATE_TRANSMIT;
-                        emit transaction->sub->error(MB_ERROR_RECEIVE_TIMEOUT);
-
-                        delete transaction->txFrame;
-                        delete transaction;
-                    }
-                }
-                else
-                {
-                    std::cout << "[ModBus] Read error!" << std::endl;
-                    sendQueue->dequeue();
-                    if (sendQueue->isEmpty())
-                        exchangeState = STATE_IDLE;
-                    else
-                        exchangeState = STATE_TRANSMIT;
-                    emit transaction->sub->error(MB_ERROR_RECEIVE);
-
-                    delete transaction->txFrame;
-                    delete transaction;
-                }
-            }
-            else
-            {
-                std::cout << "[ModBus] Transaction data has been corrupted!" << std::endl;
-                sendQueue->dequeue();
-                if (sendQueue->isEmpty())
-                    exchangeState = STATE_IDLE;
-                else
-                    exchangeState = STATE_TRANSMIT;
-            }
-        }
-        else
-        {
-            std::cout << "[ModBus] Send queue is empty!" << std::endl;
-            exchangeState = STATE_IDLE;
-        }
+        watchNotifier = new QSocketNotifier(engine.getWatchDescriptor(), QSocketNotifier::Read, this);
+        connect(watchNotifier, SIGNAL(activated(int)), this, SLOT(processSlot()));
     }
 }
 
-int ModBus::ModBusMaster::createRequest(ModBusMasterSub *sub, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr, uint16_t value)
+void ModBus::ModBusMaster::startInitSlot()
 {
-    mbTransaction_t *transaction = 0;
+    ModBusError result = MB_ERROR_NONE;
 
-    if (sendQueue->size() < 127)
+    if (MB_ERROR_NONE != (result = engine.open(deviceName.toUtf8().data(), baudRate)))
     {
-        if (0 != (transaction = new mbTransaction_t))
-        {
-            if (0 != (transaction->txFrame = reinterpret_cast<mbFrame_t *>(new mbReadRegsReq_t)))
-            {
-                transaction->sub = sub;
-                transaction->errorChecked = false;
-                transaction->txFrame->hdr.addr = slaveId;
-                transaction->txFrame->hdr.fid = fid;
+        emit error(result);
+        return;
+    }
 
-                switch (fid)
-                {
-                case MB_READ_HOLDING_REGISTERS_FID:
-                case MB_READ_INPUT_REGISTERS_FID:
-                    fillReadRegsTransaction(transaction, valAddr, value);
-                    break;
-                case MB_FORCE_SINGLE_COIL_FID:
-                case MB_FORCE_SINGLE_REGISTER_FID:
-                    fillWriteSingleValueTransaction(transaction, valAddr, value);
-                    break;
-                case MB_READ_EXCEPTION_STATUS_FID:
-                    fillReadStatus(transaction);
-                    break;
-                default:
-                    delete transaction->txFrame;
-                    delete transaction;
-                    std::cout << "[ModBus] Unsupported function ID!" << std::endl;
-                    return -1;
-                }
+    readNotifier = new QSocketNotifier(engine.getDescriptor(), QSocketNotifier::Read, this);
+    connect(readNotifier, SIGNAL(activated(int)), this, SLOT(processSlot()));
+    emit portConfigured();
+}
 
-                transaction->transactionId = lastTransactionId;
-                lastTransactionId++;
-                sendQueue->enqueue(transaction);
+bool ModBus::ModBusMaster::submitBatch(ModBusMasterSub *sub, const mbRequest_t *requests, int amount)
+{
+    QVector<mbTransaction_t *> *batch = 0;
+    mbTransaction_t *transaction = 0;
+    int i = 0;
 
-                if (STATE_IDLE == exchangeState)
-                    exchangeState = STATE_TRANSMIT;
+    if (0 >= amount)
+        return false;
 
-                return transaction->transactionId;
-            }
-            else
-            {
-                delete transaction;
-                return -1;
-            }
+    batch = new QVector<mbTransaction_t *>();
+    batch->reserve(amount);
+    for (i = 0; i < amount; i++)
+    {
+        if (0 == (transaction = RtuEngine::buildTransaction(sub, requests[i])))
+        {
+            freeBatch(batch);
+            return false;
         }
-        else return -1;
+        batch->append(transaction);
     }
-    else return -1;
+
+    // One event wakes event thread for whole batch
+    QMetaObject::invokeMethod(this, "batchSlot", Qt::QueuedConnection, Q_ARG(void *, batch));
+    return true;
 }
 
-void ModBus::ModBusMaster::fillReadRegsTransaction(mbTransaction_t *transaction, uint16_t regAddr, uint16_t regsAmount)
+void ModBus::ModBusMaster::batchSlot(void *batch)
 {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-    transaction->txFrame->readRegsReq.regAddr = htons(regAddr);
-    transaction->txFrame->readRegsReq.regsAmount = htons(regsAmount);
-    transaction->txFrame->readRegsReq.crc = htons(crcCalc(transaction->txFrame->uint8, sizeof(mbReadRegsReq_t) - 2));
-#elif __BYTE_ORDER == __BIG_ENDIAN
-    transaction->txFrame->readRegsReq.regAddr = regAddr;
-    transaction->txFrame->readRegsReq.regsAmount = regsAmount;
-    transaction->txFrame->readRegsReq.crc = crcCalc(transaction->txFrame->uint8, sizeof(mbReadRegsReq_t) - 2);
-#else
-    #error("Unknown byte order!")
-#endif
-    transaction->txSize = sizeof(mbReadRegsReq_t);
-    transaction->rxSize = sizeof(mbReadRegsResp_t) + (sizeof(uint16_t) * regsAmount);
+    QVector<mbTransaction_t *> *transactions = static_cast<QVector<mbTransaction_t *> *>(batch);
+    ModBusMasterSub *sub = static_cast<ModBusMasterSub *>(transactions->first()->owner);
+    bool queued = (-1 != engine.enqueue(transactions->data(), transactions->size()));
+
+    if (!queued)
+        LOG_ERROR("ModBus", "Send queue has not place for batch of %d requests!", static_cast<int>(transactions->size()));
+    // Transactions are not processed by engine until return, so subscriber knows ids before results
+    sub->batchSubmitted(transactions->constData(), static_cast<int>(transactions->size()), queued);
+    if (queued)
+        delete transactions;
+    else
+        freeBatch(transactions);
 }
 
-void ModBus::ModBusMaster::fillWriteSingleValueTransaction(mbTransaction_t *transaction, uint16_t addr, uint16_t value)
+void ModBus::ModBusMaster::freeBatch(QVector<mbTransaction_t *> *batch)
 {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-    transaction->txFrame->writeRegReq.regAddr = htons(addr);
-    transaction->txFrame->writeRegReq.regVal = htons(value);
-    transaction->txFrame->writeRegReq.crc = htons(crcCalc(transaction->txFrame->uint8, sizeof(mbWriteRegReq_t) - 2));
-#elif __BYTE_ORDER == __BIG_ENDIAN
-    transaction->txFrame->writeRegReq.regAddr = addr;
-    transaction->txFrame->writeRegReq.regVal = value;
-    transaction->txFrame->writeRegReq.crc = crcCalc(transaction->txFrame->uint8, sizeof(mbWriteRegReq_t) - 2);
-#else
-    #error("Unknown byte order!")
-#endif
-    transaction->txSize = sizeof(mbWriteRegReq_t);
-    transaction->rxSize = sizeof(mbWriteRegResp_t);
+    int i = 0;
+
+    for (i = 0; i < batch->size(); i++)
+    {
+        delete batch->at(i)->txFrame;
+        delete batch->at(i);
+    }
+    delete batch;
 }
 
-void ModBus::ModBusMaster::fillReadStatus(mbTransaction_t *transaction)
+void ModBus::ModBusMaster::processSlot()
 {
-#if __BYTE_ORDER == __LITTLE_ENDIAN
-    transaction->txFrame->readExceptionReq.crc = htons(crcCalc(transaction->txFrame->uint8, sizeof(mbWriteRegReq_t) - 2));
-#elif __BYTE_ORDER == __BIG_ENDIAN
-    transaction->txFrame->readExceptionReq.crc = crcCalc(transaction->txFrame->uint8, sizeof(mbWriteRegReq_t) - 2);
-#else
-    #error("Unknown byte order!")
-#endif
-    transaction->txSize = sizeof(mbReadExceptionReq_t);
-    transaction->rxSize = sizeof(mbReadExceptionResp_t);
+    engine.process();
 }
 
-bool ModBus::ModBusMaster::checkCRC(uint8_t *buf, uint16_t len)
+void ModBus::ModBusMaster::transactionFinished(mbTransaction_t *transaction)
 {
-    uint16_t calcCRC = crcCalc(buf, len - 2);
-    uint16_t messageCRC = (buf[len - 2] << 8) | buf[len - 1];
-    return (calcCRC == messageCRC);
+    emit static_cast<ModBusMasterSub *>(transaction->owner)->transactionFinished(transaction);
 }
 
-uint16_t ModBus::ModBusMaster::crcCalc(uint8_t *buf, uint16_t len)
+void ModBus::ModBusMaster::transactionFailed(mbTransaction_t *transaction, ModBusError error)
 {
-    uint16_t crc = 0xFFFF;
-    uint16_t polynom = 0xA001;
-    uint16_t i = 0;
-    uint16_t j = 0;
+    ModBusMasterSub *sub = static_cast<ModBusMasterSub *>(transaction->owner);
 
-    for (i = 0; i < len; i++)
+    emit sub->transactionFailed(transaction->transactionId);
+    emit sub->error(error);
+}
+
+void ModBus::ModBusMaster::portStateChanged(bool available)
+{
+    if (!available)
     {
-        crc = crc ^ buf[i];
-        for (j = 0; j < 8; j++)
-        {
-            if (crc & 0x0001)
-            {
-                crc = crc >> 1;
-                crc = crc ^ polynom;
-            }
-            else
-            {
-                crc = crc >> 1;
-            }
-        }
+        // Descriptor is closed after return, notifier may be deleted only out of its signal
+        readNotifier->setEnabled(false);
+        readNotifier->deleteLater();
+        readNotifier = 0;
+        emit portLost();
+        return;
     }
-    return(crc & 0xFFFF);
+
+    readNotifier = new QSocketNotifier(engine.getDescriptor(), QSocketNotifier::Read, this);
+    connect(readNotifier, SIGNAL(activated(int)), this, SLOT(processSlot()));
+    emit portRestored();
 }
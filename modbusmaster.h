@@ -2,36 +2,31 @@
 #define MODBUSMASTER_H
 
 #include <QObject>
-#include <QQueue>
+#include <QVector>
 #include "modbus.h"
+#include "modbuscodec.h"
+#include "modbusmetrics.h"
+#include "rtuengine.h"
+#include "readplanner.h"
+#include "realtime.h"
 
 class QThread;
-class QTimer;
-struct termios;
+class QSocketNotifier;
 
 namespace ModBus
 {
 class ModBusMasterSub;
-
-typedef struct _mbTransaction_t
-{
-    mbFrame_t *txFrame;                 //!< Pointer to transmit frame
-    mbFrame_t *rxFrame;                 //!< Pointer to receive frame
-    uint8_t txSize;                     //!< Size of transmit frame
-    uint8_t rxSize;                     //!< Size of receive frame
-    uint8_t countReadBytes;             //!< Amount received bytes
-    uint8_t transactionId;              //!< Embedded transaction id
-    ModBusMasterSub *sub;               //!< Pointer to current slave device class
-    bool errorChecked;                  //!< Error has been checked: false - transaction is not checked for errors
-                                        //!<                         true - transaction is checked for errors
-    bool crcCheck;                      //!< CRC is verified: false - incorrect CRC
-                                        //!<                  true - correct CRC
-} mbTransaction_t;
+class FrameCapture;
 
 /**
  * @brief The ModBusMaster class provide master modbus device functions
+ *
+ * Class is adapter of transaction engine (see ModBus::RtuEngine) to Qt event loop: engine works
+ * in own event thread, results of transactions are emitted by signals of subscribers.
+ * Lost serial port (unplugged adapter) is reopened by engine, when device appears again, queued
+ * requests are parked until reopen or fail at once (see mbRetryPolicy_t::parkOnLoss).
  */
-class ModBusMaster : public QObject
+class ModBusMaster : public QObject, public RtuEngineListener
 {
     Q_OBJECT
 public:
@@ -47,16 +42,153 @@ public:
      * @return pointer to event thread
      */
     inline QThread *getEventThread() { return eventThread; }
+    /**
+     * @brief getMetrics get counters and latency histograms of bus
+     * @return pointer to metrics
+     */
+    inline ModBusMetrics *getMetrics() { return engine.getMetrics(); }
+    /**
+     * @brief getDeviceName get path to serial port device
+     * @return path to device
+     */
+    inline QString getDeviceName() { return deviceName; }
     /**
      * @brief createRequest create transaction to slave device
      * @param sub pointer to class, which provide subscribers functions
      * @param fid function id (see ModBus::mbFuncId_t)
      * @param slaveId slave id (1-255)
      * @param valAddr register/coil address
-     * @param value value for write
+     * @param value value for write (amount of registers for read, 1 - MB_READ_REGS_MAX)
      * @return internal transaction id
      */
-    int createRequest(ModBusMasterSub *sub, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0);
+    inline int createRequest(ModBusMasterSub *sub, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0)
+    {
+        return engine.createRequest(sub, fid, slaveId, valAddr, value);
+    }
+    /**
+     * @brief createRequest create transaction by built request (see ModBusCodec::encodeRequestFrame)
+     * @param sub pointer to class, which provide subscribers functions
+     * @param frame built request
+     * @return internal transaction id
+     */
+    inline int createRequest(ModBusMasterSub *sub, const mbRequestFrame_t &frame) { return engine.createRequest(sub, frame); }
+    /**
+     * @brief submitBatch create transactions to slave devices by one handoff to event thread (may be called from any thread)
+     *
+     * Requests are checked and their frames with CRC are built in caller thread, whole batch is passed to
+     * send queue by one queued event. Subscriber gets ids of transactions by ModBusMasterSub::batchSubmitted
+     * in event thread before any result of them.
+     * @param sub pointer to class, which provide subscribers functions
+     * @param requests array of requests (see ModBus::mbRequest_t)
+     * @param amount amount of requests
+     * @return false if any request is incorrect (batch is not submitted)
+     */
+    bool submitBatch(ModBusMasterSub *sub, const mbRequest_t *requests, int amount);
+    /**
+     * @brief planReads cover needed registers by read requests with minimal airtime on bus (see ModBus::ReadPlanner)
+     *
+     * Plan uses baud rate of bus and measured overhead of transaction, so gaps, which are merged into reads,
+     * follow real turnaround of slaves. Method may be called from any thread.
+     * @param needs array of needed registers
+     * @param amount amount of needed registers
+     * @param reads array for read requests
+     * @param maxReads size of array of read requests
+     * @param maxGap max amount of unneeded registers between needed registers of one read
+     * @return amount of read requests, -1 on error
+     */
+    inline int planReads(const mbRegisterNeed_t *needs, int amount, mbPlannedRead_t *reads, int maxReads, uint16_t maxGap = MB_READ_REGS_MAX)
+    {
+        ReadPlanner planner(frameTiming(baudRate), engine.getTransactionOverhead());
+
+        planner.setMaxGap(maxGap);
+        return planner.plan(needs, amount, reads, maxReads);
+    }
+    /**
+     * @brief readTime get time of bus, which is taken by read transaction (may be called from any thread)
+     * @param regsAmount amount of registers
+     * @return time (ns) with measured overhead of transaction
+     */
+    inline uint64_t readTime(uint16_t regsAmount)
+    {
+        return ReadPlanner(frameTiming(baudRate), engine.getTransactionOverhead()).readTime(regsAmount);
+    }
+    /**
+     * @brief getTransactionOverhead get measured overhead of transaction (see RtuEngine::getTransactionOverhead)
+     * @return overhead (ns)
+     */
+    inline uint64_t getTransactionOverhead() { return engine.getTransactionOverhead(); }
+    /**
+     * @brief setInitialOverhead set overhead of transaction, which is assumed until measurement (must be called before port init)
+     * @param overhead overhead (ns, for ex. measured by previous run), 0 - default
+     */
+    inline void setInitialOverhead(uint64_t overhead) { engine.setInitialOverhead(overhead); }
+    /**
+     * @brief setCapture set capture of transmitted and received frames (must be called before port init)
+     * @param capture pointer to frame capture (0 for disable capture)
+     */
+    void setCapture(FrameCapture *capture);
+    /**
+     * @brief setRetryPolicy set retry policy of transactions and circuit breaker of slaves (must be called before port init)
+     *
+     * Transaction failed by timeout or incorrect CRC is moved to the tail of send queue and transmitted again
+     * after backoff delay, so requests to other slaves are not blocked. When circuit breaker of slave is open,
+     * requests to slave fail without transmit (MB_ERROR_SLAVE_UNAVAILABLE), except one probe request per probe interval.
+     * While serial port is lost, requests wait for its reopen or fail with MB_ERROR_PORT_LOST.
+     * @param policy retry policy (see ModBus::mbRetryPolicy_t)
+     */
+    inline void setRetryPolicy(const mbRetryPolicy_t &policy) { engine.setRetryPolicy(policy); }
+    /**
+     * @brief getRetryPolicy get retry policy of transactions and circuit breaker of slaves
+     * @return retry policy (by default without retries and circuit breaker)
+     */
+    inline mbRetryPolicy_t getRetryPolicy() { return engine.getRetryPolicy(); }
+    /**
+     * @brief setAdapterLatency set max delay of received bytes in serial adapter (must be called before port init)
+     *
+     * Incomplete response is ended by silence of t1.5 after last byte plus adapter latency.
+     * USB adapters deliver bytes by chunks (FTDI by default every 16 ms), native UART needs 0.
+     * @param latency latency (ms, default 20)
+     */
+    inline void setAdapterLatency(uint16_t latency) { engine.setAdapterLatency(latency); }
+    /**
+     * @brief frameTiming get timing of RTU frames for baud rate
+     * @param br baud rate (see ModBus::BaudRate)
+     * @return timing of frames
+     */
+    static inline const mbFrameTiming_t &frameTiming(BaudRate br) { return RtuEngine::frameTiming(br); }
+    /**
+     * @brief setThreadConfig set scheduling policy and CPU of event thread (applied asynchronously in event thread)
+     *
+     * Stack of event thread is prefaulted, so with locked memory (see RealTime::lockMemory) bus I/O does not
+     * take page faults. Delay of timer wakeups is counted in metrics (wakeupLatency).
+     * @param config options of thread
+     */
+    void setThreadConfig(const rtThreadConfig_t &config);
+    /**
+     * @brief crcCalc calculate CRC of message (see ModBusCodec::crcCalc)
+     * @param buf pointer to message
+     * @param len length of message
+     * @return CRC value
+     */
+    static inline uint16_t crcCalc(uint8_t *buf, uint16_t len) { return ModBusCodec::crcCalc(buf, len); }
+    /**
+     * @brief checkCRC check CRC of message (see ModBusCodec::checkCRC)
+     * @param buf pointer to message
+     * @param len length of message with CRC
+     * @return true if CRC is correct
+     */
+    static inline bool checkCRC(uint8_t *buf, uint16_t len) { return ModBusCodec::checkCRC(buf, len); }
+    /**
+     * @brief responseLength get length of complete response in received data (see ModBusCodec::responseLength)
+     * @param rxData pointer to received data
+     * @param count amount of received bytes
+     * @param rxSize expected size of normal response
+     * @return length of response (normal or exception), 0 if response is not complete
+     */
+    static inline uint16_t responseLength(const uint8_t *rxData, uint16_t count, uint16_t rxSize)
+    {
+        return ModBusCodec::responseLength(rxData, count, rxSize);
+    }
 
 signals:
     /**
@@ -68,6 +200,14 @@ signals:
      * @brief portConfigured emitted when serial port has been configured
      */
     void portConfigured();
+    /**
+     * @brief portLost emitted when serial port has been lost (adapter is unplugged)
+     */
+    void portLost();
+    /**
+     * @brief portRestored emitted when lost serial port has been reopened and configured
+     */
+    void portRestored();
 
 public slots:
     /**
@@ -76,34 +216,26 @@ public slots:
     void startInitSlot();
 
 private slots:
-    void updateTimeout();
+    void startSlot();
+    void processSlot();
+    void applyThreadConfigSlot();
+    void batchSlot(void *batch);
 
 private:
-    uint16_t crcCalc(uint8_t *buf, uint16_t len);
-    bool checkCRC(uint8_t *buf, uint16_t len);
-    void fillReadRegsTransaction(mbTransaction_t *transaction, uint16_t regAddr, uint16_t regsAmount);
-    void fillWriteSingleValueTransaction(mbTransaction_t *transaction, uint16_t addr, uint16_t value);
-    void fillReadStatus(mbTransaction_t *transaction);
-
-    enum ExchangeState
-    {
-        STATE_INIT = 0,
-        STATE_TRANSMIT,
-        STATE_RECEIVE,
-        STATE_IDLE,
-        STATE_ERROR
-    };
+    void transactionFinished(mbTransaction_t *transaction);
+    void transactionFailed(mbTransaction_t *transaction, ModBusError error);
+    void portStateChanged(bool available);
+    void freeBatch(QVector<mbTransaction_t *> *batch);
 
     QThread *eventThread;
-    QTimer *updateTimer;
-    QQueue<mbTransaction_t *> *sendQueue;
+    QSocketNotifier *timerNotifier;
+    QSocketNotifier *readNotifier;
+    QSocketNotifier *watchNotifier;
+    RtuEngine engine;
+    rtThreadConfig_t threadConfig;
 
     BaudRate baudRate;
     QString deviceName;
-    ExchangeState exchangeState;
-    int deviceDescriptor;
-    uint8_t readTryCount;
-    uint8_t lastTransactionId;
 };
 
 }
@@ -13,6 +13,7 @@ namespace ModBus
 class ModBusMasterSub : public QObject
 {
     Q_OBJECT
+    friend class ModBusMaster;
 public:
     /**
      * @brief ModBusMasterSub class constructor
@@ -37,6 +38,11 @@ signals:
      * @param transaction pointer to transaction structure
      */
     void transactionFinished(ModBus::mbTransaction_t *transaction);
+    /**
+     * @brief transactionFailed emitted when transaction has been dropped on transmit/receive error or timeout
+     * @param transactionId internal transaction id (see ModBusMaster::createRequest)
+     */
+    void transactionFailed(uint8_t transactionId);
 
 protected:
     /**
@@ -48,6 +54,26 @@ protected:
      * @return internal transaction id
      */
     int createRequest(mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0);
+    /**
+     * @brief createRequest create transaction by built request (see ModBusCodec::encodeRequestFrame)
+     * @param frame built request
+     * @return internal transaction id
+     */
+    int createRequest(const mbRequestFrame_t &frame);
+    /**
+     * @brief submitBatch create transactions by one handoff to event thread (see ModBusMaster::submitBatch)
+     * @param requests array of requests (see ModBus::mbRequest_t)
+     * @param amount amount of requests
+     * @return false if any request is incorrect
+     */
+    bool submitBatch(const mbRequest_t *requests, int amount);
+    /**
+     * @brief batchSubmitted called in event thread, when batch has been passed to send queue (before any result of it)
+     * @param transactions array of transactions (ids are assigned, tag is value of request)
+     * @param amount amount of transactions
+     * @param queued false if send queue has not place for batch (transactions are freed after return)
+     */
+    virtual void batchSubmitted(mbTransaction_t *const *transactions, int amount, bool queued);
     /**
      * @brief checkError check responce on errors/exception
      * @param transaction pointer to transaction structure
@@ -59,6 +85,11 @@ protected:
      * @param transaction pointer to transaction structure
      */
     void swapByteOrder(ModBus::mbTransaction_t *transaction);
+    /**
+     * @brief getMaster get pointer to master class
+     * @return pointer to master class
+     */
+    inline ModBusMaster *getMaster() { return modbusMaster; }
 
 private:
     ModBusMaster *modbusMaster;
@@ -0,0 +1,183 @@
+#include "modbusmetrics.h"
+#include <stdio.h>
+#include <string.h>
+
+#define HISTOGRAM_MIN_BOUND_EXP     4       // Minimal bucket bound of exported histograms (2^4 us)
+#define HISTOGRAM_MAX_BOUND_EXP     26      // Maximal bucket bound of exported histograms (2^26 us)
+
+ModBus::LatencyHistogram::LatencyHistogram()
+{
+    memset(const_cast<uint64_t *>(counts), 0, sizeof(counts));
+    sumUs = 0;
+}
+
+uint64_t ModBus::LatencyHistogram::countAtMost(uint64_t boundUs) const
+{
+    uint64_t result = 0;
+    int last = 0;
+    int exponent = 63 - __builtin_clzll(boundUs);
+    int i = 0;
+
+    // Bucket of bound starts with values just above bound (see record)
+    if (boundUs <= SUB_BUCKETS)
+        last = static_cast<int>(boundUs);
+    else
+        last = (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    if (last > BUCKETS_AMOUNT)
+        last = BUCKETS_AMOUNT;
+
+    for (i = 0; i < last; i++)
+        result += counts[i];
+    return result;
+}
+
+uint64_t ModBus::LatencyHistogram::totalCount() const
+{
+    uint64_t result = 0;
+    int i = 0;
+
+    for (i = 0; i < BUCKETS_AMOUNT; i++)
+        result += counts[i];
+    return result;
+}
+
+ModBus::ModBusMetrics::ModBusMetrics()
+{
+    transactions = 0;
+    timeouts = 0;
+    crcErrors = 0;
+    transmitErrors = 0;
+    receiveErrors = 0;
+    retries = 0;
+    rejected = 0;
+    portLosses = 0;
+    memset(const_cast<uint64_t *>(exceptions), 0, sizeof(exceptions));
+    memset(const_cast<uint64_t *>(stationErrors), 0, sizeof(stationErrors));
+    readings = 0;
+    txBytes = 0;
+    rxBytes = 0;
+    queueDepth = 0;
+    wakeupLatencyMax = 0;
+    transactionOverhead = 0;
+}
+
+static void appendHeader(std::string *out, const char *name, const char *type, const char *help)
+{
+    out->append("# HELP ").append(name).append(" ").append(help).append("\n");
+    out->append("# TYPE ").append(name).append(" ").append(type).append("\n");
+}
+
+static void appendValue(std::string *out, const char *name, const std::string &bus, uint64_t value, const char *extraLabel = 0)
+{
+    char line[64];
+
+    out->append(name).append("{bus=\"").append(bus).append("\"");
+    if (0 != extraLabel)
+        out->append(",").append(extraLabel);
+    snprintf(line, sizeof(line), "} %llu\n", static_cast<unsigned long long>(value));
+    out->append(line);
+}
+
+static void appendHistogram(std::string *out, const char *name, const std::string &bus, const ModBus::LatencyHistogram &histogram)
+{
+    char line[128];
+    int exponent = 0;
+
+    for (exponent = HISTOGRAM_MIN_BOUND_EXP; exponent <= HISTOGRAM_MAX_BOUND_EXP; exponent++)
+    {
+        snprintf(line, sizeof(line), "_bucket{bus=\"%s\",le=\"%.9g\"} %llu\n", bus.c_str(), static_cast<double>(1ULL << exponent) / 1e6,
+                 static_cast<unsigned long long>(histogram.countAtMost(1ULL << exponent)));
+        out->append(name).append(line);
+    }
+    snprintf(line, sizeof(line), "_bucket{bus=\"%s\",le=\"+Inf\"} %llu\n", bus.c_str(), static_cast<unsigned long long>(histogram.totalCount()));
+    out->append(name).append(line);
+    snprintf(line, sizeof(line), "_sum{bus=\"%s\"} %.6f\n", bus.c_str(), static_cast<double>(histogram.totalSum()) / 1e6);
+    out->append(name).append(line);
+    snprintf(line, sizeof(line), "_count{bus=\"%s\"} %llu\n", bus.c_str(), static_cast<unsigned long long>(histogram.totalCount()));
+    out->append(name).append(line);
+}
+
+void ModBus::ModBusMetrics::format(const ModBusMetrics * const *metrics, const std::string *buses, int amount, std::string *out)
+{
+    char label[32];
+    int i = 0;
+    int code = 0;
+
+    appendHeader(out, "modbus_transactions_total", "counter", "Completed transactions");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_transactions_total", buses[i], metrics[i]->transactions);
+    appendHeader(out, "modbus_timeouts_total", "counter", "Receive timeouts");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_timeouts_total", buses[i], metrics[i]->timeouts);
+    appendHeader(out, "modbus_crc_errors_total", "counter", "Responses with incorrect CRC");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_crc_errors_total", buses[i], metrics[i]->crcErrors);
+    appendHeader(out, "modbus_transmit_errors_total", "counter", "Transmit errors");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_transmit_errors_total", buses[i], metrics[i]->transmitErrors);
+    appendHeader(out, "modbus_receive_errors_total", "counter", "Receive errors");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_receive_errors_total", buses[i], metrics[i]->receiveErrors);
+    appendHeader(out, "modbus_retries_total", "counter", "Retransmits after timeout or incorrect CRC");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_retries_total", buses[i], metrics[i]->retries);
+    appendHeader(out, "modbus_rejected_total", "counter", "Requests failed by open circuit breaker");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_rejected_total", buses[i], metrics[i]->rejected);
+    appendHeader(out, "modbus_port_losses_total", "counter", "Losses of serial port (unplugged adapter)");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_port_losses_total", buses[i], metrics[i]->portLosses);
+    appendHeader(out, "modbus_exceptions_total", "counter", "Exception responses by exception code");
+    for (i = 0; i < amount; i++)
+    {
+        for (code = 0; code < EXCEPTION_CODES; code++)
+        {
+            if (0 == metrics[i]->exceptions[code])
+                continue;
+            snprintf(label, sizeof(label), "code=\"%d\"", code);
+            appendValue(out, "modbus_exceptions_total", buses[i], metrics[i]->exceptions[code], label);
+        }
+    }
+    appendHeader(out, "modbus_station_errors_total", "counter", "Station errors by error code");
+    for (i = 0; i < amount; i++)
+    {
+        for (code = 0; code < STATION_ERROR_CODES; code++)
+        {
+            if (0 == metrics[i]->stationErrors[code])
+                continue;
+            snprintf(label, sizeof(label), "code=\"%d\"", code);
+            appendValue(out, "modbus_station_errors_total", buses[i], metrics[i]->stationErrors[code], label);
+        }
+    }
+    appendHeader(out, "modbus_readings_total", "counter", "Decoded readings");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_readings_total", buses[i], metrics[i]->readings);
+    appendHeader(out, "modbus_tx_bytes_total", "counter", "Transmitted bytes");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_tx_bytes_total", buses[i], metrics[i]->txBytes);
+    appendHeader(out, "modbus_rx_bytes_total", "counter", "Received bytes");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_rx_bytes_total", buses[i], metrics[i]->rxBytes);
+    appendHeader(out, "modbus_queue_depth", "gauge", "Length of send queue");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_queue_depth", buses[i], metrics[i]->queueDepth);
+    appendHeader(out, "modbus_wakeup_latency_max_nanoseconds", "gauge", "Max delay of timer wakeup of bus thread");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_wakeup_latency_max_nanoseconds", buses[i], metrics[i]->wakeupLatencyMax);
+    appendHeader(out, "modbus_transaction_overhead_nanoseconds", "gauge", "Measured time of transaction, which does not depend on size of frames");
+    for (i = 0; i < amount; i++)
+        appendValue(out, "modbus_transaction_overhead_nanoseconds", buses[i], metrics[i]->transactionOverhead);
+
+    appendHeader(out, "modbus_enqueue_to_transmit_seconds", "histogram", "Time from creation of request to transmit");
+    for (i = 0; i < amount; i++)
+        appendHistogram(out, "modbus_enqueue_to_transmit_seconds", buses[i], metrics[i]->enqueueToTransmit);
+    appendHeader(out, "modbus_transmit_to_first_byte_seconds", "histogram", "Time from transmit to first received byte");
+    for (i = 0; i < amount; i++)
+        appendHistogram(out, "modbus_transmit_to_first_byte_seconds", buses[i], metrics[i]->transmitToFirstByte);
+    appendHeader(out, "modbus_transmit_to_complete_seconds", "histogram", "Time from transmit to complete response");
+    for (i = 0; i < amount; i++)
+        appendHistogram(out, "modbus_transmit_to_complete_seconds", buses[i], metrics[i]->transmitToComplete);
+    appendHeader(out, "modbus_wakeup_latency_seconds", "histogram", "Delay of timer wakeup of bus thread");
+    for (i = 0; i < amount; i++)
+        appendHistogram(out, "modbus_wakeup_latency_seconds", buses[i], metrics[i]->wakeupLatency);
+}
@@ -0,0 +1,158 @@
+#ifndef MODBUSMETRICS_H
+#define MODBUSMETRICS_H
+
+#include <stdint.h>
+#include <string>
+#include <time.h>
+
+namespace ModBus
+{
+
+/**
+ * @brief monotonicTime get time of monotonic clock
+ * @return time (ns)
+ */
+static inline uint64_t monotonicTime()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + now.tv_nsec;
+}
+
+/**
+ * @brief The LatencyHistogram class provide lock-free log-linear histogram of latencies
+ *
+ * Values are kept in microseconds with 8 sub-buckets per power of two (relative error below 12.5%).
+ * Buckets include their upper bound (as "le" buckets of Prometheus), so value is put by value - 1.
+ * Recording is one atomic increment of bucket and of sum, so it can be called from I/O thread.
+ */
+class LatencyHistogram
+{
+public:
+    enum
+    {
+        SUB_BUCKET_BITS = 3,
+        SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+        BUCKETS_AMOUNT = (32 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+    };
+
+    LatencyHistogram();
+    /**
+     * @brief record add latency to histogram
+     * @param ns latency (ns)
+     */
+    inline void record(uint64_t ns)
+    {
+        uint64_t us = ns / 1000;
+        __sync_fetch_and_add(&counts[bucketIndex((0 != us) ? us - 1 : 0)], 1);
+        __sync_fetch_and_add(&sumUs, us);
+    }
+    /**
+     * @brief countAtMost get amount of values less than or equal to bound
+     * @param boundUs bound (us), must be power of two
+     * @return amount of values
+     */
+    uint64_t countAtMost(uint64_t boundUs) const;
+    /**
+     * @brief totalCount get amount of all values
+     * @return amount of values
+     */
+    uint64_t totalCount() const;
+    /**
+     * @brief totalSum get sum of all values
+     * @return sum of values (us)
+     */
+    inline uint64_t totalSum() const { return sumUs; }
+
+private:
+    static inline int bucketIndex(uint64_t us)
+    {
+        int exponent;
+
+        if (us < SUB_BUCKETS)
+            return static_cast<int>(us);
+        if (us > 0xFFFFFFFFULL)
+            us = 0xFFFFFFFFULL;
+        exponent = 63 - __builtin_clzll(us);
+        return (exponent - SUB_BUCKET_BITS + 1) * SUB_BUCKETS + static_cast<int>((us >> (exponent - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    }
+
+    volatile uint64_t counts[BUCKETS_AMOUNT];
+    volatile uint64_t sumUs;
+};
+
+/**
+ * @brief The ModBusMetrics class provide lock-free counters and latency histograms of modbus bus
+ */
+class ModBusMetrics
+{
+public:
+    enum
+    {
+        EXCEPTION_CODES = 16,
+        STATION_ERROR_CODES = 32
+    };
+
+    ModBusMetrics();
+    /**
+     * @brief add add value to counter
+     * @param counter pointer to counter
+     * @param value value for add
+     */
+    static inline void add(volatile uint64_t *counter, uint64_t value = 1) { __sync_fetch_and_add(counter, value); }
+    /**
+     * @brief recordException count exception of slave
+     * @param code exception code
+     */
+    inline void recordException(uint8_t code) { add(&exceptions[code < EXCEPTION_CODES ? code : 0]); }
+    /**
+     * @brief recordStationError count error of station (see weatherStationErrors_t)
+     * @param code error code
+     */
+    inline void recordStationError(int code) { add(&stationErrors[(0 <= code && code < STATION_ERROR_CODES) ? code : 0]); }
+    /**
+     * @brief recordWakeup count delay of timer wakeup of bus thread
+     * @param ns delay (ns)
+     */
+    inline void recordWakeup(uint64_t ns)
+    {
+        uint64_t max = wakeupLatencyMax;
+
+        wakeupLatency.record(ns);
+        while (ns > max && !__sync_bool_compare_and_swap(&wakeupLatencyMax, max, ns))
+            max = wakeupLatencyMax;
+    }
+    /**
+     * @brief format get metrics of buses in Prometheus text format
+     * @param metrics array of pointers to metrics of buses
+     * @param buses array of labels of buses (for ex. serial port device)
+     * @param amount amount of buses
+     * @param out pointer to output text
+     */
+    static void format(const ModBusMetrics * const *metrics, const std::string *buses, int amount, std::string *out);
+
+    LatencyHistogram enqueueToTransmit;         //!< Time from creation of request to transmit
+    LatencyHistogram transmitToFirstByte;       //!< Time from transmit to first received byte
+    LatencyHistogram transmitToComplete;        //!< Time from transmit to complete response
+    LatencyHistogram wakeupLatency;             //!< Delay of timer wakeup of bus thread (scheduling jitter)
+    volatile uint64_t transactions;             //!< Amount of completed transactions
+    volatile uint64_t timeouts;                 //!< Amount of receive timeouts
+    volatile uint64_t crcErrors;                //!< Amount of responses with incorrect CRC
+    volatile uint64_t transmitErrors;           //!< Amount of transmit errors
+    volatile uint64_t receiveErrors;            //!< Amount of receive errors
+    volatile uint64_t retries;                  //!< Amount of repeated transmits after timeout or incorrect CRC
+    volatile uint64_t rejected;                 //!< Amount of requests failed without transmit (circuit breaker of slave is open)
+    volatile uint64_t portLosses;               //!< Amount of losses of serial port (hangup of unplugged adapter)
+    volatile uint64_t exceptions[EXCEPTION_CODES];  //!< Amount of exceptions by exception code
+    volatile uint64_t stationErrors[STATION_ERROR_CODES];   //!< Amount of station errors by code
+    volatile uint64_t readings;                 //!< Amount of decoded readings
+    volatile uint64_t txBytes;                  //!< Amount of transmitted bytes
+    volatile uint64_t rxBytes;                  //!< Amount of received bytes
+    volatile uint32_t queueDepth;               //!< Current length of send queue
+    volatile uint64_t wakeupLatencyMax;         //!< Max delay of timer wakeup of bus thread (ns)
+    volatile uint64_t transactionOverhead;      //!< Measured time of transaction, which does not depend on size of frames (ns)
+};
+
+}
+
+#endif // MODBUSMETRICS_H
@@ -0,0 +1,215 @@
+#include "readingexporter.h"
+#include "logger.h"
+#include <QTimer>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+ReadingExporter::ReadingExporter(ExportFormat format, int batchSize, int flushInterval, QObject *parent) :
+    QObject(parent)
+{
+    exportFormat = format;
+    this->batchSize = (0 < batchSize) ? batchSize : 1;
+    recordsAmount = 0;
+    descriptor = -1;
+    ownDescriptor = false;
+
+    buffer = new char[BUFFER_SIZE];
+    bufferPos = buffer;
+
+    // Closed pipe or socket reader must not terminate program
+    signal(SIGPIPE, SIG_IGN);
+
+    if (0 != (flushTimer = new QTimer(this)))
+    {
+        connect(flushTimer, SIGNAL(timeout()), this, SLOT(flushSlot()));
+        flushTimer->start(flushInterval);
+    }
+}
+
+ReadingExporter::~ReadingExporter()
+{
+    flushSlot();
+    if (ownDescriptor && -1 != descriptor)
+        close(descriptor);
+    delete[] buffer;
+}
+
+bool ReadingExporter::parseFormat(const char *name, ExportFormat *format)
+{
+    if (0 == strcmp(name, "csv"))
+        *format = FORMAT_CSV;
+    else if (0 == strcmp(name, "jsonl"))
+        *format = FORMAT_JSON_LINES;
+    else if (0 == strcmp(name, "influx"))
+        *format = FORMAT_INFLUX;
+    else
+        return false;
+    return true;
+}
+
+bool ReadingExporter::open(QString destination)
+{
+    struct sockaddr_un address;
+    QByteArray path;
+
+    if (destination == "-")
+    {
+        descriptor = STDOUT_FILENO;
+        ownDescriptor = false;
+        return true;
+    }
+
+    if (destination.startsWith("unix:"))
+    {
+        path = destination.mid(5).toUtf8();
+        if (path.size() >= static_cast<int>(sizeof(address.sun_path)))
+        {
+            LOG_ERROR("ReadingExporter", "Socket path %s is too long!", path.data());
+            return false;
+        }
+        memset(&address, 0, sizeof(address));
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.data(), sizeof(address.sun_path) - 1);
+
+        if (-1 == (descriptor = socket(AF_UNIX, SOCK_STREAM, 0)))
+        {
+            LOG_ERROR("ReadingExporter", "Can`t create socket!");
+            return false;
+        }
+        if (0 != ::connect(descriptor, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)))
+        {
+            LOG_ERROR("ReadingExporter", "Can`t connect to socket %s!", path.data());
+            close(descriptor);
+            descriptor = -1;
+            return false;
+        }
+    }
+    else if (-1 == (descriptor = ::open(destination.toUtf8().data(), O_WRONLY | O_CREAT | O_APPEND, 0644)))
+    {
+        LOG_ERROR("ReadingExporter", "Can`t open export file %s!", destination.toUtf8().data());
+        return false;
+    }
+
+    ownDescriptor = true;
+    if (FORMAT_CSV == exportFormat && 0 == lseek(descriptor, 0, SEEK_END))
+        bufferPos = appendString(bufferPos, "timestamp,station,measurement,value\n");
+    return true;
+}
+
+void ReadingExporter::readingSlot(weatherReading_t reading)
+{
+    const char *name = WeatherStation::measurementName(reading.type);
+    char *pos = bufferPos;
+
+    if (WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type)
+        return;
+
+    switch (exportFormat)
+    {
+    case FORMAT_CSV:
+        pos = appendUInt(pos, reading.timestamp);
+        *pos++ = ',';
+        pos = appendUInt(pos, reading.slaveId);
+        *pos++ = ',';
+        pos = appendString(pos, name);
+        *pos++ = ',';
+        pos = appendFixed(pos, reading.value);
+        break;
+    case FORMAT_JSON_LINES:
+        pos = appendString(pos, "{\"timestamp\":");
+        pos = appendUInt(pos, reading.timestamp);
+        pos = appendString(pos, ",\"station\":");
+        pos = appendUInt(pos, reading.slaveId);
+        pos = appendString(pos, ",\"measurement\":\"");
+        pos = appendString(pos, name);
+        pos = appendString(pos, "\",\"value\":");
+        pos = appendFixed(pos, reading.value);
+        *pos++ = '}';
+        break;
+    case FORMAT_INFLUX:
+        pos = appendString(pos, "weather,station=");
+        pos = appendUInt(pos, reading.slaveId);
+        *pos++ = ' ';
+        pos = appendString(pos, name);
+        *pos++ = '=';
+        pos = appendFixed(pos, reading.value);
+        *pos++ = ' ';
+        pos = appendUInt(pos, reading.timestamp);
+        pos = appendString(pos, "000000");
+        break;
+    }
+    *pos++ = '\n';
+    bufferPos = pos;
+
+    if (++recordsAmount >= batchSize || BUFFER_SIZE - (bufferPos - buffer) < RECORD_MAX_SIZE)
+        flushSlot();
+}
+
+void ReadingExporter::flushSlot()
+{
+    const char *pos = buffer;
+    ssize_t result = 0;
+
+    if (-1 != descriptor)
+    {
+        while (pos < bufferPos)
+        {
+            if (-1 == (result = write(descriptor, pos, bufferPos - pos)))
+            {
+                if (EINTR == errno)
+                    continue;
+                LOG_WARNING("ReadingExporter", "Write error, records have been dropped!");
+                break;
+            }
+            pos += result;
+        }
+    }
+    bufferPos = buffer;
+    recordsAmount = 0;
+}
+
+char *ReadingExporter::appendString(char *pos, const char *text)
+{
+    while (0 != *text)
+        *pos++ = *text++;
+    return pos;
+}
+
+char *ReadingExporter::appendUInt(char *pos, uint64_t value)
+{
+    char digits[20];
+    int count = 0;
+
+    do
+    {
+        digits[count++] = '0' + static_cast<char>(value % 10);
+        value /= 10;
+    } while (0 != value);
+
+    while (0 < count)
+        *pos++ = digits[--count];
+    return pos;
+}
+
+char *ReadingExporter::appendFixed(char *pos, double value)
+{
+    uint64_t scaled;
+
+    // All readings have resolution not better than 0.01
+    if (0.0 > value)
+    {
+        *pos++ = '-';
+        value = -value;
+    }
+    scaled = static_cast<uint64_t>(value * 100.0 + 0.5);
+    pos = appendUInt(pos, scaled / 100);
+    *pos++ = '.';
+    *pos++ = '0' + static_cast<char>((scaled / 10) % 10);
+    *pos++ = '0' + static_cast<char>(scaled % 10);
+    return pos;
+}
@@ -0,0 +1,82 @@
+#ifndef READINGEXPORTER_H
+#define READINGEXPORTER_H
+
+#include <QObject>
+#include <QString>
+#include "weatherstation.h"
+
+class QTimer;
+
+/**
+ * @brief The ReadingExporter class provide streaming export of weather station readings
+ *
+ * Readings are formatted without iostreams into preallocated buffer, which is written by one
+ * write call per batch of records or per flush interval.
+ */
+class ReadingExporter : public QObject
+{
+    Q_OBJECT
+public:
+    enum ExportFormat
+    {
+        FORMAT_CSV = 0,                 //!< Comma separated values (timestamp,station,measurement,value)
+        FORMAT_JSON_LINES,              //!< One JSON object per line
+        FORMAT_INFLUX                   //!< InfluxDB line protocol
+    };
+
+    /**
+     * @brief ReadingExporter class constructor
+     * @param format format of records (see ReadingExporter::ExportFormat)
+     * @param batchSize amount of records in one write
+     * @param flushInterval max time of keeping records in buffer (ms)
+     * @param parent parent class
+     */
+    explicit ReadingExporter(ExportFormat format, int batchSize = 64, int flushInterval = 1000, QObject *parent = 0);
+    ~ReadingExporter();
+    /**
+     * @brief open open destination of export
+     * @param destination "-" for stdout, "unix:<path>" for unix socket, else path to file or pipe
+     * @return true if destination has been opened
+     */
+    bool open(QString destination);
+    /**
+     * @brief parseFormat get format by name
+     * @param name name of format ("csv", "jsonl" or "influx")
+     * @param format pointer to result format
+     * @return true if name is correct
+     */
+    static bool parseFormat(const char *name, ExportFormat *format);
+
+public slots:
+    /**
+     * @brief readingSlot add reading to export buffer
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+    /**
+     * @brief flushSlot write buffered records to destination
+     */
+    void flushSlot();
+
+private:
+    char *appendString(char *pos, const char *text);
+    char *appendUInt(char *pos, uint64_t value);
+    char *appendFixed(char *pos, double value);
+
+    enum
+    {
+        BUFFER_SIZE = 65536,
+        RECORD_MAX_SIZE = 160
+    };
+
+    QTimer *flushTimer;
+    ExportFormat exportFormat;
+    char *buffer;
+    char *bufferPos;
+    int batchSize;
+    int recordsAmount;
+    int descriptor;
+    bool ownDescriptor;
+};
+
+#endif // READINGEXPORTER_H
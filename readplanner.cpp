@@ -0,0 +1,112 @@
+#include "readplanner.h"
+#include <algorithm>
+#include <vector>
+
+/**
+ * @brief needLess order of needs by slave id, function id and address
+ * @param first first need
+ * @param second second need
+ * @return true if first need is before second
+ */
+static bool needLess(const ModBus::mbRegisterNeed_t &first, const ModBus::mbRegisterNeed_t &second)
+{
+    if (first.slaveId != second.slaveId)
+        return first.slaveId < second.slaveId;
+    if (first.fid != second.fid)
+        return first.fid < second.fid;
+    return first.regAddr < second.regAddr;
+}
+
+ModBus::ReadPlanner::ReadPlanner(const mbFrameTiming_t &timing, uint64_t overhead)
+{
+    this->timing = timing;
+    this->overhead = overhead;
+    maxGap = MB_READ_REGS_MAX;
+}
+
+uint64_t ModBus::ReadPlanner::readTime(uint16_t regsAmount) const
+{
+    // Request and response of read are on line one after another
+    return overhead + static_cast<uint64_t>(timing.charTime) *
+            (sizeof(mbReadRegsReq_t) + sizeof(mbReadRegsResp_t) + sizeof(uint16_t) * (regsAmount - 1));
+}
+
+int ModBus::ReadPlanner::plan(const mbRegisterNeed_t *needs, int amount, mbPlannedRead_t *reads, int maxReads) const
+{
+    std::vector<mbRegisterNeed_t> sorted(needs, needs + amount);
+    size_t first = 0;
+    size_t last = 0;
+    int readsAmount = 0;
+    int result = 0;
+
+    for (first = 0; first < sorted.size(); first++)
+    {
+        if (MB_READ_HOLDING_REGISTERS_FID != sorted[first].fid && MB_READ_INPUT_REGISTERS_FID != sorted[first].fid)
+            return -1;
+    }
+    std::sort(sorted.begin(), sorted.end(), needLess);
+
+    // Registers of every slave and function are planned separately
+    for (first = 0; first < sorted.size(); first = last)
+    {
+        for (last = first + 1; last < sorted.size() && sorted[last].slaveId == sorted[first].slaveId &&
+             sorted[last].fid == sorted[first].fid; last++)
+            ;
+        if (-1 == (result = planSlave(&sorted[first], last - first, &reads[readsAmount], maxReads - readsAmount)))
+            return -1;
+        readsAmount += result;
+    }
+    return readsAmount;
+}
+
+int ModBus::ReadPlanner::planSlave(const mbRegisterNeed_t *needs, int amount, mbPlannedRead_t *reads, int maxReads) const
+{
+    std::vector<uint16_t> regs;
+    std::vector<uint64_t> cost;
+    std::vector<int> split;
+    uint64_t time = 0;
+    int readsAmount = 0;
+    int i = 0;
+    int j = 0;
+
+    for (i = 0; i < amount; i++)
+    {
+        if (regs.empty() || regs.back() != needs[i].regAddr)
+            regs.push_back(needs[i].regAddr);
+    }
+
+    // cost[j] is min airtime of first j registers, last read of them starts at register split[j]
+    cost.assign(regs.size() + 1, 0);
+    split.assign(regs.size() + 1, 0);
+    for (j = 1; j <= static_cast<int>(regs.size()); j++)
+    {
+        cost[j] = UINT64_MAX;
+        for (i = j - 1; 0 <= i && regs[j - 1] - regs[i] < MB_READ_REGS_MAX; i--)
+        {
+            if (i < j - 1 && regs[i + 1] - regs[i] - 1 > maxGap)
+                break;
+            time = cost[i] + readTime(regs[j - 1] - regs[i] + 1);
+            // Equal time is taken by fewer reads
+            if (time <= cost[j])
+            {
+                cost[j] = time;
+                split[j] = i;
+            }
+        }
+    }
+
+    for (j = regs.size(); 0 < j; j = split[j])
+        readsAmount++;
+    if (readsAmount > maxReads)
+        return -1;
+    i = readsAmount;
+    for (j = regs.size(); 0 < j; j = split[j])
+    {
+        i--;
+        reads[i].slaveId = needs[0].slaveId;
+        reads[i].fid = needs[0].fid;
+        reads[i].regAddr = regs[split[j]];
+        reads[i].regsAmount = regs[j - 1] - regs[split[j]] + 1;
+    }
+    return readsAmount;
+}
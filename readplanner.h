@@ -0,0 +1,79 @@
+#ifndef READPLANNER_H
+#define READPLANNER_H
+
+#include <stdint.h>
+#include "modbus.h"
+#include "rtuengine.h"
+
+namespace ModBus
+{
+
+//! Register, which must be read
+typedef struct _mbRegisterNeed_t
+{
+    uint8_t slaveId;                    //!< Slave id
+    uint8_t fid;                        //!< Function id (MB_READ_HOLDING_REGISTERS_FID or MB_READ_INPUT_REGISTERS_FID)
+    uint16_t regAddr;                   //!< Address of register
+} mbRegisterNeed_t;
+
+//! Read request of plan
+typedef struct _mbPlannedRead_t
+{
+    uint8_t slaveId;                    //!< Slave id
+    uint8_t fid;                        //!< Function id (MB_READ_HOLDING_REGISTERS_FID or MB_READ_INPUT_REGISTERS_FID)
+    uint16_t regAddr;                   //!< Address of first register
+    uint16_t regsAmount;                //!< Amount of registers (1 - MB_READ_REGS_MAX)
+} mbPlannedRead_t;
+
+/**
+ * @brief The ReadPlanner class provide covering of set of registers by read requests with minimal airtime
+ *
+ * Every read costs fixed overhead of transaction (turnaround of slave, silence between frames) and time
+ * of its bytes on line. Registers of one slave and function are merged into one read across gap, when
+ * reading of unneeded registers of gap is cheaper than one more transaction. Plan is optimal for sorted
+ * registers (dynamic programming over splits), reads are limited by MB_READ_REGS_MAX registers.
+ * Class does not depend on Qt.
+ */
+class ReadPlanner
+{
+public:
+    /**
+     * @brief ReadPlanner class constructor
+     * @param timing timing of RTU frames of bus (see RtuEngine::getFrameTiming)
+     * @param overhead time of transaction, which does not depend on size of frames (ns, see RtuEngine::getTransactionOverhead)
+     */
+    ReadPlanner(const mbFrameTiming_t &timing, uint64_t overhead);
+    /**
+     * @brief setMaxGap set max amount of unneeded registers between needed registers of one read
+     *
+     * Slaves, which answer exception on read of registers out of their map, need 0.
+     * @param gap amount of registers (MB_READ_REGS_MAX by default)
+     */
+    inline void setMaxGap(uint16_t gap) { maxGap = gap; }
+    /**
+     * @brief readTime get airtime of read with overhead of transaction
+     * @param regsAmount amount of registers
+     * @return time (ns)
+     */
+    uint64_t readTime(uint16_t regsAmount) const;
+    /**
+     * @brief plan cover needed registers by read requests
+     * @param needs array of needed registers (in any order, duplicates are allowed)
+     * @param amount amount of needed registers
+     * @param reads array for read requests (sorted by slave id, function id and address)
+     * @param maxReads size of array of read requests
+     * @return amount of read requests, -1 if function of need is not read of registers or array is too small
+     */
+    int plan(const mbRegisterNeed_t *needs, int amount, mbPlannedRead_t *reads, int maxReads) const;
+
+private:
+    int planSlave(const mbRegisterNeed_t *needs, int amount, mbPlannedRead_t *reads, int maxReads) const;
+
+    mbFrameTiming_t timing;
+    uint64_t overhead;
+    uint16_t maxGap;
+};
+
+}
+
+#endif // READPLANNER_H
@@ -0,0 +1,93 @@
+#include "realtime.h"
+#include "logger.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <string.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <alloca.h>
+
+rtThreadConfig_t RealTime::defaultConfig()
+{
+    rtThreadConfig_t config;
+
+    config.policy = SCHED_OTHER;
+    config.priority = 0;
+    config.cpu = -1;
+    return config;
+}
+
+bool RealTime::parsePolicy(const char *description, rtThreadConfig_t *config)
+{
+    const char *separator = strchr(description, ':');
+    size_t length = (0 != separator) ? static_cast<size_t>(separator - description) : strlen(description);
+    int priority = 0;
+
+    if (2 == length && 0 == strncmp(description, "rr", 2))
+        config->policy = SCHED_RR;
+    else if (4 == length && 0 == strncmp(description, "fifo", 4))
+        config->policy = SCHED_FIFO;
+    else if (5 == length && 0 == strncmp(description, "other", 5))
+    {
+        config->policy = SCHED_OTHER;
+        config->priority = 0;
+        return true;
+    }
+    else
+        return false;
+
+    priority = (0 != separator) ? atoi(separator + 1) : 1;
+    if (priority < sched_get_priority_min(config->policy) || priority > sched_get_priority_max(config->policy))
+        return false;
+    config->priority = priority;
+    return true;
+}
+
+bool RealTime::applyToCurrentThread(const rtThreadConfig_t &config)
+{
+    struct sched_param param;
+    cpu_set_t cpus;
+    bool result = true;
+    int error = 0;
+
+    memset(&param, 0, sizeof(param));
+    param.sched_priority = config.priority;
+    if (0 != (error = pthread_setschedparam(pthread_self(), config.policy, &param)))
+    {
+        LOG_ERROR("RealTime", "Can`t set scheduling policy: %s", strerror(error));
+        result = false;
+    }
+
+    if (0 <= config.cpu)
+    {
+        CPU_ZERO(&cpus);
+        CPU_SET(config.cpu, &cpus);
+        if (0 != (error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus)))
+        {
+            LOG_ERROR("RealTime", "Can`t pin thread to CPU %d: %s", config.cpu, strerror(error));
+            result = false;
+        }
+    }
+    return result;
+}
+
+bool RealTime::lockMemory()
+{
+    if (0 != mlockall(MCL_CURRENT | MCL_FUTURE))
+    {
+        LOG_ERROR("RealTime", "Can`t lock memory: %s", strerror(errno));
+        return false;
+    }
+    return true;
+}
+
+void RealTime::prefaultStack(size_t size)
+{
+    // Volatile buffer is not removed by compiler, every page of it is written
+    volatile char *stack = static_cast<volatile char *>(alloca(size));
+    size_t i = 0;
+
+    for (i = 0; i < size; i += 4096)
+        stack[i] = 0;
+}
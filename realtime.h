@@ -0,0 +1,50 @@
+#ifndef REALTIME_H
+#define REALTIME_H
+
+#include <stddef.h>
+
+//! Scheduling options of thread
+typedef struct _rtThreadConfig_t
+{
+    int policy;                         //!< Scheduling policy (SCHED_OTHER, SCHED_FIFO or SCHED_RR)
+    int priority;                       //!< Priority of SCHED_FIFO and SCHED_RR policies (1-99)
+    int cpu;                            //!< CPU of thread, -1 - thread is not pinned
+} rtThreadConfig_t;
+
+/**
+ * @brief The RealTime class provide real-time scheduling, CPU pinning and memory locking of threads
+ */
+class RealTime
+{
+public:
+    /**
+     * @brief defaultConfig get options of thread without changes (SCHED_OTHER, not pinned)
+     * @return options of thread
+     */
+    static rtThreadConfig_t defaultConfig();
+    /**
+     * @brief parsePolicy get scheduling options by description
+     * @param description policy with optional priority ("other", "fifo:<priority>" or "rr:<priority>")
+     * @param config pointer to result options (cpu is not changed)
+     * @return true if description is correct
+     */
+    static bool parsePolicy(const char *description, rtThreadConfig_t *config);
+    /**
+     * @brief applyToCurrentThread set scheduling policy and CPU of calling thread
+     * @param config options of thread
+     * @return true if all options have been applied
+     */
+    static bool applyToCurrentThread(const rtThreadConfig_t &config);
+    /**
+     * @brief lockMemory lock current and future pages of process in RAM
+     * @return true if memory has been locked
+     */
+    static bool lockMemory();
+    /**
+     * @brief prefaultStack touch stack of calling thread, so locked pages are mapped before time-critical work
+     * @param size size of touched stack (bytes)
+     */
+    static void prefaultStack(size_t size);
+};
+
+#endif // REALTIME_H
@@ -0,0 +1,712 @@
+#include "rtuengine.h"
+#include "logger.h"
+#include <fcntl.h>
+#include <termios.h>
+#include <errno.h>
+#include <unistd.h>
+#include <string.h>
+#include <poll.h>
+#include <libgen.h>
+#include <sys/timerfd.h>
+#include <sys/inotify.h>
+
+#define MB_RESPONSE_TIMEOUT     100         // Max time from end of request transmit to first byte of response (ms)
+#define MB_QUEUE_MAX_SIZE       127         // Max amount of transactions in send queue
+#define MB_TURNAROUND_DEFAULT   5           // Assumed turnaround of slave until first transaction is measured (ms)
+#define MB_OVERHEAD_WEIGHT      8           // Weight of old value of measured transaction overhead (moving average)
+#define MB_REOPEN_INTERVAL      250         // Interval of reopen attempts of lost port without inotify events (ms)
+
+// Character is 11 bits on line (start, 8 data, parity or second stop, stop), t1.5 and t3.5 are in characters
+static const ModBus::mbFrameTiming_t frameTimings[] =
+{
+    { 4583333, 6875000, 16041667 },         // BR_2400
+    { 2291667, 3437500, 8020833 },          // BR_4800
+    { 1145833, 1718750, 4010417 }           // BR_9600
+};
+
+ModBus::RtuEngine::RtuEngine(RtuEngineListener *listener)
+{
+    this->listener = listener;
+    frameRecorder = 0;
+    retryPolicy.maxRetries = 0;
+    retryPolicy.backoffBase = 50;
+    retryPolicy.backoffMax = 1000;
+    retryPolicy.breakerThreshold = 0;
+    retryPolicy.probeInterval = 5000;
+    retryPolicy.parkOnLoss = true;
+    memset(slaveHealth, 0, sizeof(slaveHealth));
+    timing = frameTiming(BR_9600);
+    metrics.transactionOverhead = timing.t35 + static_cast<uint64_t>(MB_TURNAROUND_DEFAULT) * 1000000;
+    initialOverhead = 0;
+    exchangeState = STATE_CLOSED;
+    deviceDescriptor = -1;
+    watchId = -1;
+    baudRate = BR_9600;
+    portWakeup = false;
+    adapterLatency = 20;
+    lastTransactionId = 0;
+    memset(rxData, 0, sizeof(rxData));
+    busIdleTime = 0;
+    lastByteTime = 0;
+    responseDeadline = 0;
+    transmitReadyTime = 0;
+    scheduledTime = 0;
+
+    // State is updated by timer and by received bytes, so frames are spaced by t3.5 instead of timer tick
+    if (-1 == (timerDescriptor = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)))
+        LOG_ERROR("ModBus", "Can`t create timer!");
+    // Device node of unplugged adapter is waited without polling of file system
+    if (-1 == (watchDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)))
+        LOG_WARNING("ModBus", "Can`t create watch of devices, lost port is reopened by timer!");
+}
+
+ModBus::RtuEngine::~RtuEngine()
+{
+    mbTransaction_t *transaction = 0;
+
+    while (!sendQueue.empty())
+    {
+        transaction = sendQueue.front();
+        sendQueue.pop_front();
+        delete transaction->txFrame;
+        delete transaction;
+    }
+    if (-1 != deviceDescriptor)
+        close(deviceDescriptor);
+    if (-1 != timerDescriptor)
+        close(timerDescriptor);
+    if (-1 != watchDescriptor)
+        close(watchDescriptor);
+}
+
+const ModBus::mbFrameTiming_t &ModBus::RtuEngine::frameTiming(BaudRate br)
+{
+    if (BR_2400 == br || BR_4800 == br)
+        return frameTimings[br];
+    return frameTimings[BR_9600];
+}
+
+ModBus::ModBusError ModBus::RtuEngine::open(const char *device, BaudRate br)
+{
+    devicePath = device;
+    baudRate = br;
+    timing = frameTiming(br);
+    metrics.transactionOverhead = (0 != initialOverhead) ? initialOverhead : timing.t35 + static_cast<uint64_t>(MB_TURNAROUND_DEFAULT) * 1000000;
+    return configure(monotonicTime());
+}
+
+ModBus::ModBusError ModBus::RtuEngine::configure(uint64_t now)
+{
+    const char *device = devicePath.c_str();
+    struct termios portOptions;
+    int result = 0;
+
+    if (-1 == (deviceDescriptor = ::open(device, O_RDWR | O_NOCTTY | O_NONBLOCK)))
+    {
+        LOG_ERROR("ModBus", "Can`t create device descriptor!");
+        return MB_ERROR_DESCRIPTOR;
+    }
+    if (0 != tcgetattr(deviceDescriptor, &portOptions))
+    {
+        LOG_ERROR("ModBus", "Can`t get port options!");
+        close(deviceDescriptor);
+        deviceDescriptor = -1;
+        return MB_ERROR_PORTOPTION;
+    }
+
+    LOG_DEBUG("ModBus", "%s options:", device);
+    LOG_DEBUG("ModBus", "c_iflag 0x%x", portOptions.c_iflag);
+    LOG_DEBUG("ModBus", "c_oflag 0x%x", portOptions.c_oflag);
+    LOG_DEBUG("ModBus", "c_cflag 0x%x", portOptions.c_cflag);
+    LOG_DEBUG("ModBus", "c_lflag 0x%x", portOptions.c_lflag);
+    LOG_DEBUG("ModBus", "c_ispeed %u", portOptions.c_ispeed);
+    LOG_DEBUG("ModBus", "c_ospeed %u", portOptions.c_ospeed);
+
+    switch(baudRate)
+    {
+    case BR_2400:
+        result = cfsetspeed(&portOptions, B2400);
+        break;
+    case BR_4800:
+        result = cfsetspeed(&portOptions, B4800);
+        break;
+    case BR_9600:
+    default:
+        result = cfsetspeed(&portOptions, B9600);
+        break;
+    }
+    if (0 != result)
+    {
+        LOG_ERROR("ModBus", "Can`t set speed!");
+        close(deviceDescriptor);
+        deviceDescriptor = -1;
+        return MB_ERROR_SETSPEED;
+    }
+
+    // Frames are binary and their end is detected by silence on line, so port is raw
+    portOptions.c_iflag &= ~(IGNBRK | BRKINT | PARMRK | ISTRIP | INLCR | IGNCR | ICRNL | IXON);
+    portOptions.c_oflag &= ~OPOST;
+    portOptions.c_lflag &= ~(ECHO | ECHONL | ICANON | ISIG | IEXTEN);
+    portOptions.c_cflag &= ~PARENB;
+    portOptions.c_cflag &= ~CSTOPB;
+    portOptions.c_cflag &= ~CSIZE;
+    portOptions.c_cflag |= CS8 | CLOCAL | CREAD;
+    portOptions.c_cc[VMIN] = 0;
+    portOptions.c_cc[VTIME] = 0;
+
+    if (0 > tcsetattr(deviceDescriptor, TCSANOW, &portOptions))
+    {
+        LOG_ERROR("ModBus", "Can`t set port options!");
+        close(deviceDescriptor);
+        deviceDescriptor = -1;
+        return MB_ERROR_SETOPTION;
+    }
+
+    LOG_INFO("ModBus", "Port has been configured success!");
+    busIdleTime = now;
+    exchangeState = sendQueue.empty() ? STATE_IDLE : STATE_TRANSMIT;
+    if (STATE_TRANSMIT == exchangeState)
+        scheduleUpdate(busIdleTime + timing.t35);
+    return MB_ERROR_NONE;
+}
+
+void ModBus::RtuEngine::process()
+{
+    struct inotify_event events[16];
+    uint64_t expirations = 0;
+    uint64_t now = monotonicTime();
+
+    portWakeup = true;
+    if (-1 != timerDescriptor && sizeof(expirations) == read(timerDescriptor, &expirations, sizeof(expirations)))
+    {
+        // Delay between expiration and handling of timer is jitter of bus thread
+        if (0 != scheduledTime && now >= scheduledTime)
+            metrics.recordWakeup(now - scheduledTime);
+        scheduledTime = 0;
+        portWakeup = false;
+    }
+    // Watch is drained always: removed watch queues IN_IGNORED and events received before removal stay queued,
+    // so not drained descriptor would stay readable. While port is lost any event is reason to try reopen
+    while (-1 != watchDescriptor && 0 < read(watchDescriptor, events, sizeof(events)))
+        portWakeup = false;
+    if (STATE_LOST == exchangeState)
+    {
+        reopen(now);
+        return;
+    }
+    if (STATE_CLOSED == exchangeState)
+        return;
+    if (STATE_RECEIVE != exchangeState)
+        dropStray(now);
+    if (STATE_LOST != exchangeState)
+        update(now);
+}
+
+void ModBus::RtuEngine::wait(int timeout)
+{
+    struct pollfd descriptors[3];
+
+    descriptors[0].fd = timerDescriptor;
+    descriptors[0].events = POLLIN;
+    descriptors[0].revents = 0;
+    descriptors[1].fd = deviceDescriptor;
+    descriptors[1].events = POLLIN;
+    descriptors[1].revents = 0;
+    descriptors[2].fd = watchDescriptor;
+    descriptors[2].events = POLLIN;
+    descriptors[2].revents = 0;
+
+    if (0 < poll(descriptors, 3, timeout))
+        process();
+}
+
+void ModBus::RtuEngine::dropStray(uint64_t now)
+{
+    uint8_t garbage[64];
+    int result = 0;
+
+    // Bytes out of transaction (late response) are dropped, line is busy until t3.5 after them
+    while (0 < (result = read(deviceDescriptor, garbage, sizeof(garbage))))
+        busIdleTime = now;
+    // Port is readable without data only after hangup
+    if ((0 == result && portWakeup) || (-1 == result && EAGAIN != errno))
+        checkPort(now);
+}
+
+bool ModBus::RtuEngine::checkPort(uint64_t now)
+{
+    struct pollfd descriptor;
+
+    descriptor.fd = deviceDescriptor;
+    descriptor.events = POLLIN;
+    descriptor.revents = 0;
+    if (0 > poll(&descriptor, 1, 0) || 0 == (descriptor.revents & (POLLHUP | POLLERR | POLLNVAL)))
+        return true;
+    portLost(now);
+    return false;
+}
+
+void ModBus::RtuEngine::portLost(uint64_t now)
+{
+    mbTransaction_t *transaction = 0;
+    std::string directory = devicePath;
+
+    LOG_WARNING("ModBus", "Port %s has been lost!", devicePath.c_str());
+    ModBusMetrics::add(&metrics.portLosses);
+    exchangeState = STATE_LOST;
+    listener->portStateChanged(false);
+    close(deviceDescriptor);
+    deviceDescriptor = -1;
+
+    // Interrupted transaction is transmitted again after reopen
+    if (!sendQueue.empty())
+    {
+        transaction = sendQueue.front();
+        transaction->countReadBytes = 0;
+        transaction->errorChecked = false;
+    }
+    if (!retryPolicy.parkOnLoss)
+    {
+        while (!sendQueue.empty())
+        {
+            transaction = sendQueue.front();
+            sendQueue.pop_front();
+            listener->transactionFailed(transaction, MB_ERROR_PORT_LOST);
+            delete transaction->txFrame;
+            delete transaction;
+        }
+        metrics.queueDepth = 0;
+    }
+
+    // Node of device is created again by udev, when adapter returns
+    if (-1 != watchDescriptor)
+        watchId = inotify_add_watch(watchDescriptor, dirname(&directory[0]), IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+    scheduleUpdate(now + static_cast<uint64_t>(MB_REOPEN_INTERVAL) * 1000000);
+}
+
+void ModBus::RtuEngine::reopen(uint64_t now)
+{
+    // Node appears before udev sets its permissions, so open is tried only for accessible node
+    if (0 != access(devicePath.c_str(), R_OK | W_OK) || MB_ERROR_NONE != configure(now))
+    {
+        scheduleUpdate(now + static_cast<uint64_t>(MB_REOPEN_INTERVAL) * 1000000);
+        return;
+    }
+
+    if (-1 != watchId)
+    {
+        inotify_rm_watch(watchDescriptor, watchId);
+        watchId = -1;
+    }
+    LOG_INFO("ModBus", "Port %s has been reopened", devicePath.c_str());
+    listener->portStateChanged(true);
+}
+
+void ModBus::RtuEngine::update(uint64_t now)
+{
+    uint64_t deadline = 0;
+
+    if (STATE_TRANSMIT == exchangeState)
+        transmit(now);
+    else if (STATE_RECEIVE == exchangeState)
+        receive(now);
+
+    // Next update is at time, when current state can change
+    if (STATE_TRANSMIT == exchangeState)
+    {
+        deadline = busIdleTime + timing.t35;
+        if (0 != transmitReadyTime && transmitReadyTime > deadline)
+            deadline = transmitReadyTime;
+        scheduleUpdate(deadline);
+    }
+    else if (STATE_RECEIVE == exchangeState)
+    {
+        if (0 == sendQueue.front()->countReadBytes)
+            scheduleUpdate(responseDeadline);
+        else
+            scheduleUpdate(lastByteTime + timing.t15 + static_cast<uint64_t>(adapterLatency) * 1000000);
+    }
+    else if (STATE_LOST != exchangeState)
+        scheduleUpdate(0);
+}
+
+void ModBus::RtuEngine::transmit(uint64_t now)
+{
+    mbTransaction_t *transaction = 0;
+
+    transmitReadyTime = 0;
+    if (sendQueue.empty())
+    {
+        exchangeState = STATE_IDLE;
+        return;
+    }
+    // Frames are separated by silence of t3.5
+    if (now < busIdleTime + timing.t35)
+        return;
+    if (0 == (transaction = nextTransaction(now, &transmitReadyTime)))
+    {
+        if (sendQueue.empty())
+            exchangeState = STATE_IDLE;
+        return;
+    }
+
+    if (transaction->txSize != write(deviceDescriptor, transaction->txFrame->uint8, transaction->txSize))
+    {
+        if (!checkPort(now))
+            return;
+        LOG_ERROR("ModBus", "Write len != transactionSize!");
+        ModBusMetrics::add(&metrics.transmitErrors);
+        busIdleTime = now;
+        fail(transaction, MB_ERROR_TRANSMIT, false, now);
+        return;
+    }
+
+    transaction->transmitTime = now;
+    if (0 != frameRecorder)
+        frameRecorder->record(FrameRecorder::DIRECTION_TX, transaction->txFrame->uint8, transaction->txSize);
+    metrics.enqueueToTransmit.record(transaction->transmitTime - transaction->enqueueTime);
+    ModBusMetrics::add(&metrics.txBytes, transaction->txSize);
+    // Write returns when frame is in driver, response timeout starts at end of frame on line
+    responseDeadline = now + static_cast<uint64_t>(timing.charTime) * transaction->txSize +
+            static_cast<uint64_t>(MB_RESPONSE_TIMEOUT) * 1000000;
+    memset(rxData, 0, sizeof(rxData));
+    exchangeState = STATE_RECEIVE;
+}
+
+void ModBus::RtuEngine::receive(uint64_t now)
+{
+    mbTransaction_t *transaction = sendQueue.front();
+    uint16_t length = 0;
+    uint64_t deadline = 0;
+    int result = 0;
+
+    if (-1 == (result = read(deviceDescriptor, &rxData[transaction->countReadBytes], sizeof(rxData) - transaction->countReadBytes)))
+    {
+        if (EAGAIN != errno)
+        {
+            if (!checkPort(now))
+                return;
+            LOG_ERROR("ModBus", "Read error!");
+            ModBusMetrics::add(&metrics.receiveErrors);
+            busIdleTime = now;
+            if (0 != frameRecorder && 0 != transaction->countReadBytes)
+                frameRecorder->record(FrameRecorder::DIRECTION_RX, rxData, transaction->countReadBytes, FrameRecorder::FLAG_PARTIAL);
+            fail(transaction, MB_ERROR_RECEIVE, false, now);
+            return;
+        }
+        result = 0;
+    }
+    else if (0 == result && portWakeup && !checkPort(now))
+        return;
+
+    if (0 < result)
+    {
+        if (0 == transaction->countReadBytes)
+            metrics.transmitToFirstByte.record(now - transaction->transmitTime);
+        ModBusMetrics::add(&metrics.rxBytes, result);
+        lastByteTime = now;
+        transaction->countReadBytes += result;
+    }
+
+    if (transaction->countReadBytes >= transaction->rxSize)
+        length = transaction->rxSize;
+    else if (false == transaction->errorChecked && transaction->countReadBytes >= sizeof(ModBus::mbException_t))
+    {
+        transaction->errorChecked = true;
+        if (0 != reinterpret_cast<mbException_t *>(&rxData[0])->err)
+            length = sizeof(ModBus::mbException_t);
+    }
+    if (0 != length)
+    {
+        busIdleTime = now;
+        transaction->rxFrame = new mbFrame_t;
+        memcpy(transaction->rxFrame->uint8, rxData, length);
+        transaction->crcCheck = ModBusCodec::checkCRC(rxData, length);
+        metrics.transmitToComplete.record(now - transaction->transmitTime);
+        measureOverhead(transaction, length, now);
+        ModBusMetrics::add(&metrics.transactions);
+        if (0 != frameRecorder)
+            frameRecorder->record(FrameRecorder::DIRECTION_RX, rxData, length);
+        if (!transaction->crcCheck)
+            ModBusMetrics::add(&metrics.crcErrors);
+        else if (0 != transaction->rxFrame->hdr.err)
+            metrics.recordException(transaction->rxFrame->exception.status);
+        finish(transaction, now);
+        return;
+    }
+
+    // Response is ended by response timeout or, when it has been started, by silence after last byte
+    if (0 == transaction->countReadBytes)
+        deadline = responseDeadline;
+    else
+        deadline = lastByteTime + timing.t15 + static_cast<uint64_t>(adapterLatency) * 1000000;
+    if (now >= deadline)
+    {
+        if (0 == transaction->countReadBytes)
+            LOG_WARNING("ModBus", "Read timeout!");
+        else
+            LOG_WARNING("ModBus", "Response is incomplete!");
+        ModBusMetrics::add(&metrics.timeouts);
+        busIdleTime = now;
+        if (0 != frameRecorder && 0 != transaction->countReadBytes)
+            frameRecorder->record(FrameRecorder::DIRECTION_RX, rxData, transaction->countReadBytes, FrameRecorder::FLAG_PARTIAL);
+        fail(transaction, MB_ERROR_RECEIVE_TIMEOUT, true, now);
+    }
+}
+
+void ModBus::RtuEngine::measureOverhead(mbTransaction_t *transaction, uint16_t length, uint64_t now)
+{
+    int64_t sample = 0;
+    int64_t overhead = metrics.transactionOverhead;
+
+    // Overhead is time of transaction, which does not depend on size of frames: turnaround of slave,
+    // delivery of response by adapter and silence before next frame
+    sample = static_cast<int64_t>(now - transaction->transmitTime) + timing.t35 -
+            static_cast<int64_t>(timing.charTime) * (transaction->txSize + length);
+    if (sample < static_cast<int64_t>(timing.t35))
+        sample = timing.t35;
+    metrics.transactionOverhead = overhead + (sample - overhead) / MB_OVERHEAD_WEIGHT;
+}
+
+void ModBus::RtuEngine::finish(mbTransaction_t *transaction, uint64_t now)
+{
+    if (!transaction->crcCheck && retryTransaction(transaction, now))
+    {
+        exchangeState = STATE_TRANSMIT;
+        return;
+    }
+
+    slaveResult(transaction->txFrame->hdr.addr, transaction->crcCheck, now);
+    sendQueue.pop_front();
+    metrics.queueDepth = sendQueue.size();
+    exchangeState = sendQueue.empty() ? STATE_IDLE : STATE_TRANSMIT;
+    listener->transactionFinished(transaction);
+}
+
+void ModBus::RtuEngine::fail(mbTransaction_t *transaction, ModBusError error, bool retry, uint64_t now)
+{
+    if (retry && retryTransaction(transaction, now))
+    {
+        exchangeState = STATE_TRANSMIT;
+        return;
+    }
+
+    if (MB_ERROR_RECEIVE_TIMEOUT == error)
+        slaveResult(transaction->txFrame->hdr.addr, false, now);
+    sendQueue.pop_front();
+    metrics.queueDepth = sendQueue.size();
+    exchangeState = sendQueue.empty() ? STATE_IDLE : STATE_TRANSMIT;
+    listener->transactionFailed(transaction, error);
+
+    delete transaction->txFrame;
+    delete transaction;
+}
+
+void ModBus::RtuEngine::scheduleUpdate(uint64_t time)
+{
+    struct itimerspec timerValue;
+    uint64_t now = 0;
+
+    if (-1 == timerDescriptor)
+        return;
+
+    // Zero time disarms timer, time in past is counted from now for wakeup statistics
+    now = monotonicTime();
+    scheduledTime = (0 != time && time < now) ? now : time;
+    memset(&timerValue, 0, sizeof(timerValue));
+    timerValue.it_value.tv_sec = time / 1000000000ULL;
+    timerValue.it_value.tv_nsec = time % 1000000000ULL;
+    timerfd_settime(timerDescriptor, TFD_TIMER_ABSTIME, &timerValue, 0);
+}
+
+int ModBus::RtuEngine::createRequest(void *owner, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr, uint16_t value)
+{
+    mbTransaction_t *transaction = 0;
+    mbRequest_t request;
+
+    if (sendQueue.size() >= MB_QUEUE_MAX_SIZE || (STATE_LOST == exchangeState && !retryPolicy.parkOnLoss))
+        return -1;
+
+    request.fid = fid;
+    request.slaveId = slaveId;
+    request.valAddr = valAddr;
+    request.value = value;
+    request.tag = 0;
+    request.frame = 0;
+    if (0 == (transaction = buildTransaction(owner, request)))
+        return -1;
+    enqueue(&transaction, 1);
+    return transaction->transactionId;
+}
+
+int ModBus::RtuEngine::createRequest(void *owner, const mbRequestFrame_t &frame)
+{
+    mbTransaction_t *transaction = 0;
+    mbRequest_t request;
+
+    if (sendQueue.size() >= MB_QUEUE_MAX_SIZE || (STATE_LOST == exchangeState && !retryPolicy.parkOnLoss))
+        return -1;
+
+    memset(&request, 0, sizeof(request));
+    request.frame = &frame;
+    if (0 == (transaction = buildTransaction(owner, request)))
+        return -1;
+    enqueue(&transaction, 1);
+    return transaction->transactionId;
+}
+
+ModBus::mbTransaction_t *ModBus::RtuEngine::buildTransaction(void *owner, const mbRequest_t &request)
+{
+    mbTransaction_t *transaction = new mbTransaction_t;
+
+    transaction->txFrame = new mbFrame_t;
+    // Built request is only copied, so constant polls do not pay for encoding and CRC
+    if (0 != request.frame && 0 != request.frame->txSize)
+        ModBusCodec::copyRequest(transaction, *request.frame);
+    else if (0 != request.frame || !ModBusCodec::encodeRequest(transaction, request.fid, request.slaveId, request.valAddr, request.value))
+    {
+        delete transaction->txFrame;
+        delete transaction;
+        LOG_ERROR("ModBus", "Unsupported function ID or amount of registers!");
+        return 0;
+    }
+
+    transaction->owner = owner;
+    transaction->errorChecked = false;
+    transaction->crcCheck = false;
+    transaction->countReadBytes = 0;
+    transaction->rxFrame = 0;
+    transaction->retries = 0;
+    transaction->retryTime = 0;
+    transaction->transmitTime = 0;
+    transaction->transactionId = 0;
+    transaction->tag = request.tag;
+    transaction->enqueueTime = monotonicTime();
+    return transaction;
+}
+
+int ModBus::RtuEngine::enqueue(mbTransaction_t *const *transactions, int amount)
+{
+    int i = 0;
+
+    if (0 >= amount || sendQueue.size() + amount > MB_QUEUE_MAX_SIZE || (STATE_LOST == exchangeState && !retryPolicy.parkOnLoss))
+        return -1;
+
+    for (i = 0; i < amount; i++)
+    {
+        transactions[i]->transactionId = lastTransactionId;
+        lastTransactionId++;
+        sendQueue.push_back(transactions[i]);
+    }
+    metrics.queueDepth = sendQueue.size();
+
+    // Whole batch is started by one timer update. Timer of transmit state may wait for end of backoff of queued
+    // retries, new requests are not delayed by it
+    if (STATE_IDLE == exchangeState)
+    {
+        exchangeState = STATE_TRANSMIT;
+        scheduleUpdate(busIdleTime + timing.t35);
+    }
+    else if (STATE_TRANSMIT == exchangeState && (0 == scheduledTime || busIdleTime + timing.t35 < scheduledTime))
+        scheduleUpdate(busIdleTime + timing.t35);
+    return amount;
+}
+
+ModBus::mbTransaction_t *ModBus::RtuEngine::nextTransaction(uint64_t now, uint64_t *readyTime)
+{
+    mbTransaction_t *transaction = 0;
+    slaveHealth_t *health = 0;
+    size_t i = 0;
+
+    *readyTime = 0;
+    while (i < sendQueue.size())
+    {
+        transaction = sendQueue[i];
+        health = &slaveHealth[transaction->txFrame->hdr.addr];
+        if (health->open && now < health->probeTime)
+        {
+            // Slave does not respond, request fails without transmit
+            ModBusMetrics::add(&metrics.rejected);
+            sendQueue.erase(sendQueue.begin() + i);
+            metrics.queueDepth = sendQueue.size();
+            listener->transactionFailed(transaction, MB_ERROR_SLAVE_UNAVAILABLE);
+
+            delete transaction->txFrame;
+            delete transaction;
+            continue;
+        }
+        if (now < transaction->retryTime)
+        {
+            if (0 == *readyTime || transaction->retryTime < *readyTime)
+                *readyTime = transaction->retryTime;
+            i++;
+            continue;
+        }
+
+        if (health->open)
+            health->probeTime = now + static_cast<uint64_t>(retryPolicy.probeInterval) * 1000000;
+        if (0 != i)
+        {
+            sendQueue.erase(sendQueue.begin() + i);
+            sendQueue.push_front(transaction);
+        }
+        return transaction;
+    }
+    return 0;
+}
+
+bool ModBus::RtuEngine::retryTransaction(mbTransaction_t *transaction, uint64_t now)
+{
+    uint64_t delay = 0;
+    uint8_t i = 0;
+
+    if (transaction->retries >= retryPolicy.maxRetries || slaveHealth[transaction->txFrame->hdr.addr].open)
+        return false;
+
+    transaction->retries++;
+    // Delay is doubled only until max, so shift does not overflow for any amount of retries
+    delay = retryPolicy.backoffBase;
+    for (i = 1; i < transaction->retries && delay < retryPolicy.backoffMax; i++)
+        delay <<= 1;
+    if (delay > retryPolicy.backoffMax)
+        delay = retryPolicy.backoffMax;
+    transaction->retryTime = now + delay * 1000000;
+
+    delete transaction->rxFrame;
+    transaction->rxFrame = 0;
+    transaction->countReadBytes = 0;
+    transaction->errorChecked = false;
+    ModBusMetrics::add(&metrics.retries);
+
+    // Retry waits in the tail of queue, requests to other slaves are not blocked by backoff
+    sendQueue.pop_front();
+    sendQueue.push_back(transaction);
+    return true;
+}
+
+void ModBus::RtuEngine::slaveResult(uint8_t slaveId, bool success, uint64_t now)
+{
+    slaveHealth_t *health = &slaveHealth[slaveId];
+
+    if (0 == retryPolicy.breakerThreshold)
+        return;
+
+    if (success)
+    {
+        if (health->open)
+            LOG_INFO("ModBus", "Slave %u responds, circuit breaker is closed", slaveId);
+        health->failures = 0;
+        health->open = false;
+        return;
+    }
+
+    if (health->failures < 0xFF)
+        health->failures++;
+    if (!health->open && health->failures >= retryPolicy.breakerThreshold)
+    {
+        LOG_WARNING("ModBus", "Slave %u does not respond, circuit breaker is open!", slaveId);
+        health->open = true;
+    }
+    if (health->open)
+        health->probeTime = now + static_cast<uint64_t>(retryPolicy.probeInterval) * 1000000;
+}
@@ -0,0 +1,306 @@
+#ifndef RTUENGINE_H
+#define RTUENGINE_H
+
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include "modbus.h"
+#include "modbuscodec.h"
+#include "modbusmetrics.h"
+
+namespace ModBus
+{
+
+//! Timing of RTU frames on line
+typedef struct _mbFrameTiming_t
+{
+    uint32_t charTime;                  //!< Time of one character (11 bits) on line (ns)
+    uint32_t t15;                       //!< Max silence between characters of frame (ns)
+    uint32_t t35;                       //!< Min silence between frames (ns)
+} mbFrameTiming_t;
+
+//! Retry policy of transactions and circuit breaker of slaves
+typedef struct _mbRetryPolicy_t
+{
+    uint8_t maxRetries;                 //!< Max amount of retries after timeout or incorrect CRC (0 - without retries)
+    uint16_t backoffBase;               //!< Delay before first retry (ms), doubled for every next retry
+    uint16_t backoffMax;                //!< Max delay before retry (ms)
+    uint8_t breakerThreshold;           //!< Amount of failed transactions in a row, which opens circuit breaker of slave
+                                        //!< (0 - circuit breaker is disabled)
+    uint16_t probeInterval;             //!< Interval between probe requests to slave with open circuit breaker (ms)
+    bool parkOnLoss;                    //!< Transactions wait for return of lost serial port (false - they fail with
+                                        //!< MB_ERROR_PORT_LOST and new requests are not accepted until return)
+} mbRetryPolicy_t;
+
+//! Descriptor of request of batch
+typedef struct _mbRequest_t
+{
+    mbFuncId_t fid;                     //!< Function id (see ModBus::mbFuncId_t)
+    uint8_t slaveId;                    //!< Slave id (1-255)
+    uint16_t valAddr;                   //!< Register/coil address
+    uint16_t value;                     //!< Value for write (amount of registers for read, 1 - MB_READ_REGS_MAX)
+    int tag;                            //!< Value of creator, which is kept in transaction (for ex. type of request)
+    const mbRequestFrame_t *frame;      //!< Built request, which is copied instead of encoding of fields above (0 - encode)
+} mbRequest_t;
+
+/**
+ * @brief The FrameRecorder class is interface of recorder of transmitted and received frames
+ */
+class FrameRecorder
+{
+public:
+    enum Direction
+    {
+        DIRECTION_TX = 0,                               //!< Frame transmitted by master
+        DIRECTION_RX                                    //!< Frame received from slave
+    };
+
+    enum Flags
+    {
+        FLAG_NONE = 0,                                  //!< Complete frame
+        FLAG_PARTIAL = 1                                //!< Incomplete frame (receive timeout or error)
+    };
+
+    virtual ~FrameRecorder() {}
+    /**
+     * @brief record add frame to recorder (called from I/O thread)
+     * @param direction direction of frame (see FrameRecorder::Direction)
+     * @param data pointer to frame bytes
+     * @param length length of frame
+     * @param flags flags of frame (see FrameRecorder::Flags)
+     */
+    virtual void record(Direction direction, const uint8_t *data, uint16_t length, uint8_t flags = FLAG_NONE) = 0;
+};
+
+/**
+ * @brief The RtuEngineListener class is interface of receiver of transaction results
+ *
+ * Memory of finished transaction is freed by listener, memory of failed transaction is freed by engine.
+ */
+class RtuEngineListener
+{
+public:
+    virtual ~RtuEngineListener() {}
+    /**
+     * @brief transactionFinished called when response has been received (with correct or incorrect CRC)
+     * @param transaction pointer to transaction (txFrame, rxFrame and transaction must be freed by listener)
+     */
+    virtual void transactionFinished(mbTransaction_t *transaction) = 0;
+    /**
+     * @brief transactionFailed called when transaction has been dropped without response
+     * @param transaction pointer to transaction (freed by engine after return)
+     * @param error error code (see ModBus::ModBusError)
+     */
+    virtual void transactionFailed(mbTransaction_t *transaction, ModBusError error) = 0;
+    /**
+     * @brief portStateChanged called when serial port has been lost or reopened
+     *
+     * On loss it is called before descriptor of port is closed, on reopen descriptor is new.
+     * @param available true if port has been reopened
+     */
+    virtual void portStateChanged(bool available) { (void)available; }
+};
+
+/**
+ * @brief The RtuEngine class provide Modbus RTU transaction engine on POSIX serial port
+ *
+ * Engine does not depend on Qt and has not own thread. It has three descriptors: serial port, timer and
+ * watch of device directory, owner of engine waits all of them (by poll or event loop) and calls process
+ * when any is readable. All methods must be called from one thread.
+ * Hangup of port (unplugged USB adapter) is detected on first wakeup after it, port is closed and
+ * reopened with the same options, when device node appears again (inotify, with timer as fallback).
+ */
+class RtuEngine
+{
+public:
+    /**
+     * @brief RtuEngine class constructor
+     * @param listener receiver of transaction results
+     */
+    explicit RtuEngine(RtuEngineListener *listener);
+    ~RtuEngine();
+    /**
+     * @brief open open and configure serial port
+     * @param device path to serial port device (for ex. /dev/ttyUSB0)
+     * @param br baud rate (see ModBus::BaudRate)
+     * @return ModBus::MB_ERROR_NONE or error of port configuration
+     */
+    ModBusError open(const char *device, BaudRate br);
+    /**
+     * @brief getDescriptor get descriptor of serial port
+     * @return descriptor (-1 if port is not opened)
+     */
+    inline int getDescriptor() { return deviceDescriptor; }
+    /**
+     * @brief getTimerDescriptor get descriptor of timer of engine
+     * @return descriptor (-1 if timer is not created)
+     */
+    inline int getTimerDescriptor() { return timerDescriptor; }
+    /**
+     * @brief getWatchDescriptor get descriptor of watch of device directory (readable while lost port is waited)
+     * @return descriptor (-1 if inotify is not available)
+     */
+    inline int getWatchDescriptor() { return watchDescriptor; }
+    /**
+     * @brief isPortLost check that serial port has been lost and is waited for reopen
+     * @return true if port is lost
+     */
+    inline bool isPortLost() { return STATE_LOST == exchangeState; }
+    /**
+     * @brief process update state of engine (when serial port or timer is readable)
+     */
+    void process();
+    /**
+     * @brief wait wait for readable descriptor and process engine (for program without event loop)
+     * @param timeout max time of waiting (ms), -1 - without limit
+     */
+    void wait(int timeout);
+    /**
+     * @brief isIdle check that engine has not transactions
+     * @return true if send queue is empty
+     */
+    inline bool isIdle() { return sendQueue.empty(); }
+    /**
+     * @brief createRequest create transaction to slave device
+     * @param owner pointer to creator of transaction (see mbTransaction_t::owner)
+     * @param fid function id (see ModBus::mbFuncId_t)
+     * @param slaveId slave id (1-255)
+     * @param valAddr register/coil address
+     * @param value value for write (amount of registers for read, 1 - MB_READ_REGS_MAX)
+     * @return internal transaction id, -1 on error
+     */
+    int createRequest(void *owner, mbFuncId_t fid, uint8_t slaveId, uint16_t valAddr = 0, uint16_t value = 0);
+    /**
+     * @brief createRequest create transaction by built request (frame and CRC are copied, see ModBusCodec::encodeRequestFrame)
+     * @param owner pointer to creator of transaction (see mbTransaction_t::owner)
+     * @param frame built request
+     * @return internal transaction id, -1 on error
+     */
+    int createRequest(void *owner, const mbRequestFrame_t &frame);
+    /**
+     * @brief buildTransaction build transaction with frame and CRC of request (does not use engine, may be called from any thread)
+     * @param owner pointer to creator of transaction (see mbTransaction_t::owner)
+     * @param request descriptor of request (see ModBus::mbRequest_t)
+     * @return pointer to transaction (freed by engine after enqueue, by caller otherwise), 0 if request is incorrect
+     */
+    static mbTransaction_t *buildTransaction(void *owner, const mbRequest_t &request);
+    /**
+     * @brief enqueue add built transactions to the tail of send queue (all or none of them)
+     * @param transactions array of transactions (see buildTransaction), ids are assigned by engine
+     * @param amount amount of transactions
+     * @return amount of enqueued transactions, -1 if queue has not place for all of them
+     */
+    int enqueue(mbTransaction_t *const *transactions, int amount);
+    /**
+     * @brief getMetrics get counters and latency histograms of bus
+     * @return pointer to metrics
+     */
+    inline ModBusMetrics *getMetrics() { return &metrics; }
+    /**
+     * @brief setRecorder set recorder of transmitted and received frames
+     * @param recorder pointer to recorder (0 for disable recording)
+     */
+    inline void setRecorder(FrameRecorder *recorder) { frameRecorder = recorder; }
+    /**
+     * @brief setRetryPolicy set retry policy of transactions and circuit breaker of slaves
+     * @param policy retry policy (see ModBus::mbRetryPolicy_t)
+     */
+    inline void setRetryPolicy(const mbRetryPolicy_t &policy) { retryPolicy = policy; }
+    /**
+     * @brief getRetryPolicy get retry policy of transactions and circuit breaker of slaves
+     * @return retry policy (by default without retries and circuit breaker)
+     */
+    inline mbRetryPolicy_t getRetryPolicy() { return retryPolicy; }
+    /**
+     * @brief setAdapterLatency set max delay of received bytes in serial adapter
+     * @param latency latency (ms, default 20)
+     */
+    inline void setAdapterLatency(uint16_t latency) { adapterLatency = latency; }
+    /**
+     * @brief frameTiming get timing of RTU frames for baud rate
+     * @param br baud rate (see ModBus::BaudRate)
+     * @return timing of frames
+     */
+    static const mbFrameTiming_t &frameTiming(BaudRate br);
+    /**
+     * @brief getFrameTiming get timing of RTU frames of opened port
+     * @return timing of frames
+     */
+    inline const mbFrameTiming_t &getFrameTiming() { return timing; }
+    /**
+     * @brief getTransactionOverhead get measured time of transaction, which does not depend on size of frames
+     *
+     * Overhead is moving average of turnaround of slaves, delivery of responses by adapter and silence
+     * between frames (until first response it is assumed as t3.5 and 5 ms of turnaround).
+     * @return overhead (ns)
+     */
+    inline uint64_t getTransactionOverhead() { return metrics.transactionOverhead; }
+    /**
+     * @brief setInitialOverhead set overhead of transaction, which is assumed until measurement (must be called before open)
+     * @param overhead overhead (ns, for ex. measured by previous run), 0 - t3.5 and 5 ms of turnaround
+     */
+    inline void setInitialOverhead(uint64_t overhead) { initialOverhead = overhead; }
+
+private:
+    enum ExchangeState
+    {
+        STATE_CLOSED = 0,
+        STATE_TRANSMIT,
+        STATE_RECEIVE,
+        STATE_IDLE,
+        STATE_LOST
+    };
+
+    //! State of circuit breaker of slave
+    typedef struct _slaveHealth_t
+    {
+        uint8_t failures;               //!< Amount of failed transactions in a row
+        bool open;                      //!< Circuit breaker is open
+        uint64_t probeTime;             //!< Time of next probe request (monotonic, ns)
+    } slaveHealth_t;
+
+    void update(uint64_t now);
+    void transmit(uint64_t now);
+    void receive(uint64_t now);
+    void finish(mbTransaction_t *transaction, uint64_t now);
+    void measureOverhead(mbTransaction_t *transaction, uint16_t length, uint64_t now);
+    void fail(mbTransaction_t *transaction, ModBusError error, bool retry, uint64_t now);
+    mbTransaction_t *nextTransaction(uint64_t now, uint64_t *readyTime);
+    bool retryTransaction(mbTransaction_t *transaction, uint64_t now);
+    void slaveResult(uint8_t slaveId, bool success, uint64_t now);
+    void scheduleUpdate(uint64_t time);
+    void dropStray(uint64_t now);
+    ModBusError configure(uint64_t now);
+    bool checkPort(uint64_t now);
+    void portLost(uint64_t now);
+    void reopen(uint64_t now);
+
+    RtuEngineListener *listener;
+    FrameRecorder *frameRecorder;
+    std::deque<mbTransaction_t *> sendQueue;
+    ModBusMetrics metrics;
+    mbRetryPolicy_t retryPolicy;
+    slaveHealth_t slaveHealth[256];
+    mbFrameTiming_t timing;
+    ExchangeState exchangeState;
+    int deviceDescriptor;
+    int timerDescriptor;
+    int watchDescriptor;
+    int watchId;
+    std::string devicePath;
+    BaudRate baudRate;
+    bool portWakeup;
+    uint16_t adapterLatency;
+    uint8_t lastTransactionId;
+    uint8_t rxData[MB_FRAME_MAX_SIZE];
+    uint64_t busIdleTime;
+    uint64_t lastByteTime;
+    uint64_t responseDeadline;
+    uint64_t transmitReadyTime;
+    uint64_t scheduledTime;
+    uint64_t initialOverhead;
+};
+
+}
+
+#endif // RTUENGINE_H
@@ -0,0 +1,95 @@
+#include "sharedreadings.h"
+#include "logger.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+SharedReadings::SharedReadings(QObject *parent) :
+    QObject(parent)
+{
+    header = 0;
+    stationSlots = 0;
+}
+
+SharedReadings::~SharedReadings()
+{
+    if (0 != header)
+        munmap(header, SEGMENT_SIZE);
+}
+
+bool SharedReadings::open(QString name)
+{
+    void *base = MAP_FAILED;
+    int descriptor = -1;
+
+    if (-1 == (descriptor = shm_open(name.toUtf8().data(), O_RDWR | O_CREAT, 0644)))
+    {
+        LOG_ERROR("SharedReadings", "Can`t open shared memory segment!");
+        return false;
+    }
+    if (0 != ftruncate(descriptor, SEGMENT_SIZE) ||
+        MAP_FAILED == (base = mmap(0, SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0)))
+    {
+        LOG_ERROR("SharedReadings", "Can`t map shared memory segment!");
+        close(descriptor);
+        return false;
+    }
+    close(descriptor);
+
+    header = static_cast<sharedReadingsHeader_t *>(base);
+    stationSlots = reinterpret_cast<sharedStationSlot_t *>(header + 1);
+
+    // Values of previous run are not valid, readers see segment only after magic is written
+    header->magic = 0;
+    __sync_synchronize();
+    memset(stationSlots, 0, SHARED_READINGS_SLOTS * sizeof(sharedStationSlot_t));
+    header->version = SHARED_READINGS_VERSION;
+    header->slotsAmount = SHARED_READINGS_SLOTS;
+    header->slotSize = sizeof(sharedStationSlot_t);
+    header->valuesAmount = SHARED_READINGS_VALUES;
+    __sync_synchronize();
+    header->magic = SHARED_READINGS_MAGIC;
+    return true;
+}
+
+void SharedReadings::restoreValue(uint8_t slaveId, weatherStationRequestType_t type, int64_t timestamp, double value)
+{
+    sharedStationSlot_t *slot = 0;
+
+    if (0 == stationSlots || WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type)
+        return;
+
+    slot = &stationSlots[slaveId];
+    slot->sequence++;
+    __sync_synchronize();
+    slot->values[type].timestamp = timestamp;
+    slot->values[type].value = value;
+    slot->stale |= 1U << type;
+    if (slot->updated < timestamp)
+        slot->updated = timestamp;
+    __sync_synchronize();
+    slot->sequence++;
+}
+
+void SharedReadings::readingSlot(weatherReading_t reading)
+{
+    sharedStationSlot_t *slot = 0;
+
+    if (0 == stationSlots || WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type)
+        return;
+
+    slot = &stationSlots[reading.slaveId];
+    slot->sequence++;
+    __sync_synchronize();
+    slot->values[reading.type].timestamp = reading.timestamp;
+    slot->values[reading.type].value = reading.value;
+    slot->stale &= ~(1U << reading.type);
+    // Values of one response (passed by deadband filter) are marked together
+    slot->changed = (slot->response == reading.response) ? slot->changed | (1U << reading.type) : 1U << reading.type;
+    slot->response = reading.response;
+    slot->updated = reading.timestamp;
+    __sync_synchronize();
+    slot->sequence++;
+}
@@ -0,0 +1,69 @@
+#ifndef SHAREDREADINGS_H
+#define SHAREDREADINGS_H
+
+#include <QObject>
+#include <QString>
+#include "weatherstation.h"
+#include "sharedreadingslayout.h"
+
+/**
+ * @brief The SharedReadings class provide POSIX shared memory table of latest values of stations
+ *
+ * Layout is fixed: header, then one cache line aligned slot per slave id (see sharedreadingslayout.h). Writer
+ * updates slot under seqlock, so local readers get consistent snapshot without syscalls and locks (see readSnapshot).
+ */
+class SharedReadings : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief SharedReadings class constructor
+     * @param parent parent class
+     */
+    explicit SharedReadings(QObject *parent = 0);
+    ~SharedReadings();
+    /**
+     * @brief open create (or reuse) shared memory segment
+     * @param name name of segment (for ex. "/ws_readings")
+     * @return true if segment has been mapped
+     */
+    bool open(QString name);
+    /**
+     * @brief readSnapshot get consistent copy of station slot (for readers in other processes)
+     * @param base address of mapped segment
+     * @param slaveId slave id of station
+     * @param snapshot pointer to copy of slot
+     * @return false if segment has incorrect layout or slot is being written too long
+     */
+    static inline bool readSnapshot(const void *base, uint8_t slaveId, sharedStationSlot_t *snapshot)
+    {
+        return sharedReadingsSnapshot(base, slaveId, snapshot);
+    }
+
+    /**
+     * @brief restoreValue write value of previous run to slot of station, value is marked stale until reading
+     * @param slaveId slave id of station
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param timestamp time of receiving of value (ms since epoch)
+     * @param value value of measurement
+     */
+    void restoreValue(uint8_t slaveId, weatherStationRequestType_t type, int64_t timestamp, double value);
+
+public slots:
+    /**
+     * @brief readingSlot write reading to slot of station (connect directly, one writer per station)
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+
+private:
+    enum
+    {
+        SEGMENT_SIZE = sizeof(sharedReadingsHeader_t) + SHARED_READINGS_SLOTS * sizeof(sharedStationSlot_t)
+    };
+
+    sharedReadingsHeader_t *header;
+    sharedStationSlot_t *stationSlots;
+};
+
+#endif // SHAREDREADINGS_H
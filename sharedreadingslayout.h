@@ -0,0 +1,73 @@
+#ifndef SHAREDREADINGSLAYOUT_H
+#define SHAREDREADINGSLAYOUT_H
+
+#include <stdint.h>
+
+#define SHARED_READINGS_MAGIC       0x31525357  //!< Magic of segment ("WSR1")
+#define SHARED_READINGS_VERSION     2           //!< Version of layout
+#define SHARED_READINGS_SLOTS       256         //!< Amount of station slots (index is slave id)
+#define SHARED_READINGS_VALUES      16          //!< Amount of values in slot (index is weatherStationRequestType_t)
+#define SHARED_READINGS_SPIN_MAX    1000000     //!< Max attempts of reader to get consistent copy of slot
+
+//! Header of shared segment
+typedef struct _sharedReadingsHeader_t
+{
+    uint32_t magic;                             //!< Magic of segment, it is written last on creation
+    uint32_t version;                           //!< Version of layout
+    uint32_t slotsAmount;                       //!< Amount of station slots
+    uint32_t slotSize;                          //!< Size of station slot
+    uint32_t valuesAmount;                      //!< Amount of values in slot
+} __attribute__((aligned(64))) sharedReadingsHeader_t;
+
+//! Latest value of measurement
+typedef struct _sharedValue_t
+{
+    int64_t timestamp;                          //!< Time of receiving (ms since epoch), 0 - value is absent
+    double value;                               //!< Value of measurement
+} sharedValue_t;
+
+//! Slot of station (follows header, index is slave id)
+typedef struct _sharedStationSlot_t
+{
+    volatile uint32_t sequence;                 //!< Seqlock sequence: odd - slot is being written
+    uint32_t changed;                           //!< Bits of values written by last response of station (1 << index of value)
+    int64_t updated;                            //!< Time of last update (ms since epoch)
+    uint32_t stale;                             //!< Bits of values restored from previous run and not refreshed yet
+    uint32_t response;                          //!< Id of last response of station (see weatherReading_t::response)
+    sharedValue_t values[SHARED_READINGS_VALUES];   //!< Values by measurement type
+} __attribute__((aligned(64))) sharedStationSlot_t;
+
+/**
+ * @brief sharedReadingsSnapshot get consistent copy of station slot (readers include only this header)
+ * @param base address of mapped segment
+ * @param slaveId slave id of station
+ * @param snapshot pointer to copy of slot
+ * @return false if segment has incorrect layout or slot is being written too long (for ex. writer has died)
+ */
+static inline bool sharedReadingsSnapshot(const void *base, uint8_t slaveId, sharedStationSlot_t *snapshot)
+{
+    const sharedReadingsHeader_t *header = static_cast<const sharedReadingsHeader_t *>(base);
+    const sharedStationSlot_t *slot = reinterpret_cast<const sharedStationSlot_t *>(header + 1) + slaveId;
+    uint32_t sequence = 0;
+    uint32_t attempts = 0;
+    bool consistent = false;
+
+    if (SHARED_READINGS_MAGIC != header->magic || SHARED_READINGS_VERSION != header->version)
+        return false;
+    do
+    {
+        // Writer, which has died inside of update, leaves sequence odd forever
+        while (0 != ((sequence = slot->sequence) & 1))
+        {
+            if (SHARED_READINGS_SPIN_MAX <= ++attempts)
+                return false;
+        }
+        __sync_synchronize();
+        *snapshot = *slot;
+        __sync_synchronize();
+        consistent = sequence == slot->sequence;
+    } while (!consistent && SHARED_READINGS_SPIN_MAX > ++attempts);
+    return consistent;
+}
+
+#endif // SHAREDREADINGSLAYOUT_H
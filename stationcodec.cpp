@@ -0,0 +1,174 @@
+#include "stationcodec.h"
+#include "stationprofile.h"
+#include <arpa/inet.h>
+#include <math.h>
+#include <string.h>
+
+static const StationProfile builtinProfile;
+
+const StationProfile *StationCodec::profile = &builtinProfile;
+
+void StationCodec::setProfile(const StationProfile *profile)
+{
+    StationCodec::profile = (0 != profile) ? profile : &builtinProfile;
+}
+
+bool StationCodec::readRequest(weatherStationRequestType_t type, uint16_t *regAddr, uint16_t *regsAmount)
+{
+    const StationProfile::profileMeasurement_t *item = 0;
+
+    *regsAmount = 1;
+
+    switch (type)
+    {
+    case WS_RT_SLAVEID:
+        *regAddr = profile->controlRegister(StationProfile::CONTROL_SLAVE_ID);
+        return true;
+    case WS_RT_BAUDRATE:
+        *regAddr = profile->controlRegister(StationProfile::CONTROL_BAUD_RATE);
+        return true;
+    default:
+        if (0 == (item = profile->measurement(type)))
+            return false;
+        *regAddr = item->regAddr;
+        *regsAmount = item->regsAmount;
+        return true;
+    }
+}
+
+weatherStationRequestType_t StationCodec::requestTypeFromFrame(const ModBus::mbFrame_t *txFrame)
+{
+    const StationProfile::profileMeasurement_t *item = 0;
+    StationProfile::profileReadField_t fields[StationProfile::MAX_MEASUREMENTS];
+    weatherStationRequestType_t type = WS_RT_UNKNOWN;
+    uint16_t regAddr = ntohs(txFrame->readRegsReq.regAddr);
+    uint16_t regsAmount = ntohs(txFrame->readRegsReq.regsAmount);
+    int fieldsAmount = 0;
+    int i = 0;
+
+    if (ModBus::MB_READ_HOLDING_REGISTERS_FID == txFrame->hdr.fid)
+    {
+        if (profile->controlRegister(StationProfile::CONTROL_SLAVE_ID) == regAddr)
+            return WS_RT_SLAVEID;
+        if (profile->controlRegister(StationProfile::CONTROL_BAUD_RATE) == regAddr)
+            return WS_RT_BAUDRATE;
+        type = profile->typeOfRegister(regAddr);
+        if (0 == (item = profile->measurement(type)))
+            return WS_RT_UNKNOWN;
+        if (item->regsAmount == regsAmount)
+            return type;
+        if (item->regsAmount > regsAmount)
+            return WS_RT_UNKNOWN;
+        // Read of poll group starts at measurement of group and covers more registers, snapshot read covers
+        // measurements of other groups too
+        fieldsAmount = profile->readFields(regAddr, regsAmount, fields, StationProfile::MAX_MEASUREMENTS, StationProfile::SNAPSHOT_GROUP);
+        for (i = 0; i < fieldsAmount; i++)
+        {
+            if (item->group != profile->measurement(static_cast<weatherStationRequestType_t>(fields[i].type))->group)
+                return WS_RT_READSNAPSHOT;
+        }
+        return (0 != item->group) ? WS_RT_READRANGE : WS_RT_UNKNOWN;
+    }
+    else if (ModBus::MB_FORCE_SINGLE_REGISTER_FID == txFrame->hdr.fid)
+    {
+        if (profile->controlRegister(StationProfile::CONTROL_SLAVE_ID) == regAddr)
+            return WS_RT_SETSLAVEID;
+        if (profile->controlRegister(StationProfile::CONTROL_BAUD_RATE) == regAddr)
+            return WS_RT_SETBAUDRATE;
+        if (profile->controlRegister(StationProfile::CONTROL_WIND_DIRECTION_OFFSET) == regAddr)
+            return WS_RT_SETWINDDIRECTIONOFFSET;
+        if (profile->controlRegister(StationProfile::CONTROL_RESET_WIND_SPEED) == regAddr)
+            return WS_RT_RESETWINDSPEED;
+        if (profile->controlRegister(StationProfile::CONTROL_RESET_RAINFALL) == regAddr)
+            return WS_RT_RESETRAINFALL;
+    }
+    return WS_RT_UNKNOWN;
+}
+
+bool StationCodec::decodeMeasurement(weatherStationRequestType_t type, const uint16_t *regs, weatherStationRequestType_t *readingType, double *value)
+{
+    // Quality illuminance is published as illuminance
+    *readingType = (WS_RT_ILLUMINANCE_Q == type) ? WS_RT_ILLUMINANCE : type;
+    return profile->decode(type, regs, value);
+}
+
+const char *StationCodec::measurementName(weatherStationRequestType_t type)
+{
+    switch (type)
+    {
+    case WS_RT_WINDSPEED:
+        return "wind_speed";
+    case WS_RT_WINDSTRENGTH:
+        return "wind_strength";
+    case WS_RT_WINDDIRECTION:
+        return "wind_direction";
+    case WS_RT_WINDDIRECTIONGRAD:
+        return "wind_direction_grad";
+    case WS_RT_HUMIDITY:
+        return "humidity";
+    case WS_RT_TEMPERATURE:
+        return "temperature";
+    case WS_RT_NOISE:
+        return "noise";
+    case WS_RT_PM2_5:
+        return "pm2_5";
+    case WS_RT_PM10:
+        return "pm10";
+    case WS_RT_PRESSURE:
+        return "pressure";
+    case WS_RT_ILLUMINANCE_Q:
+    case WS_RT_ILLUMINANCE:
+        return "illuminance";
+    case WS_RT_RAINFALL:
+        return "rainfall";
+    default:
+        return "unknown";
+    }
+}
+
+weatherStationRequestType_t StationCodec::typeByName(const char *name, size_t length)
+{
+    const char *typeName = 0;
+    int type = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        // Quality of illuminance has the same name, name means decoded illuminance
+        typeName = measurementName(static_cast<weatherStationRequestType_t>(type));
+        if (WS_RT_ILLUMINANCE_Q != type && 0 == strncmp(name, typeName, length) && 0 == typeName[length])
+            return static_cast<weatherStationRequestType_t>(type);
+    }
+    return WS_RT_UNKNOWN;
+}
+
+double StationCodec::changeOf(weatherStationRequestType_t type, double previous, double value)
+{
+    double change = fabs(value - previous);
+
+    // Direction changes by shortest way around circle
+    if (WS_RT_WINDDIRECTIONGRAD == type && 180 < change)
+        change = 360 - change;
+    else if (WS_RT_WINDDIRECTION == type && 4 < change)
+        change = 8 - change;
+    return change;
+}
+
+const char *StationCodec::windDirectionName(uint16_t sector)
+{
+    return profile->label(WS_RT_WINDDIRECTION, sector);
+}
+
+uint16_t StationCodec::baudRateValue(uint16_t code)
+{
+    switch (code)
+    {
+    case 0:
+        return 2400;
+    case 1:
+        return 4800;
+    case 2:
+        return 9600;
+    default:
+        return 0;
+    }
+}
@@ -0,0 +1,118 @@
+#ifndef STATIONCODEC_H
+#define STATIONCODEC_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "modbus.h"
+
+typedef enum _weatherStationRequestType_t
+{
+    WS_RT_UNKNOWN = 0,                  //! Unknown request type (no request)
+    WS_RT_SLAVEID,                      //! Request current slave id
+    WS_RT_BAUDRATE,                     //! Request current baud rate
+    WS_RT_WINDSPEED,                    //! Request wind speed
+    WS_RT_WINDSTRENGTH,                 //! Request wind strength
+    WS_RT_WINDDIRECTION,                //! Request wind direction (cardinal directions)
+    WS_RT_WINDDIRECTIONGRAD,            //! Request wind direction in grad
+    WS_RT_HUMIDITY,                     //! Request humidity
+    WS_RT_TEMPERATURE,                  //! Request temperature
+    WS_RT_NOISE,                        //! Request level of noise
+    WS_RT_PM2_5,                        //! Request pm 2.5
+    WS_RT_PM10,                         //! Request pm 10
+    WS_RT_PRESSURE,                     //! Request atmosphere pressure
+    WS_RT_ILLUMINANCE_Q,                //! Request quality illuminance
+    WS_RT_ILLUMINANCE,                  //! Request illuminance
+    WS_RT_RAINFALL,                     //! Request level of rainfall
+    WS_RT_SETSLAVEID,                   //! Request set new slave id
+    WS_RT_SETBAUDRATE,                  //! Request set baud rate
+    WS_RT_SETWINDDIRECTIONOFFSET,       //! Request set wind direction offset
+    WS_RT_RESETWINDSPEED,               //! Request reset zero value of wind speed
+    WS_RT_RESETRAINFALL,                //! Request reset of rainfall level
+    WS_RT_READRANGE,                    //! Request read of registers of poll group (see StationProfile)
+    WS_RT_READSNAPSHOT                  //! Request read of registers of all measurements (see StationProfile::SNAPSHOT_GROUP)
+} weatherStationRequestType_t;
+
+class StationProfile;
+
+/**
+ * @brief The StationCodec class provide register map and decoding of measurements of weather station
+ *
+ * Class does not depend on Qt, it is used by WeatherStation and by Qt-free programs.
+ * Registers and scales are taken from active station profile (see StationProfile).
+ */
+class StationCodec
+{
+public:
+    /**
+     * @brief setProfile set active station profile (must be called at startup, before requests)
+     * @param profile pointer to profile (0 - built-in profile of CWT-UWD)
+     */
+    static void setProfile(const StationProfile *profile);
+    /**
+     * @brief getProfile get active station profile
+     * @return pointer to profile
+     */
+    static inline const StationProfile *getProfile() { return profile; }
+    /**
+     * @brief readRequest get registers of measurement
+     * @param type measurement type (WS_RT_SLAVEID - WS_RT_RAINFALL)
+     * @param regAddr pointer for address of first register
+     * @param regsAmount pointer for amount of registers
+     * @return false if type is not readable
+     */
+    static bool readRequest(weatherStationRequestType_t type, uint16_t *regAddr, uint16_t *regsAmount);
+    /**
+     * @brief requestTypeFromFrame get request type by request frame
+     * @param txFrame pointer to request frame (in network byte order)
+     * @return request type (WS_RT_READRANGE for read of poll group, WS_RT_READSNAPSHOT for read, which covers measurements
+     *         of several groups, WS_RT_UNKNOWN if frame is not a request to weather station)
+     */
+    static weatherStationRequestType_t requestTypeFromFrame(const ModBus::mbFrame_t *txFrame);
+    /**
+     * @brief decodeMeasurement decode registers of measurement
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param regs registers of response (host byte order)
+     * @param readingType pointer for type of reading (WS_RT_ILLUMINANCE for WS_RT_ILLUMINANCE_Q)
+     * @param value pointer for value in units of measurement (number of sector for wind direction)
+     * @return false if type is not a measurement
+     */
+    static bool decodeMeasurement(weatherStationRequestType_t type, const uint16_t *regs, weatherStationRequestType_t *readingType, double *value);
+    /**
+     * @brief measurementName get short name of measurement
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @return name of measurement (for ex. "wind_speed")
+     */
+    static const char *measurementName(weatherStationRequestType_t type);
+    /**
+     * @brief typeByName get measurement type by short name
+     * @param name name of measurement (for ex. "wind_speed", not terminated)
+     * @param length length of name
+     * @return measurement type (WS_RT_ILLUMINANCE for "illuminance"), WS_RT_UNKNOWN for unknown name
+     */
+    static weatherStationRequestType_t typeByName(const char *name, size_t length);
+    /**
+     * @brief changeOf get absolute change of value of measurement
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @param previous previous value
+     * @param value new value
+     * @return change (wind direction changes by shortest way around circle)
+     */
+    static double changeOf(weatherStationRequestType_t type, double previous, double value);
+    /**
+     * @brief windDirectionName get name of cardinal direction
+     * @param sector number of sector (label of profile, for CWT-UWD 0 - North, 1 - Northeast, ..., 7 - Northwest)
+     * @return name of direction ("Unknown" for incorrect sector)
+     */
+    static const char *windDirectionName(uint16_t sector);
+    /**
+     * @brief baudRateValue get baud rate by code of station
+     * @param code code of baud rate (0 - 2400, 1 - 4800, 2 - 9600)
+     * @return baud rate, 0 for incorrect code
+     */
+    static uint16_t baudRateValue(uint16_t code);
+
+private:
+    static const StationProfile *profile;
+};
+
+#endif // STATIONCODEC_H
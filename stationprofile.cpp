@@ -0,0 +1,492 @@
+#include "stationprofile.h"
+#include "logger.h"
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#define PROFILE_LINE_SIZE       256         // Max length of line of profile file
+#define PROFILE_SECTION_STATION 0           // Index of section [station] (measurement sections are indexed by request type)
+
+/**
+ * @brief trim remove leading and trailing spaces
+ * @param text text (changed in place)
+ * @return pointer to first not space character
+ */
+static char *trim(char *text)
+{
+    char *end = 0;
+
+    while (isspace(static_cast<unsigned char>(*text)))
+        text++;
+    end = text + strlen(text);
+    while (end > text && isspace(static_cast<unsigned char>(end[-1])))
+        end--;
+    *end = 0;
+    return text;
+}
+
+/**
+ * @brief parseNumber parse integer (decimal or hexadecimal with 0x)
+ * @param text text of number
+ * @param min min value
+ * @param max max value
+ * @param value pointer for value
+ * @return false if text is not a number in range
+ */
+static bool parseNumber(const char *text, long min, long max, long *value)
+{
+    char *end = 0;
+
+    *value = strtol(text, &end, 0);
+    return (end != text && 0 == *end && min <= *value && max >= *value);
+}
+
+StationProfile::StationProfile()
+{
+    static const char *directions[] = { "North", "Northeast", "East", "Southeast", "South", "Southwest", "West", "Northwest" };
+    static const struct
+    {
+        uint8_t type;
+        uint16_t regAddr;
+        uint8_t dataType;
+        double scale;
+        uint8_t group;
+    } builtin[] = {
+        { WS_RT_WINDSPEED,          0x01F4, TYPE_U16,  0.01,  1 },
+        { WS_RT_WINDSTRENGTH,       0x01F5, TYPE_U16,  1.0,   1 },
+        { WS_RT_WINDDIRECTION,      0x01F6, TYPE_ENUM, 1.0,   1 },
+        { WS_RT_WINDDIRECTIONGRAD,  0x01F7, TYPE_U16,  1.0,   1 },
+        { WS_RT_HUMIDITY,           0x01F8, TYPE_U16,  0.1,   2 },
+        { WS_RT_TEMPERATURE,        0x01F9, TYPE_S16,  0.1,   2 },
+        { WS_RT_NOISE,              0x01FA, TYPE_U16,  0.1,   2 },
+        { WS_RT_PM2_5,              0x01FB, TYPE_U16,  1.0,   2 },
+        { WS_RT_PM10,               0x01FC, TYPE_U16,  1.0,   2 },
+        { WS_RT_PRESSURE,           0x01FD, TYPE_U16,  0.1,   2 },
+        { WS_RT_ILLUMINANCE_Q,      0x01FE, TYPE_U32,  1.0,   0 },
+        { WS_RT_ILLUMINANCE,        0x0200, TYPE_U16,  100.0, 2 },
+        { WS_RT_RAINFALL,           0x0201, TYPE_U16,  0.1,   2 }
+    };
+    profileMeasurement_t *item = 0;
+    unsigned int i = 0;
+
+    memset(measurements, 0, sizeof(measurements));
+    strcpy(name, "CWT-UWD");
+    controls[CONTROL_SLAVE_ID] = 0x07D0;
+    controls[CONTROL_BAUD_RATE] = 0x07D1;
+    controls[CONTROL_WIND_DIRECTION_OFFSET] = 0x6000;
+    controls[CONTROL_RESET_WIND_SPEED] = 0x6001;
+    controls[CONTROL_RESET_RAINFALL] = 0x6002;
+    // All registers of CWT-UWD between measurements are readable
+    maxGap = ModBus::MB_READ_REGS_MAX;
+
+    for (i = 0; i < sizeof(builtin) / sizeof(builtin[0]); i++)
+    {
+        item = &measurements[builtin[i].type];
+        item->present = true;
+        item->regAddr = builtin[i].regAddr;
+        item->dataType = builtin[i].dataType;
+        item->regsAmount = (TYPE_U32 == builtin[i].dataType) ? 2 : 1;
+        item->scale = builtin[i].scale;
+        item->offset = 0.0;
+        item->group = builtin[i].group;
+    }
+    item = &measurements[WS_RT_WINDDIRECTION];
+    for (i = 0; i < sizeof(directions) / sizeof(directions[0]); i++)
+        strcpy(item->labels[i], directions[i]);
+    item->labelsAmount = sizeof(directions) / sizeof(directions[0]);
+
+    compile();
+}
+
+bool StationProfile::load(const char *fileName)
+{
+    StationProfile *profile = new StationProfile();
+    FILE *file = 0;
+    bool result = false;
+
+    if (0 == (file = fopen(fileName, "r")))
+    {
+        LOG_ERROR("StationProfile", "Can`t open profile %s!", fileName);
+        delete profile;
+        return false;
+    }
+
+    // Measurements of loaded profile are only measurements of file, gaps are read only when file allows them
+    memset(profile->measurements, 0, sizeof(profile->measurements));
+    profile->maxGap = 0;
+    if (profile->parse(file, fileName) && profile->validate(fileName))
+    {
+        profile->compile();
+        *this = *profile;
+        LOG_INFO("StationProfile", "Profile %s: %d measurements, max gap of read %u", name, registersAmount, maxGap);
+        result = true;
+    }
+    fclose(file);
+    delete profile;
+    return result;
+}
+
+bool StationProfile::parse(FILE *file, const char *fileName)
+{
+    char buffer[PROFILE_LINE_SIZE];
+    char *line = 0;
+    char *value = 0;
+    int section = -1;
+    int lineNumber = 0;
+    int type = 0;
+
+    while (0 != fgets(buffer, sizeof(buffer), file))
+    {
+        lineNumber++;
+        line = trim(buffer);
+        if (0 == *line || '#' == *line || ';' == *line)
+            continue;
+
+        if ('[' == *line)
+        {
+            if (']' != line[strlen(line) - 1])
+            {
+                LOG_ERROR("StationProfile", "%s:%d: incorrect section", fileName, lineNumber);
+                return false;
+            }
+            line[strlen(line) - 1] = 0;
+            line = trim(line + 1);
+            section = -1;
+            if (0 == strcmp(line, "station"))
+                section = PROFILE_SECTION_STATION;
+            for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL && -1 == section; type++)
+            {
+                if (0 == strcmp(line, sectionName(static_cast<weatherStationRequestType_t>(type))))
+                    section = type;
+            }
+            if (-1 == section)
+            {
+                LOG_ERROR("StationProfile", "%s:%d: unknown section [%s]", fileName, lineNumber, line);
+                return false;
+            }
+            if (PROFILE_SECTION_STATION != section)
+            {
+                measurements[section].present = true;
+                measurements[section].scale = 1.0;
+                measurements[section].dataType = TYPE_U16;
+            }
+            continue;
+        }
+
+        if (0 == (value = strchr(line, '=')) || -1 == section)
+        {
+            LOG_ERROR("StationProfile", "%s:%d: expected key = value in section", fileName, lineNumber);
+            return false;
+        }
+        *value = 0;
+        if (!setKey(section, trim(line), trim(value + 1)))
+        {
+            LOG_ERROR("StationProfile", "%s:%d: incorrect key or value of %s", fileName, lineNumber, trim(line));
+            return false;
+        }
+    }
+    return true;
+}
+
+bool StationProfile::setKey(int section, const char *key, const char *value)
+{
+    static const char *controlKeys[CONTROL_AMOUNT] = { "slave_id", "baud_rate", "wind_direction_offset", "reset_wind_speed", "reset_rainfall" };
+    profileMeasurement_t *item = &measurements[section];
+    const char *end = 0;
+    char *number = 0;
+    long result = 0;
+    int i = 0;
+
+    if (PROFILE_SECTION_STATION == section)
+    {
+        if (0 == strcmp(key, "name"))
+        {
+            if (NAME_SIZE <= strlen(value))
+                return false;
+            strcpy(name, value);
+            return true;
+        }
+        if (0 == strcmp(key, "max_gap") && parseNumber(value, 0, ModBus::MB_READ_REGS_MAX, &result))
+        {
+            maxGap = static_cast<uint16_t>(result);
+            return true;
+        }
+        for (i = 0; i < CONTROL_AMOUNT; i++)
+        {
+            if (0 == strcmp(key, controlKeys[i]) && parseNumber(value, 0, 0xFFFF, &result))
+            {
+                controls[i] = static_cast<uint16_t>(result);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    if (0 == strcmp(key, "register") && parseNumber(value, 0, 0xFFFF, &result))
+        item->regAddr = static_cast<uint16_t>(result);
+    else if (0 == strcmp(key, "count") && parseNumber(value, 1, 2, &result))
+        item->regsAmount = static_cast<uint8_t>(result);
+    else if (0 == strcmp(key, "group") && parseNumber(value, 0, MAX_GROUPS - 1, &result))
+        item->group = static_cast<uint8_t>(result);
+    else if (0 == strcmp(key, "type"))
+    {
+        if (0 == strcmp(value, "u16"))
+            item->dataType = TYPE_U16;
+        else if (0 == strcmp(value, "s16"))
+            item->dataType = TYPE_S16;
+        else if (0 == strcmp(value, "u32"))
+            item->dataType = TYPE_U32;
+        else if (0 == strcmp(value, "enum"))
+            item->dataType = TYPE_ENUM;
+        else
+            return false;
+    }
+    else if (0 == strcmp(key, "scale") || 0 == strcmp(key, "offset"))
+    {
+        (('s' == key[0]) ? item->scale : item->offset) = strtod(value, &number);
+        return (number != value && 0 == *number);
+    }
+    else if (0 == strcmp(key, "labels"))
+    {
+        // Labels are separated by commas
+        item->labelsAmount = 0;
+        while (0 != *value)
+        {
+            end = strchr(value, ',');
+            if (0 == end)
+                end = value + strlen(value);
+            while (value < end && isspace(static_cast<unsigned char>(*value)))
+                value++;
+            i = end - value;
+            while (0 < i && isspace(static_cast<unsigned char>(value[i - 1])))
+                i--;
+            if (MAX_LABELS <= item->labelsAmount || LABEL_SIZE <= i || 0 == i)
+                return false;
+            memcpy(item->labels[item->labelsAmount], value, i);
+            item->labels[item->labelsAmount][i] = 0;
+            item->labelsAmount++;
+            value = (0 != *end) ? end + 1 : end;
+        }
+    }
+    else
+        return false;
+    return true;
+}
+
+bool StationProfile::validate(const char *fileName)
+{
+    profileMeasurement_t *item = 0;
+    profileMeasurement_t *other = 0;
+    int type = 0;
+    int otherType = 0;
+    int count = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        item = &measurements[type];
+        if (!item->present)
+            continue;
+        count++;
+
+        if (0 == item->regsAmount)
+            item->regsAmount = (TYPE_U32 == item->dataType) ? 2 : 1;
+        if ((TYPE_U32 == item->dataType) != (2 == item->regsAmount))
+        {
+            LOG_ERROR("StationProfile", "%s: [%s] count does not match type", fileName, sectionName(static_cast<weatherStationRequestType_t>(type)));
+            return false;
+        }
+        if (0xFFFF < item->regAddr + item->regsAmount - 1)
+        {
+            LOG_ERROR("StationProfile", "%s: [%s] register is out of range", fileName, sectionName(static_cast<weatherStationRequestType_t>(type)));
+            return false;
+        }
+        if ((TYPE_ENUM == item->dataType) != (0 != item->labelsAmount))
+        {
+            LOG_ERROR("StationProfile", "%s: [%s] labels are allowed and required for enum only", fileName, sectionName(static_cast<weatherStationRequestType_t>(type)));
+            return false;
+        }
+        if (WS_RT_WINDDIRECTION == type && TYPE_ENUM != item->dataType)
+        {
+            LOG_ERROR("StationProfile", "%s: [%s] must be enum", fileName, sectionName(static_cast<weatherStationRequestType_t>(type)));
+            return false;
+        }
+
+        // Every register belongs to one measurement
+        for (otherType = WS_RT_WINDSPEED; otherType < type; otherType++)
+        {
+            other = &measurements[otherType];
+            if (other->present && item->regAddr < other->regAddr + other->regsAmount && other->regAddr < item->regAddr + item->regsAmount)
+            {
+                LOG_ERROR("StationProfile", "%s: registers of [%s] and [%s] overlap", fileName,
+                          sectionName(static_cast<weatherStationRequestType_t>(otherType)), sectionName(static_cast<weatherStationRequestType_t>(type)));
+                return false;
+            }
+        }
+    }
+
+    if (0 == count)
+    {
+        LOG_ERROR("StationProfile", "%s: profile has not measurements", fileName);
+        return false;
+    }
+    return true;
+}
+
+void StationProfile::compile()
+{
+    profileRegister_t temp;
+    int type = 0;
+    int i = 0;
+    int j = 0;
+
+    // Registers are sorted by address for lookup of measurement by request
+    registersAmount = 0;
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        if (!measurements[type].present)
+            continue;
+        registers[registersAmount].regAddr = measurements[type].regAddr;
+        registers[registersAmount].type = static_cast<uint8_t>(type);
+        registersAmount++;
+    }
+    for (i = 1; i < registersAmount; i++)
+    {
+        for (j = i; 0 < j && registers[j - 1].regAddr > registers[j].regAddr; j--)
+        {
+            temp = registers[j];
+            registers[j] = registers[j - 1];
+            registers[j - 1] = temp;
+        }
+    }
+}
+
+const StationProfile::profileMeasurement_t *StationProfile::measurement(weatherStationRequestType_t type) const
+{
+    if (WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type || !measurements[type].present)
+        return 0;
+    return &measurements[type];
+}
+
+weatherStationRequestType_t StationProfile::typeOfRegister(uint16_t regAddr) const
+{
+    int index = findRegister(regAddr);
+
+    if (index >= registersAmount || registers[index].regAddr != regAddr)
+        return WS_RT_UNKNOWN;
+    return static_cast<weatherStationRequestType_t>(registers[index].type);
+}
+
+int StationProfile::findRegister(uint16_t regAddr) const
+{
+    int low = 0;
+    int high = registersAmount;
+    int middle = 0;
+
+    // Index of first measurement, which starts at register or after it
+    while (low < high)
+    {
+        middle = (low + high) / 2;
+        if (registers[middle].regAddr < regAddr)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+bool StationProfile::decode(weatherStationRequestType_t type, const uint16_t *regs, double *value) const
+{
+    const profileMeasurement_t *item = measurement(type);
+
+    if (0 == item)
+        return false;
+
+    switch (item->dataType)
+    {
+    case TYPE_S16:
+        *value = static_cast<int16_t>(regs[0]) * item->scale + item->offset;
+        break;
+    case TYPE_U32:
+        *value = ((static_cast<uint32_t>(regs[0]) << 16) | regs[1]) * item->scale + item->offset;
+        break;
+    case TYPE_ENUM:
+        *value = regs[0];
+        break;
+    case TYPE_U16:
+    default:
+        *value = regs[0] * item->scale + item->offset;
+        break;
+    }
+    return true;
+}
+
+const char *StationProfile::label(weatherStationRequestType_t type, uint16_t index) const
+{
+    const profileMeasurement_t *item = measurement(type);
+
+    if (0 == item || index >= item->labelsAmount)
+        return "Unknown";
+    return item->labels[index];
+}
+
+int StationProfile::groupRegisters(uint8_t group, uint16_t *regs, int maxRegs) const
+{
+    const profileMeasurement_t *item = 0;
+    int amount = 0;
+    int i = 0;
+    int j = 0;
+
+    if (0 == group || (MAX_GROUPS <= group && SNAPSHOT_GROUP != group))
+        return 0;
+    for (i = 0; i < registersAmount; i++)
+    {
+        item = &measurements[registers[i].type];
+        if (!inGroup(registers[i].type, group))
+            continue;
+        for (j = 0; j < item->regsAmount && amount < maxRegs; j++)
+            regs[amount++] = item->regAddr + j;
+    }
+    return amount;
+}
+
+int StationProfile::readFields(uint16_t regAddr, uint16_t regsAmount, profileReadField_t *fields, int maxFields, uint8_t group) const
+{
+    const profileMeasurement_t *item = 0;
+    int amount = 0;
+    int i = findRegister(regAddr);
+
+    if (i >= registersAmount || registers[i].regAddr != regAddr)
+        return 0;
+    if (0 == group && 0 == (group = measurements[registers[i].type].group))
+        return 0;
+    for (; i < registersAmount && amount < maxFields; i++)
+    {
+        item = &measurements[registers[i].type];
+        if (item->regAddr + item->regsAmount > regAddr + regsAmount)
+            break;
+        if (!inGroup(registers[i].type, group))
+            continue;
+        fields[amount].type = registers[i].type;
+        fields[amount].regOffset = static_cast<uint8_t>(item->regAddr - regAddr);
+        amount++;
+    }
+    return amount;
+}
+
+bool StationProfile::inGroup(uint8_t type, uint8_t group) const
+{
+    // Quality illuminance duplicates illuminance, so snapshot does not read it
+    if (SNAPSHOT_GROUP == group)
+        return WS_RT_ILLUMINANCE_Q != type;
+    return group == measurements[type].group;
+}
+
+const char *StationProfile::sectionName(weatherStationRequestType_t type)
+{
+    // Quality illuminance has own section, reading of it is published as illuminance
+    if (WS_RT_ILLUMINANCE_Q == type)
+        return "illuminance_q";
+    if (WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type)
+        return 0;
+    return StationCodec::measurementName(type);
+}
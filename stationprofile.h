@@ -0,0 +1,185 @@
+#ifndef STATIONPROFILE_H
+#define STATIONPROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "modbus.h"
+#include "stationcodec.h"
+
+/**
+ * @brief The StationProfile class provide register map of station model, compiled into lookup tables
+ *
+ * Profile is loaded from text file once at startup (see load), validated and compiled into flat table
+ * of measurements by request type and sorted table of registers, so decoding does not depend on source
+ * of profile. Registers of poll group are read by requests of read planner of master (see groupRegisters),
+ * measurements of read are found by its window (see readFields). Default profile is built-in map of CWT-UWD.
+ * Profile file consists of sections of measurements (for ex. [wind_speed]) and section [station]:
+ *
+ *     [station]
+ *     name = CWT-UWD
+ *     slave_id = 0x07D0
+ *     max_gap = 125
+ *     [temperature]
+ *     register = 0x01F9
+ *     type = s16
+ *     scale = 0.1
+ *     group = 1
+ */
+class StationProfile
+{
+public:
+    enum DataType
+    {
+        TYPE_U16 = 0,                                   //!< Unsigned register
+        TYPE_S16,                                       //!< Signed register
+        TYPE_U32,                                       //!< Unsigned value of two registers (high register first)
+        TYPE_ENUM                                       //!< Index of label
+    };
+
+    enum ControlRegister
+    {
+        CONTROL_SLAVE_ID = 0,                           //!< Register of slave id
+        CONTROL_BAUD_RATE,                              //!< Register of baud rate
+        CONTROL_WIND_DIRECTION_OFFSET,                  //!< Register of wind direction offset
+        CONTROL_RESET_WIND_SPEED,                       //!< Register of reset of wind speed zero
+        CONTROL_RESET_RAINFALL,                         //!< Register of reset of rainfall
+        CONTROL_AMOUNT
+    };
+
+    enum
+    {
+        NAME_SIZE = 32,                                 //!< Max size of profile name
+        MAX_LABELS = 16,                                //!< Max amount of labels of enumeration
+        LABEL_SIZE = 16,                                //!< Max size of label
+        MAX_GROUPS = 16,                                //!< Amount of poll groups (group 0 is not polled by group)
+        SNAPSHOT_GROUP = 0xFF,                          //!< Pseudo group of all measurements, which are published as readings
+        MAX_MEASUREMENTS = 24                           //!< Size of measurement table (greater than last request type)
+    };
+
+    //! Compiled measurement
+    typedef struct _profileMeasurement_t
+    {
+        bool present;                                   //!< Measurement is supported by station
+        uint8_t dataType;                               //!< Type of value (see StationProfile::DataType)
+        uint8_t regsAmount;                             //!< Amount of registers
+        uint8_t group;                                  //!< Poll group (0 - without group)
+        uint16_t regAddr;                               //!< Address of first register
+        uint8_t labelsAmount;                           //!< Amount of labels of enumeration
+        double scale;                                   //!< Value = raw * scale + offset
+        double offset;                                  //!< Value = raw * scale + offset
+        char labels[MAX_LABELS][LABEL_SIZE];            //!< Labels of enumeration
+    } profileMeasurement_t;
+
+    //! Measurement in read of poll group
+    typedef struct _profileReadField_t
+    {
+        uint8_t type;                                   //!< Request type of measurement (see weatherStationRequestType_t)
+        uint8_t regOffset;                              //!< Offset of first register of measurement in read
+    } profileReadField_t;
+
+    /**
+     * @brief StationProfile class constructor (built-in profile of CWT-UWD)
+     */
+    StationProfile();
+    /**
+     * @brief load load, validate and compile profile file (profile is not changed on error)
+     * @param fileName path to profile file
+     * @return false on syntax or validation error (reason is logged with line number)
+     */
+    bool load(const char *fileName);
+    /**
+     * @brief getName get name of station model
+     * @return name of model
+     */
+    inline const char *getName() const { return name; }
+    /**
+     * @brief getMaxGap get max amount of registers out of measurements, which may be read between measurements
+     * @return amount of registers (0 - station answers exception on read of registers out of map)
+     */
+    inline uint16_t getMaxGap() const { return maxGap; }
+    /**
+     * @brief measurement get compiled measurement
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @return pointer to measurement, 0 if type is not a measurement or is not supported by station
+     */
+    const profileMeasurement_t *measurement(weatherStationRequestType_t type) const;
+    /**
+     * @brief controlRegister get address of control register
+     * @param control control register (see StationProfile::ControlRegister)
+     * @return address of register
+     */
+    inline uint16_t controlRegister(ControlRegister control) const { return controls[control]; }
+    /**
+     * @brief typeOfRegister find measurement, which starts at register
+     * @param regAddr address of register
+     * @return measurement type, WS_RT_UNKNOWN if there is not such measurement
+     */
+    weatherStationRequestType_t typeOfRegister(uint16_t regAddr) const;
+    /**
+     * @brief decode decode registers of measurement
+     * @param type measurement type
+     * @param regs registers (host byte order)
+     * @param value pointer for value (index of label for enumeration)
+     * @return false if measurement is not supported
+     */
+    bool decode(weatherStationRequestType_t type, const uint16_t *regs, double *value) const;
+    /**
+     * @brief label get label of enumeration
+     * @param type measurement type
+     * @param index index of label
+     * @return label, "Unknown" for incorrect index
+     */
+    const char *label(weatherStationRequestType_t type, uint16_t index) const;
+    /**
+     * @brief groupRegisters get registers of measurements of poll group
+     * @param group poll group (1 - MAX_GROUPS-1 or SNAPSHOT_GROUP)
+     * @param regs array for addresses of registers (sorted)
+     * @param maxRegs size of array
+     * @return amount of registers (0 if group is empty)
+     */
+    int groupRegisters(uint8_t group, uint16_t *regs, int maxRegs) const;
+    /**
+     * @brief readFields get measurements of read of poll group
+     *
+     * Read of poll group starts at measurement of group, so group is taken from first measurement,
+     * when it is not given. Measurements of other groups in gaps of read are skipped.
+     * @param regAddr address of first register of read
+     * @param regsAmount amount of registers of read
+     * @param fields array for measurements (sorted by address)
+     * @param maxFields size of array
+     * @param group poll group of read (0 - group of first measurement, SNAPSHOT_GROUP - all measurements)
+     * @return amount of measurements, 0 if read does not start at measurement of poll group
+     */
+    int readFields(uint16_t regAddr, uint16_t regsAmount, profileReadField_t *fields, int maxFields, uint8_t group = 0) const;
+    /**
+     * @brief sectionName get name of profile section of measurement
+     * @param type measurement type
+     * @return name of section, 0 if type is not a measurement
+     */
+    static const char *sectionName(weatherStationRequestType_t type);
+
+private:
+    //! Register, which starts measurement (sorted by address)
+    typedef struct _profileRegister_t
+    {
+        uint16_t regAddr;
+        uint8_t type;
+    } profileRegister_t;
+
+    bool parse(FILE *file, const char *fileName);
+    bool setKey(int section, const char *key, const char *value);
+    bool validate(const char *fileName);
+    void compile();
+
+    int findRegister(uint16_t regAddr) const;
+    bool inGroup(uint8_t type, uint8_t group) const;
+
+    char name[NAME_SIZE];
+    uint16_t controls[CONTROL_AMOUNT];
+    uint16_t maxGap;
+    profileMeasurement_t measurements[MAX_MEASUREMENTS];
+    profileRegister_t registers[MAX_MEASUREMENTS];
+    int registersAmount;
+};
+
+#endif // STATIONPROFILE_H
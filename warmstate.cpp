@@ -0,0 +1,98 @@
+#include "warmstate.h"
+#include "logger.h"
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+WarmState::WarmState(QObject *parent) :
+    QObject(parent)
+{
+    state = 0;
+    modbusMaster = 0;
+}
+
+WarmState::~WarmState()
+{
+    if (0 != state)
+    {
+        msync(state, sizeof(warmStateFile_t), MS_SYNC);
+        munmap(state, sizeof(warmStateFile_t));
+    }
+}
+
+bool WarmState::open(const char *fileName)
+{
+    void *base = MAP_FAILED;
+    int descriptor = -1;
+
+    if (-1 == (descriptor = ::open(fileName, O_RDWR | O_CREAT | O_CLOEXEC, 0644)))
+    {
+        LOG_ERROR("WarmState", "Can`t open state file %s!", fileName);
+        return false;
+    }
+    if (0 != ftruncate(descriptor, sizeof(warmStateFile_t)) ||
+        MAP_FAILED == (base = mmap(0, sizeof(warmStateFile_t), PROT_READ | PROT_WRITE, MAP_SHARED, descriptor, 0)))
+    {
+        LOG_ERROR("WarmState", "Can`t map state file %s!", fileName);
+        close(descriptor);
+        return false;
+    }
+    close(descriptor);
+
+    state = static_cast<warmStateFile_t *>(base);
+    if (WARM_STATE_MAGIC != state->magic || WARM_STATE_VERSION != state->version || 0 != state->device[WARM_STATE_DEVICE_SIZE - 1])
+    {
+        // New file is zero filled, file of other layout is not used
+        memset(state, 0, sizeof(warmStateFile_t));
+        state->slaveId = 0xFF;
+        state->version = WARM_STATE_VERSION;
+        state->magic = WARM_STATE_MAGIC;
+    }
+    return true;
+}
+
+bool WarmState::isKnown()
+{
+    return 0 != state && 0 != state->device[0] && 0xFF != state->slaveId && 0 != state->slaveId && ModBus::BR_9600 >= state->baudRate;
+}
+
+bool WarmState::getValue(weatherStationRequestType_t type, warmValue_t *value)
+{
+    if (0 == state || WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type || 0 == state->values[type].timestamp)
+        return false;
+    *value = state->values[type];
+    return true;
+}
+
+void WarmState::setBus(const char *device, ModBus::BaudRate br)
+{
+    if (0 == state || (0 == strncmp(state->device, device, WARM_STATE_DEVICE_SIZE) && br == state->baudRate))
+        return;
+
+    // Station and timing of other bus are not valid
+    memset(state->device, 0, sizeof(state->device));
+    strncpy(state->device, device, WARM_STATE_DEVICE_SIZE - 1);
+    state->baudRate = static_cast<uint8_t>(br);
+    state->transactionOverhead = 0;
+    setSlaveId(0xFF);
+}
+
+void WarmState::setSlaveId(uint8_t slaveId)
+{
+    if (0 == state || slaveId == state->slaveId)
+        return;
+    state->slaveId = slaveId;
+    memset(state->values, 0, sizeof(state->values));
+}
+
+void WarmState::readingSlot(weatherReading_t reading)
+{
+    if (0 == state || WS_RT_WINDSPEED > reading.type || WS_RT_RAINFALL < reading.type || reading.slaveId != state->slaveId)
+        return;
+
+    state->values[reading.type].value = reading.value;
+    state->values[reading.type].timestamp = reading.timestamp;
+    if (0 != modbusMaster)
+        state->transactionOverhead = modbusMaster->getTransactionOverhead();
+}
@@ -0,0 +1,117 @@
+#ifndef WARMSTATE_H
+#define WARMSTATE_H
+
+#include <QObject>
+#include "weatherstation.h"
+
+#define WARM_STATE_MAGIC            0x31535357  //!< Magic of state file ("WSS1")
+#define WARM_STATE_VERSION          1           //!< Version of layout
+#define WARM_STATE_DEVICE_SIZE      64          //!< Max size of path to serial port device
+
+//! Last value of measurement
+typedef struct _warmValue_t
+{
+    int64_t timestamp;                          //!< Time of receiving (ms since epoch), 0 - value is absent
+    double value;                               //!< Value of measurement
+} warmValue_t;
+
+//! Layout of state file
+typedef struct _warmStateFile_t
+{
+    uint32_t magic;                             //!< Magic of file
+    uint32_t version;                           //!< Version of layout
+    char device[WARM_STATE_DEVICE_SIZE];        //!< Path to serial port device, empty - bus is not known
+    uint8_t baudRate;                           //!< Baud rate of bus (see ModBus::BaudRate)
+    uint8_t slaveId;                            //!< Slave id of station, 0xFF - not known
+    uint16_t reserved;
+    uint32_t reserved2;
+    uint64_t transactionOverhead;               //!< Measured overhead of transaction (ns, see RtuEngine::getTransactionOverhead)
+    warmValue_t values[WS_RT_RAINFALL + 1];     //!< Last values by measurement type
+} warmStateFile_t;
+
+/**
+ * @brief The WarmState class provide state file of bus, station and last values for fast restart
+ *
+ * File is mapped into memory, so state is updated by stores without syscalls and survives crash of process
+ * (pages are written back by kernel). On start bus and slave id are taken from file without questions and
+ * probe of station, measured overhead of transactions is used until new measurement and last values are
+ * served as stale until refresh.
+ */
+class WarmState : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief WarmState class constructor
+     * @param parent parent class
+     */
+    explicit WarmState(QObject *parent = 0);
+    ~WarmState();
+    /**
+     * @brief open map state file (file with incorrect layout is cleared)
+     * @param fileName path to state file
+     * @return true if file has been mapped
+     */
+    bool open(const char *fileName);
+    /**
+     * @brief isKnown check that bus and station of previous run are known
+     * @return true if device, baud rate and slave id are stored
+     */
+    bool isKnown();
+    /**
+     * @brief getDevice get path to serial port device of previous run
+     * @return path to device (empty if it is not known)
+     */
+    inline const char *getDevice() { return (0 != state) ? state->device : ""; }
+    /**
+     * @brief getBaudRate get baud rate of previous run
+     * @return baud rate (see ModBus::BaudRate)
+     */
+    inline ModBus::BaudRate getBaudRate() { return (0 != state) ? static_cast<ModBus::BaudRate>(state->baudRate) : ModBus::BR_9600; }
+    /**
+     * @brief getSlaveId get slave id of station of previous run
+     * @return slave id (0xFF if it is not known)
+     */
+    inline uint8_t getSlaveId() { return (0 != state) ? state->slaveId : 0xFF; }
+    /**
+     * @brief getTransactionOverhead get overhead of transaction measured by previous run
+     * @return overhead (ns), 0 if it is not known
+     */
+    inline uint64_t getTransactionOverhead() { return (0 != state) ? state->transactionOverhead : 0; }
+    /**
+     * @brief getValue get last value of measurement
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param value pointer for value
+     * @return false if value is absent
+     */
+    bool getValue(weatherStationRequestType_t type, warmValue_t *value);
+    /**
+     * @brief setBus store bus (other stored state is cleared, when bus is changed)
+     * @param device path to serial port device
+     * @param br baud rate (see ModBus::BaudRate)
+     */
+    void setBus(const char *device, ModBus::BaudRate br);
+    /**
+     * @brief setSlaveId store slave id of station (last values are cleared, when station is changed)
+     * @param slaveId slave id
+     */
+    void setSlaveId(uint8_t slaveId);
+    /**
+     * @brief setMaster set master of bus, which overhead of transactions is stored with readings
+     * @param master pointer to master (0 - overhead is not stored)
+     */
+    inline void setMaster(ModBus::ModBusMaster *master) { modbusMaster = master; }
+
+public slots:
+    /**
+     * @brief readingSlot store reading as last value (connect directly, one writer per station)
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+
+private:
+    warmStateFile_t *state;
+    ModBus::ModBusMaster *modbusMaster;
+};
+
+#endif // WARMSTATE_H
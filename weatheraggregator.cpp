@@ -0,0 +1,286 @@
+#include "weatheraggregator.h"
+#include <QDateTime>
+#include <math.h>
+
+#define WIND_PAIR_MAX_AGE   10000       // Max age of wind speed for pairing with wind direction (ms)
+
+WeatherAggregator::WeatherAggregator(QObject *parent) :
+    QObject(parent)
+{
+    stations.clear();
+}
+
+WeatherAggregator::~WeatherAggregator()
+{
+    QMap<uint8_t, stationAggregates_t *>::iterator it;
+    QMap<int, rollingWindow_t *>::iterator windowIt;
+
+    for (it = stations.begin(); it != stations.end(); ++it)
+    {
+        for (windowIt = it.value()->windows.begin(); windowIt != it.value()->windows.end(); ++windowIt)
+            delete windowIt.value();
+        delete it.value();
+    }
+    stations.clear();
+}
+
+qint64 WeatherAggregator::windowLength(weatherAggregationWindow_t window)
+{
+    switch (window)
+    {
+    case WS_AW_1MIN:
+        return 60 * 1000;
+    case WS_AW_10MIN:
+        return 10 * 60 * 1000;
+    case WS_AW_1HOUR:
+    default:
+        return 60 * 60 * 1000;
+    }
+}
+
+void WeatherAggregator::readingSlot(weatherReading_t reading)
+{
+    stationAggregates_t *aggregates = station(reading.slaveId);
+    double delta = 0.0;
+    int i = 0;
+
+    switch (reading.type)
+    {
+    case WS_RT_WINDDIRECTIONGRAD:
+        if (reading.timestamp - aggregates->lastWindSpeedTimestamp <= WIND_PAIR_MAX_AGE)
+        {
+            for (i = 0; i < WS_AW_COUNT; i++)
+                addWind(&aggregates->wind[i], reading.timestamp, aggregates->lastWindSpeed, reading.value);
+        }
+        break;
+    case WS_RT_RAINFALL:
+        if (aggregates->rainfallValid)
+        {
+            // Counter decreasing means it has been reset since last reading
+            delta = (reading.value >= aggregates->lastRainfall) ? reading.value - aggregates->lastRainfall : reading.value;
+            for (i = 0; i < WS_AW_COUNT; i++)
+                addSample(&aggregates->rainfall[i], reading.timestamp, delta);
+        }
+        aggregates->lastRainfall = reading.value;
+        aggregates->rainfallValid = true;
+        break;
+    case WS_RT_RESETRAINFALL:
+        aggregates->lastRainfall = 0.0;
+        aggregates->rainfallValid = true;
+        return;
+    default:
+        break;
+    }
+
+    if (WS_RT_WINDSPEED == reading.type)
+    {
+        aggregates->lastWindSpeed = reading.value;
+        aggregates->lastWindSpeedTimestamp = reading.timestamp;
+    }
+
+    for (i = 0; i < WS_AW_COUNT; i++)
+        addSample(window(aggregates, reading.type, static_cast<weatherAggregationWindow_t>(i)), reading.timestamp, reading.value);
+}
+
+bool WeatherAggregator::aggregate(uint8_t slaveId, weatherStationRequestType_t type, weatherAggregationWindow_t window, weatherAggregate_t *result)
+{
+    rollingWindow_t *rolling = this->window(station(slaveId), type, window);
+    uint32_t count;
+
+    evict(rolling, QDateTime::currentMSecsSinceEpoch());
+    if (rolling->samples.isEmpty())
+        return false;
+
+    count = rolling->samples.size();
+    result->count = count;
+    result->mean = rolling->mean;
+    result->stddev = (1 < count) ? sqrt(rolling->m2 / (count - 1)) : 0.0;
+    result->min = rolling->minQueue.head().value;
+    result->max = rolling->maxQueue.head().value;
+    result->firstTimestamp = rolling->samples.head().timestamp;
+    result->lastTimestamp = rolling->samples.last().timestamp;
+    return true;
+}
+
+bool WeatherAggregator::windAggregate(uint8_t slaveId, weatherAggregationWindow_t window, weatherWindAggregate_t *result)
+{
+    windWindow_t *wind = &station(slaveId)->wind[window];
+    double count;
+
+    evictWind(wind, QDateTime::currentMSecsSinceEpoch());
+    if (wind->samples.isEmpty())
+        return false;
+
+    count = wind->samples.size();
+    result->count = wind->samples.size();
+    result->scalarSpeed = wind->sumSpeed / count;
+    result->vectorSpeed = sqrt(wind->sumU * wind->sumU + wind->sumV * wind->sumV) / count;
+    result->vectorDirection = atan2(wind->sumU, wind->sumV) * 180.0 / M_PI;
+    if (0.0 > result->vectorDirection)
+        result->vectorDirection += 360.0;
+    result->unitDirection = atan2(wind->sumUnitU, wind->sumUnitV) * 180.0 / M_PI;
+    if (0.0 > result->unitDirection)
+        result->unitDirection += 360.0;
+    return true;
+}
+
+double WeatherAggregator::rainfallAmount(uint8_t slaveId, weatherAggregationWindow_t window)
+{
+    rollingWindow_t *rolling = &station(slaveId)->rainfall[window];
+
+    evict(rolling, QDateTime::currentMSecsSinceEpoch());
+    return rolling->samples.isEmpty() ? 0.0 : rolling->sum;
+}
+
+WeatherAggregator::stationAggregates_t *WeatherAggregator::station(uint8_t slaveId)
+{
+    stationAggregates_t *aggregates = stations.value(slaveId, 0);
+    int i = 0;
+
+    if (0 == aggregates)
+    {
+        aggregates = new stationAggregates_t;
+        for (i = 0; i < WS_AW_COUNT; i++)
+        {
+            aggregates->wind[i].length = windowLength(static_cast<weatherAggregationWindow_t>(i));
+            aggregates->wind[i].sumSpeed = 0.0;
+            aggregates->wind[i].sumU = 0.0;
+            aggregates->wind[i].sumV = 0.0;
+            aggregates->wind[i].sumUnitU = 0.0;
+            aggregates->wind[i].sumUnitV = 0.0;
+            initWindow(&aggregates->rainfall[i], windowLength(static_cast<weatherAggregationWindow_t>(i)));
+        }
+        aggregates->lastWindSpeed = 0.0;
+        aggregates->lastWindSpeedTimestamp = 0;
+        aggregates->lastRainfall = 0.0;
+        aggregates->rainfallValid = false;
+        stations.insert(slaveId, aggregates);
+    }
+    return aggregates;
+}
+
+WeatherAggregator::rollingWindow_t *WeatherAggregator::window(stationAggregates_t *aggregates, weatherStationRequestType_t type, weatherAggregationWindow_t window)
+{
+    int key = static_cast<int>(type) * WS_AW_COUNT + static_cast<int>(window);
+    rollingWindow_t *rolling = aggregates->windows.value(key, 0);
+
+    if (0 == rolling)
+    {
+        rolling = new rollingWindow_t;
+        initWindow(rolling, windowLength(window));
+        aggregates->windows.insert(key, rolling);
+    }
+    return rolling;
+}
+
+void WeatherAggregator::initWindow(rollingWindow_t *window, qint64 length)
+{
+    window->length = length;
+    window->samples.clear();
+    window->minQueue.clear();
+    window->maxQueue.clear();
+    window->mean = 0.0;
+    window->m2 = 0.0;
+    window->sum = 0.0;
+}
+
+void WeatherAggregator::addSample(rollingWindow_t *window, qint64 timestamp, double value)
+{
+    sample_t sample;
+    double delta;
+
+    evict(window, timestamp);
+
+    sample.timestamp = timestamp;
+    sample.value = value;
+    window->samples.enqueue(sample);
+
+    delta = value - window->mean;
+    window->mean += delta / window->samples.size();
+    window->m2 += delta * (value - window->mean);
+    window->sum += value;
+
+    while (!window->minQueue.isEmpty() && window->minQueue.last().value >= value)
+        window->minQueue.removeLast();
+    window->minQueue.enqueue(sample);
+    while (!window->maxQueue.isEmpty() && window->maxQueue.last().value <= value)
+        window->maxQueue.removeLast();
+    window->maxQueue.enqueue(sample);
+}
+
+void WeatherAggregator::evict(rollingWindow_t *window, qint64 now)
+{
+    qint64 border = now - window->length;
+    sample_t sample;
+    double delta;
+    int count;
+
+    while (!window->samples.isEmpty() && window->samples.head().timestamp <= border)
+    {
+        sample = window->samples.dequeue();
+        if (0 == (count = window->samples.size()))
+        {
+            window->mean = 0.0;
+            window->m2 = 0.0;
+            window->sum = 0.0;
+        }
+        else
+        {
+            // Reverse step of Welford algorithm
+            delta = sample.value - window->mean;
+            window->mean -= delta / count;
+            window->m2 -= delta * (sample.value - window->mean);
+            if (0.0 > window->m2)
+                window->m2 = 0.0;
+            window->sum -= sample.value;
+        }
+    }
+    while (!window->minQueue.isEmpty() && window->minQueue.head().timestamp <= border)
+        window->minQueue.dequeue();
+    while (!window->maxQueue.isEmpty() && window->maxQueue.head().timestamp <= border)
+        window->maxQueue.dequeue();
+}
+
+void WeatherAggregator::addWind(windWindow_t *window, qint64 timestamp, double speed, double grad)
+{
+    windSample_t sample;
+    double radians = grad * M_PI / 180.0;
+
+    evictWind(window, timestamp);
+
+    sample.timestamp = timestamp;
+    sample.speed = speed;
+    sample.sinValue = sin(radians);
+    sample.cosValue = cos(radians);
+    window->samples.enqueue(sample);
+
+    window->sumSpeed += speed;
+    window->sumU += speed * sample.sinValue;
+    window->sumV += speed * sample.cosValue;
+    window->sumUnitU += sample.sinValue;
+    window->sumUnitV += sample.cosValue;
+}
+
+void WeatherAggregator::evictWind(windWindow_t *window, qint64 now)
+{
+    qint64 border = now - window->length;
+    windSample_t sample;
+
+    while (!window->samples.isEmpty() && window->samples.head().timestamp <= border)
+    {
+        sample = window->samples.dequeue();
+        window->sumSpeed -= sample.speed;
+        window->sumU -= sample.speed * sample.sinValue;
+        window->sumV -= sample.speed * sample.cosValue;
+        window->sumUnitU -= sample.sinValue;
+        window->sumUnitV -= sample.cosValue;
+    }
+    if (window->samples.isEmpty())
+    {
+        window->sumSpeed = 0.0;
+        window->sumU = 0.0;
+        window->sumV = 0.0;
+        window->sumUnitU = 0.0;
+        window->sumUnitV = 0.0;
+    }
+}
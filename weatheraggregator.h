@@ -0,0 +1,154 @@
+#ifndef WEATHERAGGREGATOR_H
+#define WEATHERAGGREGATOR_H
+
+#include <QObject>
+#include <QQueue>
+#include <QMap>
+#include "weatherstation.h"
+
+typedef enum _weatherAggregationWindow_t
+{
+    WS_AW_1MIN = 0,                     //! Window of 1 minute
+    WS_AW_10MIN,                        //! Window of 10 minutes
+    WS_AW_1HOUR,                        //! Window of 1 hour
+    WS_AW_COUNT                         //! Amount of windows
+} weatherAggregationWindow_t;
+
+//! Aggregate of measurement over rolling window
+typedef struct _weatherAggregate_t
+{
+    uint32_t count;                     //!< Amount of samples in window
+    double mean;                        //!< Mean value
+    double stddev;                      //!< Sample standard deviation
+    double min;                         //!< Minimal value
+    double max;                         //!< Maximal value
+    qint64 firstTimestamp;              //!< Time of oldest sample in window (ms since epoch)
+    qint64 lastTimestamp;               //!< Time of newest sample in window (ms since epoch)
+} weatherAggregate_t;
+
+//! Aggregate of wind over rolling window
+typedef struct _weatherWindAggregate_t
+{
+    uint32_t count;                     //!< Amount of wind vectors in window
+    double scalarSpeed;                 //!< Mean of wind speed modules (m/s)
+    double vectorSpeed;                 //!< Module of mean wind vector (m/s)
+    double vectorDirection;             //!< Direction of mean wind vector (°)
+    double unitDirection;               //!< Mean wind direction without speed weighting (°)
+} weatherWindAggregate_t;
+
+/**
+ * @brief The WeatherAggregator class provide incremental rolling aggregates of weather station readings
+ *
+ * Every sample is processed in O(1): mean and variance are kept by Welford algorithm (with removal
+ * of evicted samples), minimum and maximum are kept by monotonic queues. Wind is averaged as vector
+ * from wind speed and direction (in grad), rainfall is aggregated as sum of counter increments
+ * (reset of counter is received as WS_RT_RESETRAINFALL reading).
+ */
+class WeatherAggregator : public QObject
+{
+    Q_OBJECT
+public:
+    /**
+     * @brief WeatherAggregator class constructor
+     * @param parent parent class
+     */
+    explicit WeatherAggregator(QObject *parent = 0);
+    ~WeatherAggregator();
+    /**
+     * @brief aggregate get aggregate of measurement
+     * @param slaveId slave id of station
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @param window aggregation window (see weatherAggregationWindow_t)
+     * @param result pointer to result structure
+     * @return true if window contains at least one sample
+     */
+    bool aggregate(uint8_t slaveId, weatherStationRequestType_t type, weatherAggregationWindow_t window, weatherAggregate_t *result);
+    /**
+     * @brief windAggregate get vector aggregate of wind
+     * @param slaveId slave id of station
+     * @param window aggregation window (see weatherAggregationWindow_t)
+     * @param result pointer to result structure
+     * @return true if window contains at least one wind vector
+     */
+    bool windAggregate(uint8_t slaveId, weatherAggregationWindow_t window, weatherWindAggregate_t *result);
+    /**
+     * @brief rainfallAmount get amount of rainfall in window
+     * @param slaveId slave id of station
+     * @param window aggregation window (see weatherAggregationWindow_t)
+     * @return rainfall (mm)
+     */
+    double rainfallAmount(uint8_t slaveId, weatherAggregationWindow_t window);
+    /**
+     * @brief windowLength get length of aggregation window
+     * @param window aggregation window (see weatherAggregationWindow_t)
+     * @return length of window (ms)
+     */
+    static qint64 windowLength(weatherAggregationWindow_t window);
+
+public slots:
+    /**
+     * @brief readingSlot add reading to aggregates
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void readingSlot(weatherReading_t reading);
+
+private:
+    typedef struct _sample_t
+    {
+        qint64 timestamp;
+        double value;
+    } sample_t;
+
+    typedef struct _windSample_t
+    {
+        qint64 timestamp;
+        double speed;
+        double sinValue;
+        double cosValue;
+    } windSample_t;
+
+    typedef struct _rollingWindow_t
+    {
+        qint64 length;
+        QQueue<sample_t> samples;
+        QQueue<sample_t> minQueue;
+        QQueue<sample_t> maxQueue;
+        double mean;
+        double m2;
+        double sum;
+    } rollingWindow_t;
+
+    typedef struct _windWindow_t
+    {
+        qint64 length;
+        QQueue<windSample_t> samples;
+        double sumSpeed;
+        double sumU;
+        double sumV;
+        double sumUnitU;
+        double sumUnitV;
+    } windWindow_t;
+
+    typedef struct _stationAggregates_t
+    {
+        QMap<int, rollingWindow_t *> windows;
+        windWindow_t wind[WS_AW_COUNT];
+        rollingWindow_t rainfall[WS_AW_COUNT];
+        double lastWindSpeed;
+        qint64 lastWindSpeedTimestamp;
+        double lastRainfall;
+        bool rainfallValid;
+    } stationAggregates_t;
+
+    stationAggregates_t *station(uint8_t slaveId);
+    rollingWindow_t *window(stationAggregates_t *aggregates, weatherStationRequestType_t type, weatherAggregationWindow_t window);
+    void initWindow(rollingWindow_t *window, qint64 length);
+    void addSample(rollingWindow_t *window, qint64 timestamp, double value);
+    void evict(rollingWindow_t *window, qint64 now);
+    void addWind(windWindow_t *window, qint64 timestamp, double speed, double grad);
+    void evictWind(windWindow_t *window, qint64 now);
+
+    QMap<uint8_t, stationAggregates_t *> stations;
+};
+
+#endif // WEATHERAGGREGATOR_H
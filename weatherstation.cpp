@@ -1,28 +1,54 @@
 #include "weatherstation.h"
-#include <iostream>
+#include <QDateTime>
+#include "logger.h"
 #include <endian.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include "decodepipeline.h"
+#include "stationprofile.h"
 
 Q_DECLARE_METATYPE(weatherStationErrors_t)
+Q_DECLARE_METATYPE(weatherReading_t)
+Q_DECLARE_METATYPE(weatherStationRequestType_t)
 
 WeatherStation::WeatherStation(ModBus::ModBusMaster *master, QObject *parent)
     : ModBus::ModBusMasterSub{master, parent}
 {
     qRegisterMetaType<weatherStationErrors_t>();
+    qRegisterMetaType<weatherReading_t>();
+    qRegisterMetaType<weatherStationRequestType_t>();
+    qRegisterMetaType<uint32_t>("uint32_t");
 
     requestsMap.clear();
     weatherStationSlaveId = 0xff;
+    decodePipeline = 0;
+    pipelineIndex = -1;
+    lastResponse = 0;
+    memset(measurementCache, 0, sizeof(measurementCache));
+    requestFrames = 0;
+    framesSlaveId = 0xff;
+    buildFrames();
 
     connect(this, SIGNAL(error(ModBus::ModBusError)), this, SLOT(modbusErrorSlot(ModBus::ModBusError)));
     connect(this, SIGNAL(transactionFinished(ModBus::mbTransaction_t*)), this, SLOT(transactionFinishedSlot(ModBus::mbTransaction_t*)));
+    connect(this, SIGNAL(transactionFailed(uint8_t)), this, SLOT(transactionFailedSlot(uint8_t)));
+    connect(this, SIGNAL(stationError(weatherStationErrors_t)), this, SLOT(stationErrorSlot(weatherStationErrors_t)));
+}
+
+WeatherStation::~WeatherStation()
+{
+    while (!frameTables.isEmpty())
+        delete[] frameTables.takeLast();
 }
 
 void WeatherStation::requestSlaveIdSlot()
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, 0xFF, 0x07D0, 1)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, 0xFF,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_SLAVE_ID), 1)))
     {
-        std::cout << "[WeatherStation] Can`t create slaveId request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create slaveId request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -35,9 +61,10 @@ void WeatherStation::requestBaudRate()
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x07D1, 1)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_BAUD_RATE), 1)))
     {
-        std::cout << "[WeatherStation] Can`t create baud rate request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create baud rate request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -48,196 +75,249 @@ void WeatherStation::requestBaudRate()
 
 void WeatherStation::requestWindSpeed()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F4, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create wind speed request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_WINDSPEED);
-    }
+    requestMeasurement(WS_RT_WINDSPEED);
 }
 
 void WeatherStation::requestWindStrength()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F5, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create wind strength request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_WINDSTRENGTH);
-    }
+    requestMeasurement(WS_RT_WINDSTRENGTH);
 }
 
 void WeatherStation::requestWindDirection()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F6, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create wind direction request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_WINDDIRECTION);
-    }
+    requestMeasurement(WS_RT_WINDDIRECTION);
 }
 
 void WeatherStation::requestWindDirectionGrad()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F7, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create wind direction (grad) request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_WINDDIRECTIONGRAD);
-    }
+    requestMeasurement(WS_RT_WINDDIRECTIONGRAD);
 }
 
 void WeatherStation::requestHumidity()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F8, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create humidity request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_HUMIDITY);
-    }
+    requestMeasurement(WS_RT_HUMIDITY);
 }
 
 void WeatherStation::requestTemperature()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01F9, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create temperature request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_TEMPERATURE);
-    }
+    requestMeasurement(WS_RT_TEMPERATURE);
 }
 
 void WeatherStation::requestNoise()
 {
-    int requestId = 0;
-
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01FA, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create noise request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
-    {
-        requestsMap.insert(requestId, WS_RT_NOISE);
-    }
+    requestMeasurement(WS_RT_NOISE);
 }
 
 void WeatherStation::requestPM2_5()
 {
-    int requestId = 0;
+    requestMeasurement(WS_RT_PM2_5);
+}
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01FB, 1)))
-    {
-        std::cout << "[WeatherStation] Can`t create pm 2.5 request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
-    }
-    else
+void WeatherStation::requestPM10()
+{
+    requestMeasurement(WS_RT_PM10);
+}
+
+void WeatherStation::requestPressure()
+{
+    requestMeasurement(WS_RT_PRESSURE);
+}
+
+void WeatherStation::requestIlluminanceQ()
+{
+    requestMeasurement(WS_RT_ILLUMINANCE_Q);
+}
+
+void WeatherStation::requestIlluminance()
+{
+    requestMeasurement(WS_RT_ILLUMINANCE);
+}
+
+void WeatherStation::requestRainfall()
+{
+    requestMeasurement(WS_RT_RAINFALL);
+}
+
+void WeatherStation::requestReading(weatherStationRequestType_t type)
+{
+    if (WS_RT_WINDSPEED > type || WS_RT_RAINFALL < type)
     {
-        requestsMap.insert(requestId, WS_RT_PM2_5);
+        LOG_ERROR("WeatherStation", "Request type %d is not a measurement!", type);
+        return;
     }
+    requestMeasurement(type);
 }
 
-void WeatherStation::requestPM10()
+void WeatherStation::requestReadings(const weatherStationRequestType_t *types, int amount)
 {
-    int requestId = 0;
+    ModBus::mbRequest_t requests[WS_RT_RAINFALL + 1];
+    const ModBus::mbRequestFrame_t *frames = requestFrames;
+    int requestsAmount = 0;
+    int i = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01FC, 1)))
+    // Table of frames is replaced on change of slave id, taken table is not changed
+    __sync_synchronize();
+    memset(requests, 0, sizeof(requests));
+    for (i = 0; i < amount && requestsAmount <= WS_RT_RAINFALL; i++)
     {
-        std::cout << "[WeatherStation] Can`t create pm 10 request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
+        if (WS_RT_WINDSPEED > types[i] || WS_RT_RAINFALL < types[i] || 0 == frames[types[i]].txSize)
+        {
+            LOG_WARNING("WeatherStation", "Measurement %s is not supported by %s!", measurementName(types[i]), StationCodec::getProfile()->getName());
+            emit stationError(WS_ERROR_NOT_SUPPORTED);
+            continue;
+        }
+        requests[requestsAmount].frame = &frames[types[i]];
+        requests[requestsAmount].tag = types[i];
+        requestsAmount++;
     }
-    else
+
+    if (0 != requestsAmount && !ModBus::ModBusMasterSub::submitBatch(requests, requestsAmount))
     {
-        requestsMap.insert(requestId, WS_RT_PM10);
+        LOG_ERROR("WeatherStation", "Can`t create batch of %d requests!", requestsAmount);
+        emit stationError(WS_ERROR_SEND_QUEUE);
     }
 }
 
-void WeatherStation::requestPressure()
+void WeatherStation::batchSubmitted(ModBus::mbTransaction_t *const *transactions, int amount, bool queued)
 {
-    int requestId = 0;
+    weatherStationRequestType_t type = WS_RT_UNKNOWN;
+    uint32_t response = 0;
+    int snapshotReads = 0;
+    int i = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01FD, 1)))
+    if (!queued)
     {
-        std::cout << "[WeatherStation] Can`t create atmosphere pressure request!" << std::endl;
         emit stationError(WS_ERROR_SEND_QUEUE);
+        return;
     }
-    else
+    for (i = 0; i < amount; i++)
+    {
+        type = static_cast<weatherStationRequestType_t>(transactions[i]->tag);
+        requestsMap.insert(transactions[i]->transactionId, type);
+        if (WS_RT_WINDSPEED <= type && WS_RT_RAINFALL >= type)
+            measurementCache[type].refreshing = true;
+        else if (WS_RT_READSNAPSHOT == type)
+            snapshotReads++;
+    }
+    if (0 == snapshotReads)
+        return;
+
+    // Snapshot reads get consecutive response ids now, tag carries id to decoding, so readers of snapshot
+    // know its readings before responses are received
+    response = __sync_add_and_fetch(&lastResponse, snapshotReads) - snapshotReads + 1;
+    for (i = 0; i < amount; i++)
     {
-        requestsMap.insert(requestId, WS_RT_PRESSURE);
+        if (WS_RT_READSNAPSHOT == transactions[i]->tag)
+            transactions[i]->tag = static_cast<int>(response++);
     }
+    emit snapshotSubmitted(response - snapshotReads, snapshotReads);
 }
 
-void WeatherStation::requestIlluminanceQ()
+void WeatherStation::requestSnapshot()
 {
-    int requestId = 0;
+    ModBus::mbRegisterNeed_t needs[StationProfile::MAX_MEASUREMENTS * 2];
+    ModBus::mbPlannedRead_t reads[StationProfile::MAX_MEASUREMENTS * 2];
+    ModBus::mbRequest_t requests[StationProfile::MAX_MEASUREMENTS * 2];
+    uint16_t regs[StationProfile::MAX_MEASUREMENTS * 2];
+    uint8_t slaveId = weatherStationSlaveId;
+    int regsAmount = 0;
+    int readsAmount = 0;
+    int i = 0;
+
+    if (0 == (regsAmount = StationCodec::getProfile()->groupRegisters(StationProfile::SNAPSHOT_GROUP, regs, StationProfile::MAX_MEASUREMENTS * 2)))
+    {
+        emit stationError(WS_ERROR_NOT_SUPPORTED);
+        return;
+    }
+    for (i = 0; i < regsAmount; i++)
+    {
+        needs[i].slaveId = slaveId;
+        needs[i].fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+        needs[i].regAddr = regs[i];
+    }
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x01FE, 2)))
+    readsAmount = getMaster()->planReads(needs, regsAmount, reads, StationProfile::MAX_MEASUREMENTS * 2,
+                                         StationCodec::getProfile()->getMaxGap());
+    memset(requests, 0, sizeof(requests));
+    for (i = 0; i < readsAmount; i++)
     {
-        std::cout << "[WeatherStation] Can`t create illuminance (quality) request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
+        requests[i].fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+        requests[i].slaveId = slaveId;
+        requests[i].valAddr = reads[i].regAddr;
+        requests[i].value = reads[i].regsAmount;
+        requests[i].tag = WS_RT_READSNAPSHOT;
     }
-    else
+
+    if (0 >= readsAmount || !ModBus::ModBusMasterSub::submitBatch(requests, readsAmount))
     {
-        requestsMap.insert(requestId, WS_RT_ILLUMINANCE_Q);
+        LOG_ERROR("WeatherStation", "Can`t create batch of snapshot reads!");
+        emit stationError(WS_ERROR_SEND_QUEUE);
     }
 }
 
-void WeatherStation::requestIlluminance()
+void WeatherStation::requestPollGroup(uint8_t group)
 {
+    ModBus::mbRegisterNeed_t needs[StationProfile::MAX_MEASUREMENTS * 2];
+    ModBus::mbPlannedRead_t reads[StationProfile::MAX_MEASUREMENTS * 2];
+    uint16_t regs[StationProfile::MAX_MEASUREMENTS * 2];
+    int regsAmount = 0;
+    int readsAmount = 0;
     int requestId = 0;
+    int i = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x0200, 1)))
+    if (0 == (regsAmount = StationCodec::getProfile()->groupRegisters(group, regs, StationProfile::MAX_MEASUREMENTS * 2)))
     {
-        std::cout << "[WeatherStation] Can`t create illuminance request!" << std::endl;
-        emit stationError(WS_ERROR_SEND_QUEUE);
+        LOG_WARNING("WeatherStation", "Poll group %u has no measurements!", group);
+        emit stationError(WS_ERROR_NOT_SUPPORTED);
+        return;
     }
-    else
+    for (i = 0; i < regsAmount; i++)
     {
-        requestsMap.insert(requestId, WS_RT_ILLUMINANCE);
+        needs[i].slaveId = weatherStationSlaveId;
+        needs[i].fid = ModBus::MB_READ_HOLDING_REGISTERS_FID;
+        needs[i].regAddr = regs[i];
+    }
+
+    // Gaps between measurements are merged into reads, when it is cheaper than one more transaction
+    readsAmount = getMaster()->planReads(needs, regsAmount, reads, StationProfile::MAX_MEASUREMENTS * 2,
+                                         StationCodec::getProfile()->getMaxGap());
+    for (i = 0; i < readsAmount; i++)
+    {
+        if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId,
+                                                                     reads[i].regAddr, reads[i].regsAmount)))
+        {
+            LOG_ERROR("WeatherStation", "Can`t create read request of poll group %u!", group);
+            emit stationError(WS_ERROR_SEND_QUEUE);
+            return;
+        }
+        requestsMap.insert(requestId, WS_RT_READRANGE);
     }
 }
 
-void WeatherStation::requestRainfall()
+void WeatherStation::requestMeasurement(weatherStationRequestType_t type)
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, 0x0201, 1)))
+    // Frame of measurement is built for current slave id, unsupported measurement has not frame
+    if (0 == requestFrames[type].txSize)
     {
-        std::cout << "[WeatherStation] Can`t create rainfall request!" << std::endl;
+        LOG_WARNING("WeatherStation", "Measurement %s is not supported by %s!", measurementName(type), StationCodec::getProfile()->getName());
+        emit stationError(WS_ERROR_NOT_SUPPORTED);
+        return;
+    }
+
+    if (readCached(type))
+        return;
+
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(requestFrames[type])))
+    {
+        LOG_ERROR("WeatherStation", "Can`t create %s request!", measurementName(type));
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
     {
-        requestsMap.insert(requestId, WS_RT_RAINFALL);
+        requestsMap.insert(requestId, type);
+        measurementCache[type].refreshing = true;
     }
 }
 
@@ -245,9 +325,10 @@ void WeatherStation::requestSetSlaveId(uint8_t slaveId)
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId, 0x07D0, slaveId)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_SLAVE_ID), slaveId)))
     {
-        std::cout << "[WeatherStation] Can`t create set slave id request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create set slave id request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -272,9 +353,10 @@ void WeatherStation::requestSetBaudRate(uint16_t baudRate)
         emit stationError(WS_ERROR_BAUDRATE);
         return;
     }
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId, 0x07D1, baudRateRegister)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_BAUD_RATE), baudRateRegister)))
     {
-        std::cout << "[WeatherStation] Can`t create set baud rate request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create set baud rate request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -287,9 +369,10 @@ void WeatherStation::requestSetWindDirectionOffset(uint8_t offset)
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId, 0x6000, offset)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_WIND_DIRECTION_OFFSET), offset)))
     {
-        std::cout << "[WeatherStation] Can`t create set wind direction offset request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create set wind direction offset request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -302,9 +385,10 @@ void WeatherStation::requestResetZeroWindSpeed()
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId, 0x6001, 0x00AA)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_RESET_WIND_SPEED), 0x00AA)))
     {
-        std::cout << "[WeatherStation] Can`t create reset zero wind speed request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create reset zero wind speed request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -317,9 +401,10 @@ void WeatherStation::requestResetRainfall()
 {
     int requestId = 0;
 
-    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId, 0x6002, 0x005A)))
+    if (-1 == (requestId = ModBus::ModBusMasterSub::createRequest(ModBus::MB_FORCE_SINGLE_REGISTER_FID, weatherStationSlaveId,
+                                                                     StationCodec::getProfile()->controlRegister(StationProfile::CONTROL_RESET_RAINFALL), 0x005A)))
     {
-        std::cout << "[WeatherStation] Can`t create reset rainfall request!" << std::endl;
+        LOG_ERROR("WeatherStation", "Can`t create reset rainfall request!");
         emit stationError(WS_ERROR_SEND_QUEUE);
     }
     else
@@ -331,6 +416,38 @@ void WeatherStation::requestResetRainfall()
 void WeatherStation::transactionFinishedSlot(ModBus::mbTransaction_t *transaction)
 {
     weatherStationRequestType_t requestType = requestsMap.value(transaction->transactionId, WS_RT_UNKNOWN);
+    StationProfile::profileReadField_t fields[StationProfile::MAX_MEASUREMENTS];
+    int fieldsAmount = 0;
+    int i = 0;
+
+    if (0 != decodePipeline && ((WS_RT_WINDSPEED <= requestType && WS_RT_RAINFALL >= requestType) || WS_RT_READRANGE == requestType ||
+                                WS_RT_READSNAPSHOT == requestType) &&
+            false != transaction->crcCheck && 0 == transaction->rxFrame->hdr.err)
+    {
+        // Cache is read by request slots, so it is updated in bus thread
+        if (WS_RT_READRANGE != requestType && WS_RT_READSNAPSHOT != requestType)
+            storeResponseCache(transaction, requestType, 0);
+        else
+        {
+            fieldsAmount = readFields(transaction, requestType, fields);
+            for (i = 0; i < fieldsAmount; i++)
+                storeResponseCache(transaction, static_cast<weatherStationRequestType_t>(fields[i].type), fields[i].regOffset);
+        }
+        // Response is dropped on full ring (value is in cache), decoding here would race with worker of station
+        if (decodePipeline->submit(pipelineIndex, transaction, requestType))
+            return;
+    }
+    else
+        decodeTransaction(transaction, requestType);
+
+    delete transaction->txFrame;
+    delete transaction->rxFrame;
+    delete transaction;
+}
+
+void WeatherStation::decodeTransaction(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t requestType)
+{
+    weatherReading_t reading;
     uint16_t cacheValue;
 
     if (false != transaction->crcCheck)
@@ -343,94 +460,39 @@ void WeatherStation::transactionFinishedSlot(ModBus::mbTransaction_t *transactio
             switch(requestType)
             {
             case WS_RT_SLAVEID:
+                // Cached values may belong to other station
+                invalidateCache();
                 if (0xff == (weatherStationSlaveId = static_cast<uint8_t>(transaction->rxFrame->readRegsResp.regs[0] & 0xff)))
                     emit stationError(WS_ERROR_SLAVEID_INCORRECT);
                 else
+                {
+                    buildFrames();
                     emit connectionSetuped();
+                }
                 break;
             case WS_RT_BAUDRATE:
-                switch(transaction->rxFrame->readRegsResp.regs[0])
-                {
-                case 0:
-                    emit baudRate(2400);
-                    break;
-                case 1:
-                    emit baudRate(4800);
-                    break;
-                case 2:
-                    emit baudRate(9600);
-                    break;
-                default:
-                    emit baudRate(0);
-                }
+                emit baudRate(StationCodec::baudRateValue(transaction->rxFrame->readRegsResp.regs[0]));
                 break;
             case WS_RT_WINDSPEED:
-                emit windSpeed(static_cast<float>(transaction->rxFrame->readRegsResp.regs[0]) / 100.0f);
-                break;
             case WS_RT_WINDSTRENGTH:
-                emit windStrength(transaction->rxFrame->readRegsResp.regs[0]);
-                break;
             case WS_RT_WINDDIRECTION:
-                switch(transaction->rxFrame->readRegsResp.regs[0])
-                {
-                case 0:
-                    emit windDirection("North");
-                    break;
-                case 1:
-                    emit windDirection("Northeast");
-                    break;
-                case 2:
-                    emit windDirection("East");
-                    break;
-                case 3:
-                    emit windDirection("Southeast");
-                    break;
-                case 4:
-                    emit windDirection("South");
-                    break;
-                case 5:
-                    emit windDirection("Southwest");
-                    break;
-                case 6:
-                    emit windDirection("West");
-                    break;
-                case 7:
-                    emit windDirection("Northwest");
-                    break;
-                default:
-                    emit windDirection("Unknown");
-                    break;
-                }
-                break;
             case WS_RT_WINDDIRECTIONGRAD:
-                emit windDirectionGrad(transaction->rxFrame->readRegsResp.regs[0]);
-                break;
             case WS_RT_HUMIDITY:
-                emit humidity(static_cast<float>(transaction->rxFrame->readRegsResp.regs[0]) / 10.0f);
-                break;
             case WS_RT_TEMPERATURE:
-                emit temperature(static_cast<float>(unsignedToSigned(transaction->rxFrame->readRegsResp.regs[0])) / 10.0f);
-                break;
             case WS_RT_NOISE:
-                emit noise(static_cast<float>(transaction->rxFrame->readRegsResp.regs[0]) / 10.0f);
-                break;
             case WS_RT_PM2_5:
-                emit pm2_5(transaction->rxFrame->readRegsResp.regs[0]);
-                break;
             case WS_RT_PM10:
-                emit pm10(transaction->rxFrame->readRegsResp.regs[0]);
-                break;
             case WS_RT_PRESSURE:
-                emit pressure(static_cast<float>(transaction->rxFrame->readRegsResp.regs[0]) / 10.0f);
-                break;
             case WS_RT_ILLUMINANCE_Q:
-                emit illuminance((transaction->rxFrame->readRegsResp.regs[0] << 16) | transaction->rxFrame->readRegsResp.regs[1]);
-                break;
             case WS_RT_ILLUMINANCE:
-                emit illuminance(transaction->rxFrame->readRegsResp.regs[0] * 100);
-                break;
             case WS_RT_RAINFALL:
-                emit rainfall(static_cast<float>(transaction->rxFrame->readRegsResp.regs[0]) / 10.0f);
+                storeCache(requestType, transaction->rxFrame->readRegsResp.regs);
+                if (decodeMeasurement(requestType, transaction->rxFrame->readRegsResp.regs, &reading))
+                    publishReading(reading.type, reading.value, __sync_add_and_fetch(&lastResponse, 1));
+                break;
+            case WS_RT_READRANGE:
+            case WS_RT_READSNAPSHOT:
+                decodeRange(transaction, requestType, true);
                 break;
             case WS_RT_SETSLAVEID:
                 if (0xff <= (cacheValue = transaction->rxFrame->writeRegResp.regVal))
@@ -438,24 +500,13 @@ void WeatherStation::transactionFinishedSlot(ModBus::mbTransaction_t *transactio
                 else
                 {
                     weatherStationSlaveId = static_cast<uint8_t>(cacheValue);
+                    invalidateCache();
+                    buildFrames();
                     emit setSlaveId(weatherStationSlaveId);
                 }
                 break;
             case WS_RT_SETBAUDRATE:
-                switch(transaction->rxFrame->writeRegResp.regVal)
-                {
-                case 0:
-                    emit baudRate(2400);
-                    break;
-                case 1:
-                    emit baudRate(4800);
-                    break;
-                case 2:
-                    emit baudRate(9600);
-                    break;
-                default:
-                    emit baudRate(0);
-                }
+                emit baudRate(StationCodec::baudRateValue(transaction->rxFrame->writeRegResp.regVal));
                 break;
             case WS_RT_SETWINDDIRECTIONOFFSET:
                 if (1 < transaction->rxFrame->writeRegResp.regVal)
@@ -465,13 +516,20 @@ void WeatherStation::transactionFinishedSlot(ModBus::mbTransaction_t *transactio
                 break;
             case WS_RT_RESETWINDSPEED:
                 if (0x00AA == transaction->rxFrame->writeRegResp.regVal)
+                {
+                    measurementCache[WS_RT_WINDSPEED].valid = false;
                     emit resetWindSpeed();
+                }
                 else
                     emit stationError(WS_ERROR_RESET_WIND_SPEED);
                 break;
             case WS_RT_RESETRAINFALL:
                 if (0x005A == transaction->rxFrame->writeRegResp.regVal)
+                {
+                    measurementCache[WS_RT_RAINFALL].valid = false;
                     emit resetRainfall();
+                    publishReading(requestType, 0.0, __sync_add_and_fetch(&lastResponse, 1));
+                }
                 else
                     emit stationError(WS_ERROR_RESET_RAINFALL);
                 break;
@@ -480,22 +538,245 @@ void WeatherStation::transactionFinishedSlot(ModBus::mbTransaction_t *transactio
             }
         }
         else
+        {
+            cancelRefresh(requestType);
             emit stationError(WS_ERROR_EXCEPTION);
+        }
     }
     else
+    {
+        cancelRefresh(requestType);
         emit stationError(WS_ERROR_CRC);
+    }
+}
 
-    delete transaction->txFrame;
-    delete transaction->rxFrame;
-    delete transaction;
+bool WeatherStation::decodeMeasurement(weatherStationRequestType_t type, const uint16_t *regs, weatherReading_t *reading)
+{
+    if (!StationCodec::decodeMeasurement(type, regs, &reading->type, &reading->value))
+        return false;
+
+    switch (type)
+    {
+    case WS_RT_WINDSPEED:
+        emit windSpeed(static_cast<float>(reading->value));
+        return true;
+    case WS_RT_WINDSTRENGTH:
+        emit windStrength(regs[0]);
+        return true;
+    case WS_RT_WINDDIRECTION:
+        // Cardinal direction is not published as reading
+        emit windDirection(StationCodec::windDirectionName(static_cast<uint16_t>(reading->value)));
+        return false;
+    case WS_RT_WINDDIRECTIONGRAD:
+        emit windDirectionGrad(regs[0]);
+        return true;
+    case WS_RT_HUMIDITY:
+        emit humidity(static_cast<float>(reading->value));
+        return true;
+    case WS_RT_TEMPERATURE:
+        emit temperature(static_cast<float>(reading->value));
+        return true;
+    case WS_RT_NOISE:
+        emit noise(static_cast<float>(reading->value));
+        return true;
+    case WS_RT_PM2_5:
+        emit pm2_5(regs[0]);
+        return true;
+    case WS_RT_PM10:
+        emit pm10(regs[0]);
+        return true;
+    case WS_RT_PRESSURE:
+        emit pressure(static_cast<float>(reading->value));
+        return true;
+    case WS_RT_ILLUMINANCE_Q:
+    case WS_RT_ILLUMINANCE:
+        emit illuminance(static_cast<uint32_t>(reading->value));
+        return true;
+    case WS_RT_RAINFALL:
+        emit rainfall(static_cast<float>(reading->value));
+        return true;
+    default:
+        return false;
+    }
 }
 
-int16_t WeatherStation::unsignedToSigned(uint16_t value)
+void WeatherStation::decodeReading(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type)
 {
-    if (SHRT_MAX > value)
-        return static_cast<int16_t>(value);
+    weatherReading_t reading;
+
+#if __BYTE_ORDER == __LITTLE_ENDIAN
+    ModBus::ModBusMasterSub::swapByteOrder(transaction);
+#endif
+    if (WS_RT_READRANGE == type || WS_RT_READSNAPSHOT == type)
+        decodeRange(transaction, type, false);
+    else if (decodeMeasurement(type, transaction->rxFrame->readRegsResp.regs, &reading))
+        publishReading(reading.type, reading.value, __sync_add_and_fetch(&lastResponse, 1));
+}
+
+void WeatherStation::decodeRange(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t requestType, bool store)
+{
+    StationProfile::profileReadField_t fields[StationProfile::MAX_MEASUREMENTS];
+    weatherStationRequestType_t type = WS_RT_UNKNOWN;
+    weatherReading_t reading;
+    uint32_t response = 0;
+    int fieldsAmount = 0;
+    int i = 0;
+
+    if (0 == (fieldsAmount = readFields(transaction, requestType, fields)))
+    {
+        LOG_ERROR("WeatherStation", "Response of poll group read does not match profile!");
+        emit stationError(WS_ERROR_UNKOWN);
+        return;
+    }
+    // Values of range read are marked as one update of station, snapshot reads have reserved id
+    // (see batchSubmitted), replayed ones get new id
+    if (WS_RT_READSNAPSHOT == requestType && 0 != transaction->tag)
+        response = static_cast<uint32_t>(transaction->tag);
     else
-        return static_cast<int16_t>(USHRT_MAX - value) * -1;
+        response = __sync_add_and_fetch(&lastResponse, 1);
+    for (i = 0; i < fieldsAmount; i++)
+    {
+        type = static_cast<weatherStationRequestType_t>(fields[i].type);
+        if (store)
+            storeCache(type, &transaction->rxFrame->readRegsResp.regs[fields[i].regOffset]);
+        if (decodeMeasurement(type, &transaction->rxFrame->readRegsResp.regs[fields[i].regOffset], &reading))
+            publishReading(reading.type, reading.value, response);
+    }
+}
+
+int WeatherStation::readFields(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type, StationProfile::profileReadField_t *fields)
+{
+    uint16_t regsAmount = ntohs(transaction->txFrame->readRegsReq.regsAmount);
+
+    // Request frame is kept in network byte order
+    if (transaction->rxFrame->readRegsResp.bytesAmount < regsAmount * sizeof(uint16_t))
+        return 0;
+    return StationCodec::getProfile()->readFields(ntohs(transaction->txFrame->readRegsReq.regAddr), regsAmount, fields, StationProfile::MAX_MEASUREMENTS,
+                                                  (WS_RT_READSNAPSHOT == type) ? static_cast<uint8_t>(StationProfile::SNAPSHOT_GROUP) : 0);
+}
+
+void WeatherStation::storeResponseCache(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type, int regOffset)
+{
+    uint16_t regs[2];
+
+    regs[0] = ntohs(transaction->rxFrame->readRegsResp.regs[regOffset]);
+    regs[1] = ntohs(transaction->rxFrame->readRegsResp.regs[regOffset + 1]);
+    storeCache(type, regs);
+}
+
+void WeatherStation::setPipeline(DecodePipeline *pipeline)
+{
+    decodePipeline = pipeline;
+    pipelineIndex = (0 != pipeline) ? pipeline->addStation(this) : -1;
+    if (-1 == pipelineIndex)
+        decodePipeline = 0;
+}
+
+void WeatherStation::setCacheMaxAge(weatherStationRequestType_t type, int maxAge)
+{
+    if (WS_RT_WINDSPEED <= type && WS_RT_RAINFALL >= type)
+        measurementCache[type].maxAge = (0 < maxAge) ? maxAge : 0;
+}
+
+void WeatherStation::setCacheMaxAge(int maxAge)
+{
+    int type = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+        setCacheMaxAge(static_cast<weatherStationRequestType_t>(type), maxAge);
+}
+
+bool WeatherStation::readCached(weatherStationRequestType_t type)
+{
+    measurementCache_t *cache = &measurementCache[type];
+    weatherReading_t reading;
+
+    if (0 == cache->maxAge)
+        return false;
+
+    if (cache->valid && static_cast<qint64>(ModBus::monotonicTime() / 1000000) - cache->timestamp <= cache->maxAge)
+    {
+        // Value is not new measurement, so it is not published as reading
+        decodeMeasurement(type, cache->regs, &reading);
+        return true;
+    }
+    // Waiters of stale value get it from refresh, which is already in send queue
+    return cache->refreshing;
+}
+
+void WeatherStation::storeCache(weatherStationRequestType_t type, const uint16_t *regs)
+{
+    measurementCache_t *cache = &measurementCache[type];
+    const StationProfile::profileMeasurement_t *item = StationCodec::getProfile()->measurement(type);
+
+    cache->regs[0] = regs[0];
+    cache->regs[1] = (0 != item && 1 < item->regsAmount) ? regs[1] : 0;
+    cache->timestamp = static_cast<qint64>(ModBus::monotonicTime() / 1000000);
+    cache->valid = true;
+    cache->refreshing = false;
+}
+
+void WeatherStation::cancelRefresh(weatherStationRequestType_t type)
+{
+    if (WS_RT_WINDSPEED <= type && WS_RT_RAINFALL >= type)
+        measurementCache[type].refreshing = false;
+}
+
+void WeatherStation::buildFrames()
+{
+    ModBus::mbRequestFrame_t *frames = 0;
+    uint16_t regAddr = 0;
+    uint16_t regsAmount = 0;
+    int type = 0;
+
+    if (0 != requestFrames && weatherStationSlaveId == framesSlaveId)
+        return;
+
+    // Polls are constant for slave id, so frames with CRC are built once and only copied into requests
+    frames = new ModBus::mbRequestFrame_t[WS_RT_RAINFALL + 1];
+    memset(frames, 0, sizeof(ModBus::mbRequestFrame_t) * (WS_RT_RAINFALL + 1));
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+    {
+        if (StationCodec::readRequest(static_cast<weatherStationRequestType_t>(type), &regAddr, &regsAmount))
+            ModBus::ModBusCodec::encodeRequestFrame(&frames[type], ModBus::MB_READ_HOLDING_REGISTERS_FID, weatherStationSlaveId, regAddr, regsAmount);
+    }
+
+    // Callers of other threads take old or new table, so old tables are freed only with station
+    frameTables.append(frames);
+    __sync_synchronize();
+    requestFrames = frames;
+    framesSlaveId = weatherStationSlaveId;
+}
+
+void WeatherStation::invalidateCache()
+{
+    int type = 0;
+
+    for (type = WS_RT_WINDSPEED; type <= WS_RT_RAINFALL; type++)
+        measurementCache[type].valid = false;
+}
+
+void WeatherStation::publishReading(weatherStationRequestType_t type, double value, uint32_t response)
+{
+    weatherReading_t reading;
+
+    reading.slaveId = weatherStationSlaveId;
+    reading.type = type;
+    reading.timestamp = QDateTime::currentMSecsSinceEpoch();
+    reading.value = value;
+    reading.response = response;
+    ModBus::ModBusMetrics::add(&getMaster()->getMetrics()->readings);
+    emit newReading(reading);
+}
+
+void WeatherStation::transactionFailedSlot(uint8_t transactionId)
+{
+    cancelRefresh(requestsMap.value(transactionId, WS_RT_UNKNOWN));
+}
+
+void WeatherStation::stationErrorSlot(weatherStationErrors_t errorType)
+{
+    getMaster()->getMetrics()->recordStationError(errorType);
 }
 
 void WeatherStation::modbusErrorSlot(ModBus::ModBusError mbErrorType)
@@ -511,6 +792,12 @@ void WeatherStation::modbusErrorSlot(ModBus::ModBusError mbErrorType)
     case ModBus::MB_ERROR_RECEIVE_TIMEOUT:
         emit stationError(WS_ERROR_RECEIVE_TIMEOUT);
         break;
+    case ModBus::MB_ERROR_SLAVE_UNAVAILABLE:
+        emit stationError(WS_ERROR_STATION_UNAVAILABLE);
+        break;
+    case ModBus::MB_ERROR_PORT_LOST:
+        emit stationError(WS_ERROR_PORT_LOST);
+        break;
     default:
         emit stationError(WS_ERROR_UNKOWN);
         break;
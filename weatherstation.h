@@ -3,7 +3,12 @@
 
 #include "modbusmastersub.h"
 #include "modbusmaster.h"
+#include "stationcodec.h"
+#include "stationprofile.h"
 #include <QMap>
+#include <QtGlobal>
+
+class DecodePipeline;
 
 typedef enum _weatherStationErrors_t
 {
@@ -18,33 +23,31 @@ typedef enum _weatherStationErrors_t
     WS_ERROR_BAUDRATE,                  //! Baud rate from station incorrect
     WS_ERROR_WIND_DIRECTION_OFFSET,     //! Wind direction offset from station incorrect
     WS_ERROR_RESET_WIND_SPEED,          //! Fail to set wind speed zero value
-    WS_ERROR_RESET_RAINFALL             //! Fail to reset rainfall value
+    WS_ERROR_RESET_RAINFALL,            //! Fail to reset rainfall value
+    WS_ERROR_STATION_UNAVAILABLE,       //! Station does not respond, request has not been sent
+    WS_ERROR_NOT_SUPPORTED,             //! Measurement or poll group is not supported by station profile
+    WS_ERROR_PORT_LOST                  //! Serial port has been lost, request has not been sent
 } weatherStationErrors_t;
 
-typedef enum _weatherStationRequestType_t
+//! Cached value of measurement
+typedef struct _measurementCache_t
+{
+    qint64 timestamp;                   //!< Time of receiving (monotonic, ms)
+    int maxAge;                         //!< Max age of value for answer from cache (ms), 0 - cache is disabled
+    uint16_t regs[2];                   //!< Registers of response (host byte order)
+    bool valid;                         //!< Value has been received
+    bool refreshing;                    //!< Request for new value is in send queue
+} measurementCache_t;
+
+//! Decoded measurement of weather station
+typedef struct _weatherReading_t
 {
-    WS_RT_UNKNOWN = 0,                  //! Unknown request type (no request)
-    WS_RT_SLAVEID,                      //! Request current slave id
-    WS_RT_BAUDRATE,                     //! Request current baud rate
-    WS_RT_WINDSPEED,                    //! Request wind speed
-    WS_RT_WINDSTRENGTH,                 //! Request wind strength
-    WS_RT_WINDDIRECTION,                //! Request wind direction (cardinal directions)
-    WS_RT_WINDDIRECTIONGRAD,            //! Request wind direction in grad
-    WS_RT_HUMIDITY,                     //! Request humidity
-    WS_RT_TEMPERATURE,                  //! Request temperature
-    WS_RT_NOISE,                        //! Request level of noise
-    WS_RT_PM2_5,                        //! Request pm 2.5
-    WS_RT_PM10,                         //! Request pm 10
-    WS_RT_PRESSURE,                     //! Request atmosphere pressure
-    WS_RT_ILLUMINANCE_Q,                //! Request quality illuminance
-    WS_RT_ILLUMINANCE,                  //! Request illuminance
-    WS_RT_RAINFALL,                     //! Request level of rainfall
-    WS_RT_SETSLAVEID,                   //! Request set new slave id
-    WS_RT_SETBAUDRATE,                  //! Request set baud rate
-    WS_RT_SETWINDDIRECTIONOFFSET,       //! Request set wind direction offset
-    WS_RT_RESETWINDSPEED,               //! Request reset zero value of wind speed
-    WS_RT_RESETRAINFALL                 //! Request reset of rainfall level
-} weatherStationRequestType_t;
+    uint8_t slaveId;                    //!< Slave id of station
+    weatherStationRequestType_t type;   //!< Measurement type (see weatherStationRequestType_t)
+    qint64 timestamp;                   //!< Time of receiving (ms since epoch)
+    double value;                       //!< Value of measurement in units of corresponding signal
+    uint32_t response;                  //!< Id of decoded response (readings of one range read have the same id)
+} weatherReading_t;
 
 /**
  * @brief The WeatherStation class provide manage of weather station
@@ -52,6 +55,7 @@ typedef enum _weatherStationRequestType_t
 class WeatherStation : public ModBus::ModBusMasterSub
 {
     Q_OBJECT
+    friend class DecodePipeline;
 
 public:
     /**
@@ -60,6 +64,79 @@ public:
      * @param parent parent class (must be zero)
      */
     explicit WeatherStation(ModBus::ModBusMaster *master, QObject *parent = 0);
+    ~WeatherStation();
+    /**
+     * @brief getSlaveId get current slave id of station
+     * @return slave id (0xFF if station is not configured)
+     */
+    inline uint8_t getSlaveId() { return weatherStationSlaveId; }
+    /**
+     * @brief setKnownSlaveId set slave id known before (for ex. by previous run), so station is used without request of slave id
+     * @param slaveId slave id (must be called before port init)
+     */
+    inline void setKnownSlaveId(uint8_t slaveId) { weatherStationSlaveId = slaveId; buildFrames(); }
+    /**
+     * @brief measurementName get short name of measurement
+     * @param type measurement type (see weatherStationRequestType_t)
+     * @return name of measurement (for ex. "wind_speed")
+     */
+    static inline const char *measurementName(weatherStationRequestType_t type) { return StationCodec::measurementName(type); }
+    /**
+     * @brief requestTypeFromFrame get request type by request frame
+     * @param txFrame pointer to request frame (in network byte order)
+     * @return request type (see StationCodec::requestTypeFromFrame)
+     */
+    static inline weatherStationRequestType_t requestTypeFromFrame(const ModBus::mbFrame_t *txFrame)
+    {
+        return StationCodec::requestTypeFromFrame(txFrame);
+    }
+    /**
+     * @brief decodeTransaction decode response of transaction and emit corresponding signals
+     * @param transaction pointer to finished transaction (response is decoded in place, memory is not freed)
+     * @param requestType type of request (see weatherStationRequestType_t)
+     */
+    void decodeTransaction(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t requestType);
+    /**
+     * @brief setCacheMaxAge set max age of cached measurement
+     *
+     * Request of measurement, which value is not older than max age, is answered from cache without
+     * request to station (newReading is not emitted). Requests of stale value wait for one shared refresh.
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param maxAge max age (ms), 0 - cache is disabled
+     */
+    void setCacheMaxAge(weatherStationRequestType_t type, int maxAge);
+    /**
+     * @brief setCacheMaxAge set max age of all cached measurements
+     * @param maxAge max age (ms), 0 - cache is disabled
+     */
+    void setCacheMaxAge(int maxAge);
+    /**
+     * @brief setPipeline set pool of workers for decoding of measurements (must be called before port init)
+     *
+     * Measurement responses are decoded and published by workers, so bus thread only updates cache.
+     * Other responses change state of station and are decoded in bus thread.
+     * @param pipeline pointer to pipeline (0 - decode in bus thread)
+     */
+    void setPipeline(DecodePipeline *pipeline);
+    /**
+     * @brief requestReadings send requests for get measurements by one batch (may be called from any thread)
+     *
+     * Frames are built in caller thread and passed to bus thread by one event (see ModBusMaster::submitBatch),
+     * so scheduler of polling does not post event per measurement. Values are always read from station
+     * (cache is refreshed, but does not answer batch).
+     * @param types array of measurement types (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     * @param amount amount of types
+     */
+    void requestReadings(const weatherStationRequestType_t *types, int amount);
+    /**
+     * @brief requestSnapshot send reads of all measurements by one batch (may be called from any thread)
+     *
+     * Registers of all measurements are covered by reads of read planner of master (see ModBusMaster::planReads),
+     * so values are captured by as few transactions as possible (one read for CWT-UWD). Every measurement
+     * of reads is published as separate signal and reading. Response ids of reads are reserved when batch
+     * is queued (see snapshotSubmitted).
+     */
+    void requestSnapshot();
 
 signals:
     /**
@@ -67,6 +144,12 @@ signals:
      * @param errorType type of error (see weatherStationErrors_t)
      */
     void stationError(weatherStationErrors_t errorType);
+    /**
+     * @brief snapshotSubmitted emitted when snapshot reads have been queued to bus (see requestSnapshot)
+     * @param firstResponse id of response of first read (readings of reads have ids firstResponse - firstResponse + amount - 1)
+     * @param amount amount of reads
+     */
+    void snapshotSubmitted(uint32_t firstResponse, int amount);
     /**
      * @brief connectionSetuped emitted when there is connection with station has been setuped
      */
@@ -155,6 +238,11 @@ signals:
      * @brief resetRainfall emitted when a respond on reset level of rainfall request
      */
     void resetRainfall();
+    /**
+     * @brief newReading emitted in addition to measurement signal for every decoded measurement
+     * @param reading decoded measurement (see weatherReading_t)
+     */
+    void newReading(weatherReading_t reading);
 
 public slots:
     /**
@@ -217,6 +305,19 @@ public slots:
      * @brief requestRainfall send request for get level of rainfall
      */
     void requestRainfall();
+    /**
+     * @brief requestReading send request for get measurement by its type (for schedulers of polling)
+     * @param type measurement type (WS_RT_WINDSPEED - WS_RT_RAINFALL)
+     */
+    void requestReading(weatherStationRequestType_t type);
+    /**
+     * @brief requestPollGroup send requests for read all measurements of poll group of station profile
+     *
+     * Registers of group are covered by reads of read planner of master (see ModBusMaster::planReads),
+     * every measurement of read is published as separate signal and reading.
+     * @param group poll group (1 - StationProfile::MAX_GROUPS-1)
+     */
+    void requestPollGroup(uint8_t group);
     /**
      * @brief requestSetSlaveId send request for set new station slave id
      * @param slaveId new slave id (1-254)
@@ -245,12 +346,35 @@ public slots:
 private slots:
     void modbusErrorSlot(ModBus::ModBusError mbErrorType);
     void transactionFinishedSlot(ModBus::mbTransaction_t *transaction);
+    void transactionFailedSlot(uint8_t transactionId);
+    void stationErrorSlot(weatherStationErrors_t errorType);
+
+protected:
+    void batchSubmitted(ModBus::mbTransaction_t *const *transactions, int amount, bool queued);
 
 private:
-    int16_t unsignedToSigned(uint16_t value);
+    void requestMeasurement(weatherStationRequestType_t type);
+    void publishReading(weatherStationRequestType_t type, double value, uint32_t response);
+    bool decodeMeasurement(weatherStationRequestType_t type, const uint16_t *regs, weatherReading_t *reading);
+    void decodeReading(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type);
+    void decodeRange(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type, bool store);
+    int readFields(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type, StationProfile::profileReadField_t *fields);
+    void storeResponseCache(ModBus::mbTransaction_t *transaction, weatherStationRequestType_t type, int regOffset);
+    bool readCached(weatherStationRequestType_t type);
+    void storeCache(weatherStationRequestType_t type, const uint16_t *regs);
+    void cancelRefresh(weatherStationRequestType_t type);
+    void invalidateCache();
+    void buildFrames();
 
     QMap<int, weatherStationRequestType_t> requestsMap;
+    QList<ModBus::mbRequestFrame_t *> frameTables;
+    const ModBus::mbRequestFrame_t *volatile requestFrames;
+    uint8_t framesSlaveId;
+    DecodePipeline *decodePipeline;
+    int pipelineIndex;
+    volatile uint32_t lastResponse;
     uint8_t weatherStationSlaveId;
+    measurementCache_t measurementCache[WS_RT_RAINFALL + 1];
 };
 
 #endif // WEATHERSTATION_H
@@ -0,0 +1,50 @@
+#-------------------------------------------------
+#
+# Benchmarks of per-frame paths of protocol
+#
+#-------------------------------------------------
+
+QT       += core
+
+QT       -= gui
+
+TARGET = ws_com_bench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD
+
+SOURCES += bench/benchmain.cpp \
+    bench/protocolbench.cpp \
+    decodepipeline.cpp \
+    framecapture.cpp \
+    logger.cpp \
+    modbuscodec.cpp \
+    modbusmaster.cpp \
+    modbusmetrics.cpp \
+    modbusmastersub.cpp \
+    readplanner.cpp \
+    realtime.cpp \
+    rtuengine.cpp \
+    stationcodec.cpp \
+    stationprofile.cpp \
+    weatherstation.cpp
+
+HEADERS += \
+    bench/protocolbench.h \
+    decodepipeline.h \
+    framecapture.h \
+    logger.h \
+    modbus.h \
+    modbuscodec.h \
+    modbusmaster.h \
+    modbusmetrics.h \
+    modbusmastersub.h \
+    readplanner.h \
+    realtime.h \
+    rtuengine.h \
+    stationcodec.h \
+    stationprofile.h \
+    weatherstation.h
@@ -0,0 +1,37 @@
+#-------------------------------------------------
+#
+# Qt-free reader of weather station on core protocol library
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = ws_com_lite
+CONFIG   += console
+CONFIG   -= app_bundle qt
+
+TEMPLATE = app
+
+INCLUDEPATH += $$PWD
+
+QMAKE_LFLAGS += -static
+LIBS += -lrt -lpthread
+
+SOURCES += lite/litemain.cpp \
+    logger.cpp \
+    modbuscodec.cpp \
+    modbusmetrics.cpp \
+    readplanner.cpp \
+    rtuengine.cpp \
+    stationcodec.cpp \
+    stationprofile.cpp
+
+HEADERS += \
+    logger.h \
+    modbus.h \
+    modbuscodec.h \
+    modbusmetrics.h \
+    readplanner.h \
+    rtuengine.h \
+    stationcodec.h \
+    stationprofile.h
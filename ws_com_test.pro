@@ -14,16 +14,63 @@ CONFIG   -= app_bundle
 
 TEMPLATE = app
 
+LIBS += -lrt
+
 
 SOURCES += main.cpp \
+    adaptivepoller.cpp \
+    busscanner.cpp \
+    capturereplay.cpp \
     consolemanager.cpp \
+    deadbandfilter.cpp \
+    decodepipeline.cpp \
+    epochsampler.cpp \
+    framecapture.cpp \
+    historystore.cpp \
+    logger.cpp \
+    metricsserver.cpp \
+    modbuscodec.cpp \
+    modbusgateway.cpp \
     modbusmaster.cpp \
+    modbusmetrics.cpp \
     modbusmastersub.cpp \
+    readingexporter.cpp \
+    readplanner.cpp \
+    realtime.cpp \
+    rtuengine.cpp \
+    sharedreadings.cpp \
+    stationcodec.cpp \
+    stationprofile.cpp \
+    warmstate.cpp \
+    weatheraggregator.cpp \
     weatherstation.cpp
 
 HEADERS += \
+    adaptivepoller.h \
+    busscanner.h \
+    capturereplay.h \
     consolemanager.h \
+    deadbandfilter.h \
+    decodepipeline.h \
+    epochsampler.h \
+    framecapture.h \
+    historystore.h \
+    logger.h \
+    metricsserver.h \
     modbus.h \
+    modbuscodec.h \
+    modbusgateway.h \
     modbusmaster.h \
+    modbusmetrics.h \
     modbusmastersub.h \
+    readingexporter.h \
+    readplanner.h \
+    realtime.h \
+    rtuengine.h \
+    sharedreadings.h \
+    sharedreadingslayout.h \
+    stationcodec.h \
+    stationprofile.h \
+    warmstate.h \
+    weatheraggregator.h \
     weatherstation.h